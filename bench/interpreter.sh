@@ -0,0 +1,55 @@
+#!/bin/bash
+# compares the time to get a program's output from latc_x86_64 --interpret with compiling it and running the executable,
+# for generated programs of growing size, run from the root of the repository after make
+set -e
+
+LATC=$(pwd)/latc_x86_64
+RUNTIME=$(pwd)/lib
+SIZES=${SIZES:-"1 10 100 1000 3000"}
+ITERATIONS=${ITERATIONS:-1000}
+REPEATS=${REPEATS:-3}
+
+WORK=$(mktemp -d)
+trap 'rm -rf "$WORK"' EXIT
+ln -s "$RUNTIME" "$WORK/lib"
+cd "$WORK"
+
+# each function runs a loop of the given number of iterations, main calls all of them
+generate() {
+	local functions=$1
+	for ((i = 0; i < functions; ++i)); do
+		echo "int f$i(int n) { int s = 0; int j = 0; while (j < n) { s = s + j * $i % 7; j++; } return s; }"
+	done
+	echo "int main() { int s = 0;"
+	for ((i = 0; i < functions; ++i)); do
+		echo "s = s + f$i($ITERATIONS);"
+	done
+	echo "printInt(s); return 0; }"
+}
+
+# the best of the repeats, in milliseconds
+measure() {
+	local best=
+	for ((r = 0; r < REPEATS; ++r)); do
+		local begin=$(date +%s%N)
+		"$@" >/dev/null 2>&1
+		local time=$((($(date +%s%N) - begin) / 1000000))
+		if [ -z "$best" ] || [ $time -lt $best ]; then
+			best=$time
+		fi
+	done
+	echo $best
+}
+
+printf "%10s %14s %12s %8s %12s\n" functions interpret_ms compile_ms run_ms aot_total_ms
+for size in $SIZES; do
+	generate $size > program.lat
+	if [ "$("$LATC" --interpret program.lat)" != "$("$LATC" program.lat 2>/dev/null && ./program)" ]; then
+		echo "different output for $size functions" >&2
+		exit 1
+	fi
+	interpret=$(measure "$LATC" --interpret program.lat)
+	compile=$(measure "$LATC" program.lat)
+	run=$(measure ./program)
+	printf "%10s %14s %12s %8s %12s\n" $size $interpret $compile $run $((compile + run))
+done
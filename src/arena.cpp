@@ -0,0 +1,57 @@
+#include "arena.h"
+
+#include <atomic>
+
+namespace {
+	const size_t BLOCK_SIZE = 64 * 1024;
+	const size_t ALIGNMENT = alignof(std::max_align_t);
+
+	std::atomic<uint64_t> arenas(0);
+
+	thread_local std::shared_ptr<Arena> current_arena;
+
+	//the block this thread allocates from, of the arena with the given id
+	struct Cursor {
+		uint64_t arena;
+		char* next;
+		char* end;
+	};
+
+	thread_local Cursor cursor = {0, nullptr, nullptr};
+}
+
+char* Arena::new_block(size_t size) {
+	std::lock_guard<std::mutex> lock(mutex);
+	blocks.emplace_back(new char[size]);
+	return blocks.back().get();
+}
+
+void* Arena::allocate(size_t size) {
+	size = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	//big allocations get blocks of their own, so that little of the current one is wasted
+	if(size > BLOCK_SIZE / 4) {
+		return new_block(size);
+	}
+	if(cursor.arena != id || static_cast<size_t>(cursor.end - cursor.next) < size) {
+		cursor.next = new_block(BLOCK_SIZE);
+		cursor.end = cursor.next + BLOCK_SIZE;
+		cursor.arena = id;
+	}
+	void* result = cursor.next;
+	cursor.next += size;
+	return result;
+}
+
+const std::shared_ptr<Arena>& Arena::current() {
+	return current_arena;
+}
+
+Arena::Scope::Scope(const std::shared_ptr<Arena>& arena) : previous(current_arena) {
+	current_arena = arena;
+}
+
+Arena::Scope::~Scope() {
+	current_arena = std::move(previous);
+}
+
+Arena::Arena() : id(++arenas) {}
@@ -0,0 +1,40 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//bump allocator of the nodes of a program tree, every thread allocates from a block of its own, the memory is freed only with the whole arena
+class Arena {
+	std::mutex mutex;
+	std::vector<std::unique_ptr<char[]>> blocks;
+	const uint64_t id; //tells the arena the current blocks of the threads belong to
+
+	char* new_block(size_t size);
+
+public:
+	//aligned for any type
+	void* allocate(size_t size);
+
+	//of this thread, may be null
+	static const std::shared_ptr<Arena>& current();
+
+	//makes the arena the current one of this thread until the end of the scope
+	class Scope {
+		std::shared_ptr<Arena> previous;
+	public:
+		Scope(const std::shared_ptr<Arena>& arena);
+		~Scope();
+		Scope() = delete;
+		Scope(const Scope&) = delete;
+	};
+
+	Arena();
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+};
+
+#endif
@@ -0,0 +1,1098 @@
+#include "assembler.h"
+#include "elf.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <cstdint>
+#include <initializer_list>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+using namespace Elf;
+
+namespace {
+	const size_t NO_SECTION = SIZE_MAX;
+
+	const int RSP = 4;
+
+	const int JMP = -1;
+	const int CALL = -2;
+
+	//in the order of their numbers, almost every operand is looked up here so it's scanned rather than hashed
+	const std::vector<std::string> REGISTERS = {
+		"rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi", "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15"
+	};
+
+	const std::vector<std::string> BYTE_REGISTERS = {
+		"al", "cl", "dl", "bl", "spl", "bpl", "sil", "dil", "r8b", "r9b", "r10b", "r11b", "r12b", "r13b", "r14b", "r15b"
+	};
+
+	const std::vector<std::pair<std::string, int>> CONDITIONS = {
+		{"o", 0}, {"no", 1}, {"b", 2}, {"c", 2}, {"nae", 2}, {"ae", 3}, {"nb", 3}, {"nc", 3},
+		{"e", 4}, {"z", 4}, {"ne", 5}, {"nz", 5}, {"be", 6}, {"na", 6}, {"a", 7}, {"nbe", 7},
+		{"s", 8}, {"ns", 9}, {"p", 10}, {"pe", 10}, {"np", 11}, {"po", 11},
+		{"l", 12}, {"nge", 12}, {"ge", 13}, {"nl", 13}, {"le", 14}, {"ng", 14}, {"g", 15}, {"nle", 15}
+	};
+
+	//instructions sharing the encoding of add, the value goes to the opcode or the reg field of ModRM
+	const std::vector<std::pair<std::string, int>> ARITHMETIC = {
+		{"add", 0}, {"or", 1}, {"adc", 2}, {"sbb", 3}, {"and", 4}, {"sub", 5}, {"xor", 6}, {"cmp", 7}
+	};
+
+	//instructions with a single register or memory operand encoded as F7 or FF and the value in the reg field of ModRM
+	const std::vector<std::pair<std::string, std::pair<int, int>>> UNARY = {
+		{"inc", {0xff, 0}}, {"dec", {0xff, 1}}, {"not", {0xf7, 2}}, {"neg", {0xf7, 3}},
+		{"mul", {0xf7, 4}}, {"imul", {0xf7, 5}}, {"div", {0xf7, 6}}, {"idiv", {0xf7, 7}}
+	};
+
+	const std::vector<std::pair<std::string, std::vector<uint8_t>>> NO_OPERANDS = {
+		{"ret", {0xc3}}, {"leave", {0xc9}}, {"cqo", {0x48, 0x99}}, {"syscall", {0x0f, 0x05}}, {"nop", {0x90}}
+	};
+
+	//mandatory prefix, opcode of the xmm <- xmm/memory form and of the memory <- xmm form (0 if none)
+	struct SseEncoding {
+		int prefix;
+		int load;
+		int store;
+	};
+
+	const std::vector<std::pair<std::string, SseEncoding>> SSE = {
+		{"pxor", {0x66, 0xef, 0}}, {"paddq", {0x66, 0xd4, 0}}, {"psubq", {0x66, 0xfb, 0}}, {"punpcklqdq", {0x66, 0x6c, 0}},
+		{"movdqa", {0x66, 0x6f, 0x7f}}, {"movdqu", {0xf3, 0x6f, 0x7f}}
+	};
+
+	//recommended nops of 1 to 9 bytes, used to pad code
+	const std::vector<std::vector<uint8_t>> NOPS = {
+		{0x90},
+		{0x66, 0x90},
+		{0x0f, 0x1f, 0x00},
+		{0x0f, 0x1f, 0x40, 0x00},
+		{0x0f, 0x1f, 0x44, 0x00, 0x00},
+		{0x66, 0x0f, 0x1f, 0x44, 0x00, 0x00},
+		{0x0f, 0x1f, 0x80, 0x00, 0x00, 0x00, 0x00},
+		{0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00},
+		{0x66, 0x0f, 0x1f, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00}
+	};
+
+	const uint32_t NO_SYMBOL = 0;
+
+	struct Relocation {
+		size_t offset;
+		uint32_t type;
+		uint32_t symbol;
+		int64_t addend;
+	};
+
+	struct Operand {
+		enum class Kind {Register, ByteRegister, Xmm, Memory, Immediate};
+		Kind kind;
+		int reg; //the register or the base of the address, -1 if none
+		int index; //-1 if none
+		int scale;
+		int64_t value; //the immediate or the displacement
+		uint32_t symbol; //added to the value, NO_SYMBOL if none
+
+		Operand() : kind(Kind::Immediate), reg(-1), index(-1), scale(1), value(0), symbol(NO_SYMBOL) {}
+	};
+
+	//a name used by the code, defined by a label of one of the sections or left to the linker
+	struct Label {
+		std::string name;
+		size_t section; //NO_SECTION if it isn't defined
+		size_t position; //in the encoded bytes of the section
+		size_t fixups; //of the section before the label
+		size_t offset; //to be set by the layout
+	};
+
+	//the labels are numbered in the order they're first seen, NO_SYMBOL is the null symbol
+	class Labels {
+		std::unordered_map<std::string, uint32_t> numbers;
+		std::vector<Label> labels;
+
+	public:
+		uint32_t number(const std::string& name) {
+			auto it = numbers.find(name);
+			if(it != numbers.end()) {
+				return it->second;
+			}
+			numbers.emplace(name, labels.size());
+			labels.push_back({name, NO_SECTION, 0, 0, 0});
+			return labels.size() - 1;
+		}
+
+		Label& operator[](uint32_t number) {
+			return labels[number];
+		}
+
+		size_t size() const {
+			return labels.size();
+		}
+
+		Labels() : labels(1, Label{"", NO_SECTION, 0, 0, 0}) {}
+	};
+
+	//what can't be encoded before the layout: jumps to labels of the same section are short when the distance allows it, and padding depends on the offset
+	struct Fixup {
+		enum class Kind {Jump, Align};
+		Kind kind;
+		bool is_short;
+		int condition; //of a conditional jump, JMP or CALL
+		uint32_t target; //of the jump
+		size_t alignment;
+		size_t position; //in the encoded bytes of the section, the fixup goes before the byte there
+		size_t offset; //to be set by the layout
+	};
+
+	//instructions and data are encoded as they come, the fixups are put between them by the layout
+	struct Section {
+		std::string name;
+		uint32_t type;
+		uint64_t flags;
+		size_t alignment;
+		std::vector<uint8_t> bytes;
+		std::vector<Relocation> relocations; //offsets in the bytes
+		std::vector<Fixup> fixups; //in the order of positions
+		size_t size; //to be set by the layout
+
+		Section(const std::string& name, uint32_t type, uint64_t flags, size_t alignment) : name(name), type(type), flags(flags), alignment(alignment), size(0) {}
+	};
+
+	void require(bool condition) {
+		if(!condition) {
+			throw std::runtime_error("unsupported operands");
+		}
+	}
+
+	bool fits_in_byte(int64_t value) {
+		return value >= INT8_MIN && value <= INT8_MAX;
+	}
+
+	bool fits_in_int(int64_t value) {
+		return value >= INT32_MIN && value <= INT32_MAX;
+	}
+
+	//a part of a line, the lines are parsed where they are instead of being cut into strings
+	struct Text {
+		const char* begin;
+		const char* end;
+
+		size_t size() const {
+			return end - begin;
+		}
+
+		bool empty() const {
+			return begin == end;
+		}
+
+		std::string str() const {
+			return std::string(begin, end);
+		}
+
+		bool starts_with(const char* prefix) const {
+			size_t length = strlen(prefix);
+			return size() >= length && std::equal(prefix, prefix + length, begin);
+		}
+
+		bool operator==(const char* s) const {
+			return size() == strlen(s) && starts_with(s);
+		}
+	};
+
+	Text text(const std::string& s) {
+		return {s.data(), s.data() + s.size()};
+	}
+
+	bool is_blank(char c) {
+		return c == ' ' || c == '\t' || c == '\r';
+	}
+
+	Text trim(Text s) {
+		while(!s.empty() && is_blank(*s.begin)) {
+			++s.begin;
+		}
+		while(!s.empty() && is_blank(s.end[-1])) {
+			--s.end;
+		}
+		return s;
+	}
+
+	//up to the first space or tab, what follows it goes trimmed to the rest
+	Text first_word(Text s, Text& rest) {
+		const char* space = std::find_if(s.begin, s.end, [](char c) {
+			return c == ' ' || c == '\t';
+		});
+		rest = trim(Text{space, s.end});
+		return {s.begin, space};
+	}
+
+	bool is_symbol(Text s) {
+		if(s.empty() || isdigit(*s.begin)) {
+			return false;
+		}
+		for(const char* c = s.begin; c != s.end; ++c) {
+			if(!isalnum(*c) && *c != '_' && *c != '.' && *c != '$' && *c != '@') {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//compared in place, the names are too short for memcmp to pay off
+	bool equal(Text a, const std::string& b) {
+		if(a.size() != b.size()) {
+			return false;
+		}
+		for(size_t i = 0; i < b.size(); ++i) {
+			if(a.begin[i] != b[i]) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	//the value of the name in a table small enough to be scanned, null if it isn't there
+	template<typename Value>
+	const Value* find(const std::vector<std::pair<std::string, Value>>& table, Text name) {
+		for(const auto& entry : table) {
+			if(equal(name, entry.first)) {
+				return &entry.second;
+			}
+		}
+		return nullptr;
+	}
+
+	//the number of the register, -1 if the name isn't one
+	int find_register(const std::vector<std::string>& registers, Text name) {
+		for(size_t i = 0; i < registers.size(); ++i) {
+			if(equal(name, registers[i])) {
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	//decimal or 0x-prefixed hexadecimal, wraps around like NASM
+	bool parse_number(Text s, int64_t& result) {
+		bool hex = s.starts_with("0x");
+		const char* i = s.begin + (hex ? 2 : 0);
+		if(i == s.end) {
+			return false;
+		}
+		uint64_t value = 0;
+		for(; i != s.end; ++i) {
+			if(hex ? !isxdigit(*i) : !isdigit(*i)) {
+				return false;
+			}
+			value = value * (hex ? 16 : 10) + (isdigit(*i) ? *i - '0' : tolower(*i) - 'a' + 10);
+		}
+		result = value;
+		return true;
+	}
+
+	void split_operands(Text s, std::vector<Text>& result) {
+		result.clear();
+		if(trim(s).empty()) {
+			return;
+		}
+		size_t depth = 0;
+		const char* current = s.begin;
+		for(const char* c = s.begin; c != s.end; ++c) {
+			depth += *c == '[';
+			depth -= *c == ']';
+			if(*c == ',' && !depth) {
+				result.push_back(trim(Text{current, c}));
+				current = c + 1;
+			}
+		}
+		result.push_back(trim(Text{current, s.end}));
+	}
+
+	//sums of registers, a scaled index register, numbers and a symbol
+	void parse_terms(Text s, Operand& result, bool address, Labels& labels) {
+		std::string term;
+		const char* i = s.begin;
+		while(true) {
+			while(i != s.end && (*i == ' ' || *i == '\t')) {
+				++i;
+			}
+			if(i == s.end) {
+				break;
+			}
+			bool negative = false;
+			if(*i == '+' || *i == '-') {
+				negative = *i == '-';
+				++i;
+			}
+			term.clear();
+			for(; i != s.end && *i != '+' && *i != '-'; ++i) {
+				if(*i != ' ' && *i != '\t') {
+					term += *i;
+				}
+			}
+			int64_t number;
+			size_t star = term.find('*');
+			int reg = find_register(REGISTERS, Text{term.data(), term.data() + std::min(star, term.size())});
+			if(star != std::string::npos) {
+				Text scale{term.data() + star + 1, term.data() + term.size()};
+				if(reg < 0) {
+					reg = find_register(REGISTERS, scale);
+					scale = Text{term.data(), term.data() + star};
+				}
+				require(address && !negative && result.index < 0 && reg >= 0 && parse_number(scale, number));
+				require(number == 1 || number == 2 || number == 4 || number == 8);
+				result.index = reg;
+				result.scale = number;
+			} else if(reg >= 0) {
+				require(address && !negative);
+				if(result.reg < 0) {
+					result.reg = reg;
+				} else {
+					require(result.index < 0);
+					result.index = reg;
+				}
+			} else if(parse_number(text(term), number)) {
+				//wraps around like the assembler's arithmetic, -9223372036854775808 can't be negated as a signed number
+				uint64_t magnitude = number;
+				result.value = static_cast<int64_t>(static_cast<uint64_t>(result.value) + (negative ? -magnitude : magnitude));
+			} else {
+				require(!negative && !result.symbol && is_symbol(text(term)));
+				result.symbol = labels.number(term);
+			}
+		}
+		//rsp can't be an index
+		if(result.index == RSP) {
+			require(result.reg != result.index && result.scale == 1);
+			std::swap(result.reg, result.index);
+		}
+	}
+
+	Operand parse_operand(Text s, Labels& labels) {
+		//everything is 64-bit except for the byte registers, so qword says nothing new
+		if(s.starts_with("qword ")) {
+			s = trim(Text{s.begin + 6, s.end});
+		}
+		require(!s.empty());
+		Operand result;
+		if(*s.begin == '[') {
+			require(s.end[-1] == ']' && s.size() > 1);
+			result.kind = Operand::Kind::Memory;
+			parse_terms(Text{s.begin + 1, s.end - 1}, result, true, labels);
+			require(fits_in_int(result.value));
+			return result;
+		}
+		int reg = find_register(REGISTERS, s);
+		int byte_reg = find_register(BYTE_REGISTERS, s);
+		if(reg >= 0) {
+			result.kind = Operand::Kind::Register;
+			result.reg = reg;
+		} else if(byte_reg >= 0) {
+			result.kind = Operand::Kind::ByteRegister;
+			result.reg = byte_reg;
+		} else if(s.starts_with("xmm") && s.size() <= 5 && parse_number(Text{s.begin + 3, s.end}, result.value) && result.value < 16) {
+			result.kind = Operand::Kind::Xmm;
+			result.reg = result.value;
+			result.value = 0;
+		} else {
+			parse_terms(s, result, false, labels);
+		}
+		return result;
+	}
+
+	bool is_register_or_memory(const Operand& op) {
+		return op.kind == Operand::Kind::Register || op.kind == Operand::Kind::Memory;
+	}
+
+	bool is_xmm_or_memory(const Operand& op) {
+		return op.kind == Operand::Kind::Xmm || op.kind == Operand::Kind::Memory;
+	}
+
+	//spl, bpl, sil and dil exist only with a REX prefix
+	bool needs_rex(const Operand& op) {
+		return op.kind == Operand::Kind::ByteRegister && op.reg >= 4 && op.reg < 8;
+	}
+
+	class Encoder {
+		std::vector<uint8_t>& bytes;
+		std::vector<Relocation>& relocations;
+
+	public:
+		void byte(int value) {
+			bytes.push_back(value);
+		}
+
+		void word(uint64_t value, size_t size) {
+			for(size_t i = 0; i < size; ++i) {
+				byte(i < 8 ? (value >> (8 * i)) & 0xff : 0);
+			}
+		}
+
+		//the value of an operand, a symbol is left to the linker
+		void immediate(const Operand& op, size_t size, uint32_t type) {
+			require(op.kind == Operand::Kind::Immediate);
+			if(!op.symbol) {
+				word(op.value, size);
+			} else {
+				relocations.push_back({bytes.size(), type, op.symbol, op.value});
+				word(0, size);
+			}
+		}
+
+		void modrm(int reg, const Operand& rm) {
+			reg &= 7;
+			if(rm.kind != Operand::Kind::Memory) {
+				byte(0xc0 | reg << 3 | (rm.reg & 7));
+				return;
+			}
+			int scale = rm.scale == 8 ? 3 : rm.scale == 4 ? 2 : rm.scale == 2 ? 1 : 0;
+			int index = rm.index < 0 ? 4 : rm.index & 7;
+			Operand displacement;
+			displacement.value = rm.value;
+			displacement.symbol = rm.symbol;
+			if(rm.reg < 0) {
+				byte(reg << 3 | 4);
+				byte(scale << 6 | index << 3 | 5);
+				immediate(displacement, 4, R_X86_64_32S);
+				return;
+			}
+			int mod = rm.symbol || !fits_in_byte(rm.value) ? 2 : rm.value || (rm.reg & 7) == 5 ? 1 : 0;
+			if(rm.index >= 0 || (rm.reg & 7) == 4) {
+				byte(mod << 6 | reg << 3 | 4);
+				byte(scale << 6 | index << 3 | (rm.reg & 7));
+			} else {
+				byte(mod << 6 | reg << 3 | (rm.reg & 7));
+			}
+			if(mod == 1) {
+				byte(rm.value & 0xff);
+			} else if(mod == 2) {
+				immediate(displacement, 4, R_X86_64_32S);
+			}
+		}
+
+		//mandatory prefixes, REX if needed, the opcode and ModRM with what follows it
+		void instruction(std::initializer_list<int> prefixes, bool wide, std::initializer_list<int> opcode, int reg, const Operand& rm, bool force_rex = false) {
+			for(int p : prefixes) {
+				byte(p);
+			}
+			int rex = 0x40 | (wide ? 8 : 0) | (reg & 8 ? 4 : 0);
+			if(rm.kind == Operand::Kind::Memory) {
+				rex |= (rm.index >= 0 && (rm.index & 8) ? 2 : 0) | (rm.reg >= 0 && (rm.reg & 8) ? 1 : 0);
+			} else {
+				rex |= rm.reg & 8 ? 1 : 0;
+			}
+			if(rex != 0x40 || force_rex || needs_rex(rm)) {
+				byte(rex);
+			}
+			for(int o : opcode) {
+				byte(o);
+			}
+			modrm(reg, rm);
+		}
+
+		//the register in the low bits of the opcode
+		void instruction(bool wide, int opcode, int reg) {
+			if(wide || reg & 8) {
+				byte(0x40 | (wide ? 8 : 0) | (reg & 8 ? 1 : 0));
+			}
+			byte(opcode | (reg & 7));
+		}
+
+		Encoder() = delete;
+		Encoder(std::vector<uint8_t>& bytes, std::vector<Relocation>& relocations) : bytes(bytes), relocations(relocations) {}
+	};
+
+	void encode(Encoder& e, const std::string& name, const std::vector<Operand>& ops) {
+		using Kind = Operand::Kind;
+		size_t n = ops.size();
+		const std::vector<uint8_t>* no_operands = find(NO_OPERANDS, text(name));
+		if(n == 0 && no_operands) {
+			for(uint8_t b : *no_operands) {
+				e.byte(b);
+			}
+			return;
+		}
+		const int* arithmetic = find(ARITHMETIC, text(name));
+		if(arithmetic && n == 2) {
+			int code = *arithmetic;
+			const Operand& a = ops[0];
+			const Operand& b = ops[1];
+			if(is_register_or_memory(a) && b.kind == Kind::Register) {
+				e.instruction({}, true, {code << 3 | 1}, b.reg, a);
+			} else if(a.kind == Kind::Register && b.kind == Kind::Memory) {
+				e.instruction({}, true, {code << 3 | 3}, a.reg, b);
+			} else if(is_register_or_memory(a) && b.kind == Kind::Immediate && !b.symbol && fits_in_byte(b.value)) {
+				e.instruction({}, true, {0x83}, code, a);
+				e.byte(b.value & 0xff);
+			} else {
+				require(is_register_or_memory(a) && b.kind == Kind::Immediate && fits_in_int(b.value));
+				e.instruction({}, true, {0x81}, code, a);
+				e.immediate(b, 4, R_X86_64_32S);
+			}
+			return;
+		}
+		const std::pair<int, int>* unary = find(UNARY, text(name));
+		if(unary && n == 1) {
+			require(is_register_or_memory(ops[0]));
+			e.instruction({}, true, {unary->first}, unary->second, ops[0]);
+			return;
+		}
+		if(name == "imul" && (n == 2 || n == 3)) {
+			const Operand& a = ops[0];
+			const Operand& b = n == 3 ? ops[1] : ops[1].kind == Kind::Immediate ? ops[0] : ops[1];
+			const Operand& c = ops[n - 1];
+			require(a.kind == Kind::Register && is_register_or_memory(b));
+			if(c.kind != Kind::Immediate) {
+				require(n == 2);
+				e.instruction({}, true, {0x0f, 0xaf}, a.reg, b);
+			} else if(!c.symbol && fits_in_byte(c.value)) {
+				e.instruction({}, true, {0x6b}, a.reg, b);
+				e.byte(c.value & 0xff);
+			} else {
+				require(fits_in_int(c.value));
+				e.instruction({}, true, {0x69}, a.reg, b);
+				e.immediate(c, 4, R_X86_64_32S);
+			}
+			return;
+		}
+		if(name == "mov" && n == 2) {
+			const Operand& a = ops[0];
+			const Operand& b = ops[1];
+			if(is_register_or_memory(a) && b.kind == Kind::Register) {
+				e.instruction({}, true, {0x89}, b.reg, a);
+			} else if(a.kind == Kind::Register && b.kind == Kind::Memory) {
+				e.instruction({}, true, {0x8b}, a.reg, b);
+			} else if((a.kind == Kind::ByteRegister || a.kind == Kind::Memory) && b.kind == Kind::ByteRegister) {
+				e.instruction({}, false, {0x88}, b.reg, a, needs_rex(b));
+			} else if(a.kind == Kind::ByteRegister && b.kind == Kind::Memory) {
+				e.instruction({}, false, {0x8a}, a.reg, b, needs_rex(a));
+			} else if(a.kind == Kind::Memory) {
+				require(b.kind == Kind::Immediate && fits_in_int(b.value));
+				e.instruction({}, true, {0xc7}, 0, a);
+				e.immediate(b, 4, R_X86_64_32S);
+			} else {
+				require(a.kind == Kind::Register && b.kind == Kind::Immediate);
+				//writing the lower half clears the upper one, addresses of a static executable fit in it too
+				if(b.symbol || (b.value >= 0 && b.value <= UINT32_MAX)) {
+					e.instruction(false, 0xb8, a.reg);
+					e.immediate(b, 4, R_X86_64_32);
+				} else if(fits_in_int(b.value)) {
+					e.instruction({}, true, {0xc7}, 0, a);
+					e.immediate(b, 4, R_X86_64_32S);
+				} else {
+					e.instruction(true, 0xb8, a.reg);
+					e.immediate(b, 8, R_X86_64_64);
+				}
+			}
+			return;
+		}
+		if(name == "lea" && n == 2) {
+			require(ops[0].kind == Kind::Register && ops[1].kind == Kind::Memory);
+			e.instruction({}, true, {0x8d}, ops[0].reg, ops[1]);
+			return;
+		}
+		if(name == "test" && n == 2) {
+			require(is_register_or_memory(ops[0]));
+			if(ops[1].kind == Kind::Register) {
+				e.instruction({}, true, {0x85}, ops[1].reg, ops[0]);
+			} else {
+				require(fits_in_int(ops[1].value));
+				e.instruction({}, true, {0xf7}, 0, ops[0]);
+				e.immediate(ops[1], 4, R_X86_64_32S);
+			}
+			return;
+		}
+		if(name == "push" && n == 1) {
+			const Operand& a = ops[0];
+			if(a.kind == Kind::Register) {
+				e.instruction(false, 0x50, a.reg);
+			} else if(a.kind == Kind::Memory) {
+				e.instruction({}, false, {0xff}, 6, a);
+			} else if(!a.symbol && fits_in_byte(a.value)) {
+				e.byte(0x6a);
+				e.byte(a.value & 0xff);
+			} else {
+				require(fits_in_int(a.value));
+				e.byte(0x68);
+				e.immediate(a, 4, R_X86_64_32S);
+			}
+			return;
+		}
+		if(name == "pop" && n == 1) {
+			if(ops[0].kind == Kind::Register) {
+				e.instruction(false, 0x58, ops[0].reg);
+			} else {
+				require(ops[0].kind == Kind::Memory);
+				e.instruction({}, false, {0x8f}, 0, ops[0]);
+			}
+			return;
+		}
+		if((name == "call" || name == "jmp") && n == 1) {
+			require(is_register_or_memory(ops[0]));
+			e.instruction({}, false, {0xff}, name == "call" ? 2 : 4, ops[0]);
+			return;
+		}
+		const int* condition = name.compare(0, 3, "set") == 0 ? find(CONDITIONS, Text{name.data() + 3, name.data() + name.size()}) : nullptr;
+		if(condition && n == 1) {
+			require(ops[0].kind == Kind::ByteRegister || ops[0].kind == Kind::Memory);
+			e.instruction({}, false, {0x0f, 0x90 | *condition}, 0, ops[0]);
+			return;
+		}
+		condition = name.compare(0, 4, "cmov") == 0 ? find(CONDITIONS, Text{name.data() + 4, name.data() + name.size()}) : nullptr;
+		if(condition && n == 2) {
+			require(ops[0].kind == Kind::Register && is_register_or_memory(ops[1]));
+			e.instruction({}, true, {0x0f, 0x40 | *condition}, ops[0].reg, ops[1]);
+			return;
+		}
+		const SseEncoding* sse_encoding = find(SSE, text(name));
+		if(sse_encoding && n == 2) {
+			const SseEncoding& sse = *sse_encoding;
+			if(ops[0].kind == Kind::Xmm && is_xmm_or_memory(ops[1])) {
+				e.instruction({sse.prefix}, false, {0x0f, sse.load}, ops[0].reg, ops[1]);
+			} else {
+				require(sse.store && ops[0].kind == Kind::Memory && ops[1].kind == Kind::Xmm);
+				e.instruction({sse.prefix}, false, {0x0f, sse.store}, ops[1].reg, ops[0]);
+			}
+			return;
+		}
+		if(name == "pshufd" && n == 3) {
+			require(ops[0].kind == Kind::Xmm && is_xmm_or_memory(ops[1]) && ops[2].kind == Kind::Immediate && !ops[2].symbol);
+			e.instruction({0x66}, false, {0x0f, 0x70}, ops[0].reg, ops[1]);
+			e.byte(ops[2].value & 0xff);
+			return;
+		}
+		if(name == "movq" && n == 2) {
+			if(ops[0].kind == Kind::Xmm && ops[1].kind == Kind::Register) {
+				e.instruction({0x66}, true, {0x0f, 0x6e}, ops[0].reg, ops[1]);
+			} else if(ops[0].kind == Kind::Register && ops[1].kind == Kind::Xmm) {
+				e.instruction({0x66}, true, {0x0f, 0x7e}, ops[1].reg, ops[0]);
+			} else {
+				require(ops[0].kind == Kind::Xmm && is_xmm_or_memory(ops[1]));
+				e.instruction({0xf3}, false, {0x0f, 0x7e}, ops[0].reg, ops[1]);
+			}
+			return;
+		}
+		throw std::runtime_error("unsupported instruction");
+	}
+}
+
+class Assembler {
+	std::vector<Section> sections;
+	size_t current; //NO_SECTION before the first section directive
+	std::set<std::string> globals;
+	std::set<std::string> externs;
+	Labels labels;
+	std::vector<uint32_t> definitions; //of the labels, in their order
+	size_t instructions;
+	//of the line being assembled, kept to reuse their memory
+	std::vector<Text> arguments;
+	std::vector<Operand> operands;
+
+	Section& section() {
+		if(current == NO_SECTION) {
+			throw std::runtime_error("no section");
+		}
+		return sections[current];
+	}
+
+	Encoder encoder() {
+		return Encoder(section().bytes, section().relocations);
+	}
+
+	Fixup& add(Fixup::Kind kind) {
+		Section& s = section();
+		s.fixups.push_back({kind, false, JMP, NO_SYMBOL, 1, s.bytes.size(), 0});
+		return s.fixups.back();
+	}
+
+	void switch_section(const std::string& name) {
+		for(current = 0; current < sections.size(); ++current) {
+			if(sections[current].name == name) {
+				return;
+			}
+		}
+		if(name == ".text" || name.compare(0, 6, ".text.") == 0) {
+			sections.emplace_back(name, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 16);
+		} else if(name == ".rodata") {
+			sections.emplace_back(name, SHT_PROGBITS, SHF_ALLOC, 8);
+		} else if(name == ".data") {
+			sections.emplace_back(name, SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, 8);
+		} else if(name == ".bss") {
+			sections.emplace_back(name, SHT_NOBITS, SHF_ALLOC | SHF_WRITE, 8);
+		} else {
+			throw std::runtime_error("unknown section");
+		}
+	}
+
+	void label(Text name) {
+		uint32_t number = is_symbol(name) ? labels.number(name.str()) : NO_SYMBOL;
+		if(!number || labels[number].section != NO_SECTION) {
+			throw std::runtime_error("invalid or repeated label");
+		}
+		Section& s = section();
+		labels[number].section = current;
+		labels[number].position = s.bytes.size();
+		labels[number].fixups = s.fixups.size();
+		definitions.push_back(number);
+	}
+
+	bool is_data(Text directive) {
+		return directive == "dq" || directive == "db" || directive == "times" || directive == "resq";
+	}
+
+	void data(Text directive, Text args) {
+		if(directive == "times") {
+			Text rest;
+			Text count_text = first_word(args, rest);
+			int64_t count;
+			if(count_text.end == args.end || !parse_number(count_text, count)) {
+				throw std::runtime_error("invalid count");
+			}
+			Text repeated_args;
+			Text repeated = first_word(rest, repeated_args);
+			for(int64_t i = 0; i < count; ++i) {
+				data(repeated, repeated_args);
+			}
+			return;
+		}
+		Encoder e = encoder();
+		if(directive == "resq") {
+			int64_t count;
+			require(parse_number(args, count));
+			e.word(0, 8 * count);
+			return;
+		}
+		if(section().type == SHT_NOBITS) {
+			throw std::runtime_error("initialized data in .bss");
+		}
+		split_operands(args, arguments);
+		for(Text arg : arguments) {
+			Operand op = parse_operand(arg, labels);
+			if(directive == "dq") {
+				e.immediate(op, 8, R_X86_64_64);
+			} else {
+				require(!op.symbol && op.value >= INT8_MIN && op.value <= UINT8_MAX);
+				e.immediate(op, 1, 0);
+			}
+		}
+	}
+
+	void instruction(const std::string& name, Text args) {
+		if(section().type == SHT_NOBITS) {
+			throw std::runtime_error("code in .bss");
+		}
+		++instructions;
+		split_operands(args, arguments);
+		operands.clear();
+		for(Text arg : arguments) {
+			operands.push_back(parse_operand(arg, labels));
+		}
+		const int* condition = name[0] == 'j' ? find(CONDITIONS, Text{name.data() + 1, name.data() + name.size()}) : nullptr;
+		bool is_jump = name == "jmp" || name == "call" || condition;
+		if(is_jump && operands.size() == 1 && operands[0].kind == Operand::Kind::Immediate && operands[0].symbol && !operands[0].value) {
+			Fixup& jump = add(Fixup::Kind::Jump);
+			jump.target = operands[0].symbol;
+			jump.condition = name == "jmp" ? JMP : name == "call" ? CALL : *condition;
+			return;
+		}
+		Encoder e = encoder();
+		encode(e, name, operands);
+	}
+
+	size_t fixup_size(const Fixup& fixup, size_t offset) {
+		if(fixup.kind == Fixup::Kind::Align) {
+			return (fixup.alignment - offset % fixup.alignment) % fixup.alignment;
+		}
+		return fixup.is_short ? 2 : fixup.condition < 0 ? 5 : 6;
+	}
+
+	bool is_local(const Fixup& jump, size_t section) {
+		return labels[jump.target].section == section;
+	}
+
+	//the bytes before the label are moved by the sizes of the fixups before it
+	size_t offset(const Label& label) {
+		const Section& s = sections[label.section];
+		if(label.fixups == s.fixups.size()) {
+			return label.position + s.size - s.bytes.size();
+		}
+		const Fixup& next = s.fixups[label.fixups];
+		return label.position + next.offset - next.position;
+	}
+
+	//jumps start short and become near ones until all of them reach their targets, they never shrink back so this ends
+	void layout(Section& s, size_t index) {
+		for(Fixup& fixup : s.fixups) {
+			fixup.is_short = fixup.kind == Fixup::Kind::Jump && fixup.condition != CALL && is_local(fixup, index);
+		}
+		bool changed = true;
+		while(changed) {
+			changed = false;
+			size_t shift = 0;
+			for(Fixup& fixup : s.fixups) {
+				fixup.offset = fixup.position + shift;
+				shift += fixup_size(fixup, fixup.offset);
+			}
+			s.size = s.bytes.size() + shift;
+			for(Fixup& fixup : s.fixups) {
+				if(fixup.is_short && !fits_in_byte((int64_t) offset(labels[fixup.target]) - (int64_t) (fixup.offset + 2))) {
+					fixup.is_short = false;
+					changed = true;
+				}
+			}
+		}
+	}
+
+	//puts the fixups between the encoded bytes, the relocations move with the bytes
+	void emit(Section& s, size_t index) {
+		std::vector<uint8_t> bytes;
+		std::vector<Relocation> relocations;
+		bytes.reserve(s.size);
+		Encoder e(bytes, relocations);
+		size_t position = 0;
+		size_t relocation = 0;
+		auto copy = [&](size_t end) {
+			size_t shift = bytes.size() - position;
+			for(; relocation < s.relocations.size() && s.relocations[relocation].offset < end; ++relocation) {
+				relocations.push_back(s.relocations[relocation]);
+				relocations.back().offset += shift;
+			}
+			bytes.insert(bytes.end(), s.bytes.begin() + position, s.bytes.begin() + end);
+			position = end;
+		};
+		for(const Fixup& fixup : s.fixups) {
+			copy(fixup.position);
+			if(fixup.kind == Fixup::Kind::Align) {
+				for(size_t pad = fixup_size(fixup, fixup.offset); pad;) {
+					size_t nop = std::min(pad, NOPS.size());
+					if(s.flags & SHF_EXECINSTR) {
+						bytes.insert(bytes.end(), NOPS[nop - 1].begin(), NOPS[nop - 1].end());
+					} else {
+						e.word(0, nop);
+					}
+					pad -= nop;
+				}
+				continue;
+			}
+			if(fixup.is_short) {
+				e.byte(fixup.condition == JMP ? 0xeb : 0x70 | fixup.condition);
+			} else if(fixup.condition < 0) {
+				e.byte(fixup.condition == JMP ? 0xe9 : 0xe8);
+			} else {
+				e.byte(0x0f);
+				e.byte(0x80 | fixup.condition);
+			}
+			Operand target;
+			if(is_local(fixup, index)) {
+				target.value = (int64_t) labels[fixup.target].offset - (int64_t) (fixup.offset + fixup_size(fixup, fixup.offset));
+			} else {
+				target.symbol = fixup.target;
+				target.value = -4;
+			}
+			e.immediate(target, fixup.is_short ? 1 : 4, R_X86_64_PC32);
+		}
+		copy(s.bytes.size());
+		s.bytes.swap(bytes);
+		s.relocations.swap(relocations);
+		s.fixups.clear();
+		s.fixups.shrink_to_fit();
+	}
+
+public:
+	void line(Text text) {
+		Text code = trim(Text{text.begin, std::find(text.begin, text.end, ';')});
+		if(code.empty()) {
+			return;
+		}
+		try {
+			Text rest;
+			Text first = first_word(code, rest);
+			Text args;
+			Text second = first_word(rest, args);
+			if(first.end[-1] == ':') {
+				label(Text{first.begin, first.end - 1});
+				line(rest);
+			} else if(first == "section") {
+				switch_section(second.str());
+			} else if(first == "global") {
+				globals.insert(rest.str());
+			} else if(first == "extern") {
+				externs.insert(rest.str());
+			} else if(first == "align") {
+				int64_t alignment;
+				if(!parse_number(rest, alignment) || alignment <= 0 || (alignment & (alignment - 1))) {
+					throw std::runtime_error("invalid alignment");
+				}
+				add(Fixup::Kind::Align).alignment = alignment;
+				section().alignment = std::max(section().alignment, (size_t) alignment);
+			} else if(is_data(first)) {
+				data(first, rest);
+			} else if(is_data(second)) {
+				label(first);
+				data(second, args);
+			} else {
+				instruction(first.str(), rest);
+			}
+		} catch(const std::runtime_error& e) {
+			throw std::runtime_error("Can't assemble \"" + code.str() + "\": " + e.what() + ".");
+		}
+	}
+
+	void write(std::ostream& output);
+
+	size_t instruction_count() const {
+		return instructions;
+	}
+
+	Assembler() : current(NO_SECTION), instructions(0) {}
+};
+
+void Assembler::write(std::ostream& output) {
+	for(size_t i = 0; i < sections.size(); ++i) {
+		layout(sections[i], i);
+	}
+	for(uint32_t label : definitions) {
+		labels[label].offset = offset(labels[label]);
+	}
+	for(size_t i = 0; i < sections.size(); ++i) {
+		emit(sections[i], i);
+	}
+
+	//the null symbol, local labels, then the global and the external ones
+	StringTable strings;
+	std::vector<uint32_t> symbols(1, NO_SYMBOL);
+	for(uint32_t label : definitions) {
+		if(!globals.count(labels[label].name)) {
+			symbols.push_back(label);
+		}
+	}
+	size_t first_global = symbols.size();
+	for(const std::string& global : globals) {
+		uint32_t label = labels.number(global);
+		if(labels[label].section == NO_SECTION) {
+			throw std::runtime_error("Global symbol " + global + " isn't defined.");
+		}
+		symbols.push_back(label);
+	}
+	for(const std::string& external : externs) {
+		uint32_t label = labels.number(external);
+		if(labels[label].section != NO_SECTION) {
+			throw std::runtime_error("External symbol " + external + " is defined.");
+		}
+		symbols.push_back(label);
+	}
+	std::vector<size_t> symbol_indices(labels.size(), 0);
+	for(size_t i = 1; i < symbols.size(); ++i) {
+		symbol_indices[symbols[i]] = i;
+	}
+
+	Buffer file;
+	StringTable section_names;
+	std::vector<SectionHeader> headers(1, SectionHeader{0, 0, 0, 0, 0, 0, 0, 0, 0, 0});
+	file.word(0, HEADER_SIZE);
+	for(const Section& s : sections) {
+		file.align(s.alignment);
+		headers.push_back({section_names.add(s.name), s.type, s.flags, 0, file.size(), s.size, 0, 0, s.alignment, 0});
+		if(s.type != SHT_NOBITS) {
+			file.append(s.bytes);
+		}
+	}
+	size_t symbol_table = headers.size() + std::count_if(sections.begin(), sections.end(), [](const Section& s) {
+		return !s.relocations.empty();
+	});
+	for(size_t i = 0; i < sections.size(); ++i) {
+		if(sections[i].relocations.empty()) {
+			continue;
+		}
+		file.align(8);
+		headers.push_back({section_names.add(".rela" + sections[i].name), SHT_RELA, SHF_INFO_LINK, 0, file.size(), sections[i].relocations.size() * RELOCATION_SIZE, (uint32_t) symbol_table, (uint32_t) i + 1, 8, RELOCATION_SIZE});
+		for(const Relocation& r : sections[i].relocations) {
+			size_t symbol = symbol_indices[r.symbol];
+			if(!symbol) {
+				throw std::runtime_error("Symbol " + labels[r.symbol].name + " isn't defined.");
+			}
+			file.word(r.offset, 8);
+			file.word((uint64_t) symbol << 32 | r.type, 8);
+			file.word(r.addend, 8);
+		}
+	}
+
+	file.align(8);
+	headers.push_back({section_names.add(".symtab"), SHT_SYMTAB, 0, 0, file.size(), symbols.size() * SYMBOL_SIZE, (uint32_t) symbol_table + 1, (uint32_t) first_global, 8, SYMBOL_SIZE});
+	for(size_t i = 0; i < symbols.size(); ++i) {
+		const Label& label = labels[symbols[i]];
+		bool defined = label.section != NO_SECTION;
+		write_symbol(file, i ? strings.add(label.name) : 0, i < first_global ? STB_LOCAL : STB_GLOBAL << 4, defined ? label.section + 1 : SHN_UNDEF, defined ? label.offset : 0);
+	}
+	headers.push_back({section_names.add(".strtab"), SHT_STRTAB, 0, 0, file.size(), strings.bytes.size(), 0, 0, 1, 0});
+	file.append(strings.bytes);
+	size_t shstrtab_name = section_names.add(".shstrtab");
+	headers.push_back({shstrtab_name, SHT_STRTAB, 0, 0, file.size(), section_names.bytes.size(), 0, 0, 1, 0});
+	file.append(section_names.bytes);
+
+	file.align(8);
+	size_t section_headers = file.size();
+	for(const SectionHeader& h : headers) {
+		write_section_header(file, h);
+	}
+	write_header(file, ET_REL, 0, 0, section_headers, headers.size());
+	file.write(output);
+}
+
+
+AssemblingBuffer::AssemblingBuffer() : assembler(new Assembler), buffer(BUFFER_SIZE) {
+	setp(buffer.data(), buffer.data() + buffer.size());
+}
+
+AssemblingBuffer::~AssemblingBuffer() {}
+
+void AssemblingBuffer::consume(const char* begin, const char* end) {
+	if(error) {
+		return;
+	}
+	//streams swallow exceptions of their buffers, so the first one waits for write
+	try {
+		while(begin != end) {
+			const char* newline = std::find(begin, end, '\n');
+			if(newline == end) {
+				line.append(begin, end);
+				break;
+			}
+			//only a line split by the end of the buffer is copied
+			if(line.empty()) {
+				assembler->line(Text{begin, newline});
+			} else {
+				line.append(begin, newline);
+				assembler->line(text(line));
+				line.clear();
+			}
+			begin = newline + 1;
+		}
+	} catch(...) {
+		error = std::current_exception();
+	}
+}
+
+int AssemblingBuffer::overflow(int c) {
+	consume(pbase(), pptr());
+	setp(buffer.data(), buffer.data() + buffer.size());
+	if(c != traits_type::eof()) {
+		char ch = c;
+		consume(&ch, &ch + 1);
+	}
+	return traits_type::not_eof(c);
+}
+
+void AssemblingBuffer::write(std::ostream& output) {
+	overflow(traits_type::eof());
+	consume("\n", "\n" + 1);
+	if(error) {
+		std::rethrow_exception(error);
+	}
+	assembler->write(output);
+}
+
+size_t AssemblingBuffer::instructions() const {
+	return assembler->instruction_count();
+}
@@ -0,0 +1,38 @@
+#ifndef ASSEMBLER_H
+#define ASSEMBLER_H
+
+#include <exception>
+#include <memory>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+class Assembler;
+
+//encodes the NASM subset emitted by the backend into an ELF64 relocatable object, each line as soon as it's written
+class AssemblingBuffer : public std::streambuf {
+	static const size_t BUFFER_SIZE = 1 << 16;
+
+	std::unique_ptr<Assembler> assembler;
+	std::vector<char> buffer;
+	std::string line; //the incomplete last line
+	std::exception_ptr error;
+
+	void consume(const char* begin, const char* end);
+
+protected:
+	virtual int overflow(int c);
+
+public:
+	//throws if anything written couldn't be assembled
+	void write(std::ostream& output);
+
+	//encoded so far
+	size_t instructions() const;
+
+	AssemblingBuffer();
+	~AssemblingBuffer();
+};
+
+#endif
@@ -3,10 +3,27 @@
 
 #include "program_tree.h"
 #include "type_info_builder.h"
+#include "profile.h"
 
 #include <ostream>
+#include <set>
+#include <string>
+#include <vector>
 
-void emit_code(const TypeChecker::TypeInfo& info, std::ostream& output);
+//an instrumented program counts the executions of branches, loops and receivers of virtual calls, the functions are generated on the given number of threads, the output doesn't depend on it
+void emit_code(const TypeChecker::TypeInfo& info, std::ostream& output, const Optimizer::Instrumentation* instrumentation = nullptr, size_t threads = 1);
+
+//splits the program into an assembly shard for each output, the shards can be assembled separately and linked together, the first one has the entry point
+void emit_code(const TypeChecker::TypeInfo& info, const std::vector<std::ostream*>& outputs, const Optimizer::Instrumentation* instrumentation = nullptr, size_t threads = 1);
+
+//the code of a module of the program: the given global functions and classes, with the entry point if main is among them, the rest of the program is linked in from the other modules
+void emit_module_code(const TypeChecker::TypeInfo& info, const std::set<std::string>& functions, const std::set<std::string>& classes, std::ostream& output, size_t threads = 1);
+
+//how many shards are worth assembling in parallel, it depends only on the program
+size_t count_shards(const TypeChecker::TypeInfo& info);
+
+//textual LLVM IR of the program, to be compiled by clang and linked with the runtime, the runtime is called through thunks in module-level assembly
+void emit_llvm_ir(const TypeChecker::TypeInfo& info, std::ostream& output);
 
 
 #endif
@@ -0,0 +1,973 @@
+#include "backend.h"
+#include "program_tree.h"
+#include "helper_visitors.h"
+#include "compile_time_evaluation.h"
+
+#include <sstream>
+#include <stack>
+
+using namespace ProgramTree;
+using namespace TypeChecker;
+
+namespace {
+	const std::string STRING_TYPE = "%string";
+	const std::string ARRAY_TYPE = "%array";
+	const std::string VTABLE_TYPE = "i8**";
+	const std::string NULL_TYPE = Token::TYPE_NAMES.at(Token::Type::KEYWORD_NULL);
+	const std::string ERROR_FUN_NAME = "error";
+
+	//the runtime takes the arguments on the stack and clobbers every register, each of its functions is called through a thunk following the C calling convention
+	const std::string THUNK_PREFIX = "_latte.";
+	const char* const ARGUMENT_REGISTERS[] = {"%rdi", "%rsi"};
+	const char* const SAVED_REGISTERS[] = {"%rbx", "%rbp", "%r12", "%r13", "%r14", "%r15"};
+
+	const std::string ALLOC_THUNK = THUNK_PREFIX + "alloc";
+	const std::string NEW_ARRAY_THUNK = THUNK_PREFIX + "new_array";
+	const std::string CONCAT_THUNK = THUNK_PREFIX + "concat";
+	const std::string CONCAT_N_THUNK = THUNK_PREFIX + "concat_n";
+
+	const std::string HEADER = "target datalayout = \"e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128\"\n"
+		"target triple = \"x86_64-pc-linux-gnu\"\n\n"
+		"%string = type { i64, [0 x i8] }\n"
+		"%array = type { i64, [0 x i64] }\n\n"
+		"@_empty_str = external dso_local global %string\n"
+		"@_empty_arr = external dso_local global %array\n";
+
+	//the code may still get calls to these from the optimizer, there is no C library to provide them
+	const char* const MEMORY_FUNCTIONS[] = {
+		"memset:", "movq %rdi, %r8", "movl %esi, %eax", "movq %rdx, %rcx", "rep stosb", "movq %r8, %rax", "retq",
+		"memcpy:", "movq %rdi, %rax", "movq %rdx, %rcx", "rep movsb", "retq",
+		"memmove:", "movq %rdi, %rax", "movq %rdx, %rcx", "cmpq %rsi, %rdi", "jbe 1f", "leaq -1(%rsi,%rdx), %rsi", "leaq -1(%rdi,%rdx), %rdi", "std", "rep movsb", "cld", "retq", "1:", "rep movsb", "retq"
+	};
+
+	std::string encode_class_function_name(const std::string& cl, const std::string& fun) {
+		return "_class_" + cl + '$' + fun;
+	}
+
+	std::string encode_constructor_name(const std::string& cl) {
+		return "_class_$" + cl;
+	}
+
+	std::string encode_vtable_name(const std::string& cl) {
+		return "_class_@" + cl;
+	}
+
+	std::string global(const std::string& name) {
+		return "@\"" + name + '"';
+	}
+
+	std::string class_type(const std::string& cl) {
+		return "%\"class." + cl + '"';
+	}
+
+	bool is_pointer(const std::string& type) {
+		return type.back() == '*';
+	}
+
+	//booleans are i1 in the registers and the local variables
+	std::string value_type(const std::string& type) {
+		if(type == INT_NAME) {
+			return "i64";
+		} else if(type == BOOL_NAME) {
+			return "i1";
+		} else if(type == VOID_NAME) {
+			return "void";
+		} else if(type == STR_NAME) {
+			return STRING_TYPE + '*';
+		} else if(is_array(type)) {
+			return ARRAY_TYPE + '*';
+		} else if(type == NULL_TYPE) {
+			return "i8*";
+		}
+		return class_type(type) + '*';
+	}
+
+	//fields and elements take 8 bytes each, like in the x86_64 backend
+	std::string memory_type(const std::string& type) {
+		return type == BOOL_NAME ? "i64" : value_type(type);
+	}
+
+	std::string default_value(const std::string& type) {
+		if(is_array(type)) {
+			return "@_empty_arr";
+		} else if(type == STR_NAME) {
+			return "@_empty_str";
+		} else if(type == INT_NAME || type == BOOL_NAME) {
+			return type == BOOL_NAME ? "false" : "0";
+		}
+		return "null";
+	}
+
+	std::string default_memory_value(const std::string& type) {
+		return type == BOOL_NAME ? "0" : default_value(type);
+	}
+
+	//new arrays of strings are filled with the empty one, the others with zeros
+	std::string array_fill(const std::string& element_type) {
+		return element_type == STR_NAME ? "ptrtoint (" + STRING_TYPE + "* @_empty_str to i64)" : "0";
+	}
+
+	std::string string_literal_type(const std::string& val) {
+		return "{ i64, [" + std::to_string(val.size()) + " x i8] }";
+	}
+
+	std::string string_literal_name(size_t id) {
+		return "@.string." + std::to_string(id);
+	}
+
+	std::string constant_name(size_t id) {
+		return "@.constant." + std::to_string(id);
+	}
+
+	std::string constant_type(size_t size) {
+		return "{ i64, [" + std::to_string(size) + " x i64] }";
+	}
+
+	std::string arguments(const std::vector<std::pair<Type, std::string>>& args) {
+		std::string result;
+		for(const auto& arg : args) {
+			result += (result.empty() ? "" : ", ") + value_type(arg.first);
+		}
+		return result;
+	}
+
+	//methods get the object as their last argument, like in the x86_64 backend
+	std::vector<std::pair<Type, std::string>> method_arguments(const VirtualFunctionInfo& fun) {
+		auto result = fun.args;
+		result.push_back(std::make_pair(fun.class_info->data->name, THIS_NAME));
+		return result;
+	}
+
+	std::string function_type(const std::string& return_type, const std::vector<std::pair<Type, std::string>>& args) {
+		return value_type(return_type) + " (" + arguments(args) + ")";
+	}
+
+	template<typename T>
+	void do_print(std::ostream& o, const T& t) {
+		o << t;
+	}
+
+	template<typename T, typename ...Ts>
+	void do_print(std::ostream& o, const T& t, Ts... args) {
+		o << t;
+		do_print(o, args...);
+	}
+
+	template<typename T>
+	void print(std::ostream& o, const T& t) {
+		o << t << '\n';
+	}
+
+	template<typename T, typename ...Ts>
+	void print(std::ostream& o, const T& t, Ts... args) {
+		o << t;
+		do_print(o, args...);
+		o << '\n';
+	}
+
+	//literals and constant arrays of the whole module
+	struct Module {
+		std::map<std::string, size_t> string_literals;
+		std::vector<std::pair<size_t, const ConstantArray*>> constant_arrays;
+		size_t next_id;
+
+		size_t string_literal_id(const std::string& val) {
+			auto it = string_literals.find(val);
+			if(it != string_literals.end()) {
+				return it->second;
+			}
+			string_literals[val] = next_id;
+			return next_id++;
+		}
+
+		std::string string_literal(const std::string& val) {
+			return "bitcast (" + string_literal_type(val) + "* " + string_literal_name(string_literal_id(val)) + " to " + STRING_TYPE + "*)";
+		}
+
+		Module() : next_id(0) {}
+	};
+
+	struct Value {
+		std::string type;
+		std::string name;
+	};
+
+	//a local variable holds the value type, fields and elements the memory type
+	struct Address {
+		std::string pointer;
+		bool memory;
+	};
+
+	//the vtable, then the fields with their default values
+	std::string initial_object(const ClassInfo& cl) {
+		std::string result = "{ " + VTABLE_TYPE + " getelementptr inbounds ([" + std::to_string(cl.functions.size()) + " x i8*], [" + std::to_string(cl.functions.size()) + " x i8*]* " + global(encode_vtable_name(cl.data->name)) + ", i32 0, i32 0)";
+		for(const auto& var : cl.variables) {
+			result += ", " + memory_type(var.first) + ' ' + default_memory_value(var.first);
+		}
+		return result + " }";
+	}
+
+	//mutable variables live in allocas of the entry block, LLVM promotes them to registers
+	class LlvmIr : public ConstVisitor {
+		const TypeInfo& info;
+		std::ostream& output;
+		std::ostream& allocas;
+		Module& module;
+		const std::vector<std::pair<Type, std::string>>& function_args;
+		const std::string& return_type;
+		size_t registers;
+		size_t labels;
+		std::string block; //the label of the current basic block
+		bool terminated; //the current block has ended, instructions need a new one
+		Value result; //of the last visited expression
+		std::stack<std::string> variable_names; //local variables in the order of their declarations
+		std::map<std::string, std::stack<std::pair<std::string, std::string>>> variables; //name to stack of allocas with the types
+		std::stack<size_t> last_block_variables; //how many variables have been declared in the current block
+
+		template<typename ...Ts>
+		void emit(Ts... args) {
+			if(terminated) {
+				start_block(new_label("dead"));
+			}
+			::print(output, "  ", args...);
+		}
+
+		template<typename ...Ts>
+		std::string assign(Ts... args) {
+			std::string name = "%r" + std::to_string(registers++);
+			emit(name, " = ", args...);
+			return name;
+		}
+
+		template<typename ...Ts>
+		void terminate(Ts... args) {
+			emit(args...);
+			terminated = true;
+		}
+
+		std::string new_label(const std::string& name) {
+			return name + '.' + std::to_string(labels++);
+		}
+
+		std::string new_alloca(const std::string& type) {
+			std::string name = "%slot" + std::to_string(registers++);
+			::print(allocas, "  ", name, " = alloca ", type);
+			return name;
+		}
+
+		void start_block(const std::string& label) {
+			if(!terminated) {
+				::print(output, "  br label %", label);
+			}
+			::print(output, label, ':');
+			block = label;
+			terminated = false;
+		}
+
+		void branch(const std::string& condition, const std::string& then_label, const std::string& else_label) {
+			terminate("br i1 ", condition, ", label %", then_label, ", label %", else_label);
+		}
+
+		Value evaluate(const Expression& expr) {
+			expr.visit(this);
+			return result;
+		}
+
+		//class pointers change their type on implicit and explicit casts, null fits every pointer
+		std::string convert(const Value& value, const std::string& type) {
+			if(value.type == type || value.name == "null") {
+				return value.name;
+			}
+			return assign("bitcast ", value.type, ' ', value.name, " to ", type);
+		}
+
+		void fail() {
+			emit("call void ", global(THUNK_PREFIX + ERROR_FUN_NAME), "()");
+			terminate("unreachable");
+		}
+
+		void check(const std::string& condition) {
+			std::string ok = new_label("ok");
+			std::string error = new_label("error");
+			branch(condition, ok, error);
+			start_block(error);
+			fail();
+			start_block(ok);
+		}
+
+		Value load(const Address& address, const std::string& latte_type) {
+			std::string type = address.memory ? memory_type(latte_type) : value_type(latte_type);
+			std::string name = assign("load ", type, ", ", type, "* ", address.pointer);
+			if(type != value_type(latte_type)) {
+				name = assign("trunc ", type, ' ', name, " to i1");
+			}
+			return {value_type(latte_type), name};
+		}
+
+		void store(const Address& address, const std::string& latte_type, const Value& value) {
+			std::string name = convert(value, value_type(latte_type));
+			std::string type = address.memory ? memory_type(latte_type) : value_type(latte_type);
+			if(type != value_type(latte_type)) {
+				name = assign("zext i1 ", name, " to ", type);
+			}
+			emit("store ", type, ' ', name, ", ", type, "* ", address.pointer);
+		}
+
+		std::string array_length(const Value& array) {
+			std::string pointer = assign("getelementptr inbounds ", ARRAY_TYPE, ", ", array.type, ' ', array.name, ", i32 0, i32 0");
+			return assign("load i64, i64* ", pointer);
+		}
+
+		Address element_address(const Value& array, const std::string& index, const std::string& latte_type) {
+			std::string pointer = assign("getelementptr inbounds ", ARRAY_TYPE, ", ", array.type, ' ', array.name, ", i64 0, i32 1, i64 ", index);
+			std::string type = memory_type(latte_type);
+			if(type != "i64") {
+				pointer = assign("bitcast i64* ", pointer, " to ", type, '*');
+			}
+			return {pointer, true};
+		}
+
+		class GetAddr : public DefaultConstVisitor {
+			LlvmIr* parent;
+			Address& address;
+			GetAddr() = delete;
+		public:
+			GetAddr(LlvmIr* parent, Address& address) : parent(parent), address(address) {}
+
+			virtual void default_action() override {
+				throw std::runtime_error("expected address of a non-variable variable, type checker error");
+			}
+
+			virtual void apply(const Variable& arg) override {
+				const auto& slot = parent->variable(arg.name);
+				address = {slot.first, false};
+			}
+
+			//the index is evaluated before the array, like in the x86_64 backend, a negative one is out of the bounds too
+			virtual void apply(const SubscriptOperator& arg) override {
+				Value index = parent->evaluate(*arg.index);
+				Value array = parent->evaluate(*arg.arr);
+				std::string length = parent->array_length(array);
+				parent->check(parent->assign("icmp ult i64 ", index.name, ", ", length));
+				address = parent->element_address(array, index.name, arg.type);
+			}
+
+			virtual void apply(const Cast& arg) override {
+				arg.expr->visit(this);
+			}
+
+			virtual void apply(const ClassMember& arg) override {
+				Value object = parent->evaluate(*arg.object);
+				const ClassInfo& cl = *parent->info.classes.at(arg.object->type);
+				std::string type = class_type(arg.object->type);
+				std::string pointer = parent->convert(object, type + '*');
+				address = {parent->assign("getelementptr inbounds ", type, ", ", type, "* ", pointer, ", i32 0, i32 ", cl.variable_name_to_id.at(arg.member) + 1), true};
+			}
+		};
+
+		Address address_of(const Expression& expr) {
+			Address result;
+			GetAddr ga(this, result);
+			expr.visit(&ga);
+			return result;
+		}
+
+		const std::pair<std::string, std::string>& variable(const std::string& name) {
+			auto it = variables.find(name);
+			if(it == variables.end()) {
+				throw std::runtime_error("function in GetAddr::apply(const Variable&), type checker error!");
+			}
+			return it->second.top();
+		}
+
+		void declare(const std::string& name, const std::string& type, const std::string& slot) {
+			++last_block_variables.top();
+			variables[name].push(std::make_pair(slot, type));
+			variable_names.push(name);
+		}
+
+		void undeclare() {
+			auto it = variables.find(variable_names.top());
+			it->second.pop();
+			if(it->second.empty()) {
+				variables.erase(it);
+			}
+			variable_names.pop();
+			--last_block_variables.top();
+		}
+
+		//the right operand is evaluated first, like in the x86_64 backend
+		void int_op(const Expression& l, const Expression& r, const std::string& op) {
+			Value b = evaluate(r);
+			Value a = evaluate(l);
+			result = {"i64", assign(op, " i64 ", a.name, ", ", b.name)};
+		}
+
+		//division by zero is an error, the quotient of the smallest int and -1 wraps around
+		void int_div(const Expression& l, const Expression& r, bool remainder) {
+			Value b = evaluate(r);
+			Value a = evaluate(l);
+			check(assign("icmp ne i64 ", b.name, ", 0"));
+			std::string minus_one = assign("icmp eq i64 ", b.name, ", -1");
+			std::string divisor = assign("select i1 ", minus_one, ", i64 1, i64 ", b.name);
+			std::string quotient = assign(remainder ? "srem" : "sdiv", " i64 ", a.name, ", ", divisor);
+			std::string special = remainder ? "0" : assign("sub i64 0, ", a.name);
+			result = {"i64", assign("select i1 ", minus_one, ", i64 ", special, ", i64 ", quotient)};
+		}
+
+		void compare(const Expression& l, const Expression& r, const std::string& condition) {
+			Value b = evaluate(r);
+			Value a = evaluate(l);
+			std::string type = a.type;
+			if(is_pointer(a.type) || is_pointer(b.type)) {
+				type = "i8*";
+			}
+			result = {"i1", assign("icmp ", condition, ' ', type, ' ', convert(a, type), ", ", convert(b, type))};
+		}
+
+		void boolean_op(const Expression& l, const Expression& r, bool conjunction) {
+			Value a = evaluate(l);
+			std::string from = block;
+			std::string right = new_label("right");
+			std::string done = new_label("done");
+			if(conjunction) {
+				branch(a.name, right, done);
+			} else {
+				branch(a.name, done, right);
+			}
+			start_block(right);
+			Value b = evaluate(r);
+			std::string right_end = block;
+			start_block(done);
+			result = {"i1", assign("phi i1 [ ", conjunction ? "false" : "true", ", %", from, " ], [ ", b.name, ", %", right_end, " ]")};
+		}
+
+		std::string call_arguments(const std::vector<std::unique_ptr<Expression>>& args, const std::vector<std::string>& types) {
+			std::vector<Value> values;
+			for(const auto& a : args) {
+				values.push_back(evaluate(*a));
+			}
+			std::string result;
+			for(size_t i = 0; i < values.size(); ++i) {
+				result += (i ? ", " : "") + value_type(types[i]) + ' ' + convert(values[i], value_type(types[i]));
+			}
+			return result;
+		}
+
+		void call(const std::string& return_type, const std::string& target, const std::string& args) {
+			if(return_type == VOID_NAME) {
+				emit("call void ", target, '(', args, ')');
+				result = {"void", ""};
+			} else {
+				result = {value_type(return_type), assign("call ", value_type(return_type), ' ', target, '(', args, ')')};
+			}
+		}
+
+		std::string constant_array(const ConstantArray& c) {
+			size_t id = module.next_id++;
+			module.constant_arrays.emplace_back(id, &c);
+			size_t size = c.values.size();
+			return "bitcast (" + constant_type(size) + "* " + constant_name(id) + " to " + ARRAY_TYPE + "*)";
+		}
+
+		//the parts are passed in an array with their total length
+		void concat_n(const StaticFunctionCall& arg) {
+			std::string parts_type = "[" + std::to_string(arg.args.size()) + " x " + STRING_TYPE + "*]";
+			std::string parts = new_alloca(parts_type);
+			std::string total = "0";
+			for(size_t i = 0; i < arg.args.size(); ++i) {
+				Value part = evaluate(*arg.args[i]);
+				std::string pointer = assign("getelementptr inbounds ", parts_type, ", ", parts_type, "* ", parts, ", i64 0, i64 ", i);
+				emit("store ", part.type, ' ', part.name, ", ", part.type, "* ", pointer);
+				std::string length = assign("getelementptr inbounds ", STRING_TYPE, ", ", part.type, ' ', part.name, ", i32 0, i32 0");
+				total = assign("add i64 ", total, ", ", assign("load i64, i64* ", length));
+			}
+			std::string first = assign("getelementptr inbounds ", parts_type, ", ", parts_type, "* ", parts, ", i64 0, i64 0");
+			result = {STRING_TYPE + '*', assign("call ", STRING_TYPE, "* ", global(CONCAT_N_THUNK), '(', STRING_TYPE, "** ", first, ", i64 ", arg.args.size(), ", i64 ", total, ')')};
+		}
+
+		//objects and arrays the escape analysis put on the stack get an alloca, they're initialized where they're created
+		void allocate_on_stack(const NewObject& arg) {
+			std::string type = class_type(arg.new_type);
+			std::string slot = new_alloca(type);
+			emit("store ", type, ' ', initial_object(*info.classes.at(arg.new_type)), ", ", type, "* ", slot);
+			result = {type + '*', slot};
+		}
+
+		void allocate_on_stack(const NewArray& arg) {
+			const literal_type<LiteralType::Integer>::type* size = nullptr;
+			LiteralGetter<LiteralType::Integer> lg(size);
+			arg.size->visit(&lg);
+			std::string type = constant_type(*size);
+			std::string slot = new_alloca(type);
+			std::string elements = *size ? "" : "zeroinitializer";
+			for(Integer i = 0; i < *size; ++i) {
+				elements += (i ? ", i64 " : "[i64 ") + array_fill(arg.new_type);
+			}
+			emit("store ", type, " { i64 ", *size, ", [", *size, " x i64] ", elements, *size ? "]" : "", " }, ", type, "* ", slot);
+			result = {ARRAY_TYPE + '*', assign("bitcast ", type, "* ", slot, " to ", ARRAY_TYPE, '*')};
+		}
+
+	public:
+		virtual void apply(const BinaryOperator<BinOpType::Addition>& arg) {
+			int_op(*arg.left, *arg.right, "add");
+		}
+		virtual void apply(const BinaryOperator<BinOpType::Substraction>& arg) {
+			int_op(*arg.left, *arg.right, "sub");
+		}
+		virtual void apply(const BinaryOperator<BinOpType::Multiplication>& arg) {
+			int_op(*arg.left, *arg.right, "mul");
+		}
+		virtual void apply(const BinaryOperator<BinOpType::Division>& arg) {
+			int_div(*arg.left, *arg.right, false);
+		}
+		virtual void apply(const BinaryOperator<BinOpType::Modulo>& arg) {
+			int_div(*arg.left, *arg.right, true);
+		}
+		virtual void apply(const BinaryOperator<BinOpType::Alternative>& arg) {
+			boolean_op(*arg.left, *arg.right, false);
+		}
+		virtual void apply(const BinaryOperator<BinOpType::Conjunction>& arg) {
+			boolean_op(*arg.left, *arg.right, true);
+		}
+		virtual void apply(const BinaryOperator<BinOpType::LessThan>& arg) {
+			compare(*arg.left, *arg.right, "slt");
+		}
+		virtual void apply(const BinaryOperator<BinOpType::LessEqual>& arg) {
+			compare(*arg.left, *arg.right, "sle");
+		}
+		virtual void apply(const BinaryOperator<BinOpType::GreaterThan>& arg) {
+			compare(*arg.left, *arg.right, "sgt");
+		}
+		virtual void apply(const BinaryOperator<BinOpType::GreaterEqual>& arg) {
+			compare(*arg.left, *arg.right, "sge");
+		}
+		virtual void apply(const BinaryOperator<BinOpType::Equal>& arg) {
+			compare(*arg.left, *arg.right, "eq");
+		}
+		virtual void apply(const BinaryOperator<BinOpType::NotEqual>& arg) {
+			compare(*arg.left, *arg.right, "ne");
+		}
+		virtual void apply(const UnaryOperator<UnOpType::IntNegation>& arg) {
+			Value a = evaluate(*arg.expr);
+			result = {"i64", assign("sub i64 0, ", a.name)};
+		}
+		virtual void apply(const UnaryOperator<UnOpType::BoolNegation>& arg) {
+			Value a = evaluate(*arg.expr);
+			result = {"i1", assign("xor i1 ", a.name, ", true")};
+		}
+		virtual void apply(const Literal<LiteralType::Bool>& arg) {
+			result = {"i1", arg.val ? "true" : "false"};
+		}
+		virtual void apply(const Literal<LiteralType::Integer>& arg) {
+			result = {"i64", std::to_string(arg.val)};
+		}
+		virtual void apply(const Literal<LiteralType::String>& arg) {
+			result = {STRING_TYPE + '*', module.string_literal(arg.val)};
+		}
+		virtual void apply(const Variable& arg) {
+			const auto& slot = variable(arg.name);
+			result = load({slot.first, false}, slot.second);
+		}
+		virtual void apply(const Null& arg) {
+			(void) arg;
+			result = {"i8*", "null"};
+		}
+		virtual void apply(const StaticFunctionCall& arg) {
+			if(arg.constant) {
+				result = {ARRAY_TYPE + '*', constant_array(*arg.constant)};
+				return;
+			}
+			if(arg.fun == CONCAT_N_FUN_NAME) {
+				concat_n(arg);
+				return;
+			}
+			if(arg.fun == CONCAT_FUN_NAME) {
+				call(STR_NAME, global(CONCAT_THUNK), call_arguments(arg.args, {STR_NAME, STR_NAME}));
+				return;
+			}
+			auto builtin = BUILTIN_FUNCTIONS.find(arg.fun);
+			if(builtin != BUILTIN_FUNCTIONS.end()) {
+				call(builtin->second.first, global(THUNK_PREFIX + arg.fun), call_arguments(arg.args, builtin->second.second));
+				if(arg.fun == ERROR_FUN_NAME) {
+					terminate("unreachable");
+				}
+				return;
+			}
+			const FunctionInfo& fun = *info.functions.at(arg.fun);
+			std::vector<std::string> types;
+			for(const auto& a : fun.args) {
+				types.push_back(a.first);
+			}
+			call(fun.return_type, global(arg.fun), call_arguments(arg.args, types));
+		}
+		//the arguments are evaluated before the object, like in the x86_64 backend
+		virtual void apply(const VirtualFunctionCall& arg) {
+			const ClassInfo& cl = *info.classes.at(arg.object->type);
+			size_t id = cl.function_name_to_id.at(arg.fun);
+			const VirtualFunctionInfo& fun = *cl.functions[id];
+			std::vector<std::string> types;
+			for(const auto& a : fun.args) {
+				types.push_back(a.first);
+			}
+			std::string args = call_arguments(arg.args, types);
+			Value object = evaluate(*arg.object);
+			std::string type = class_type(arg.object->type);
+			std::string self = convert(object, type + '*');
+			std::string vtable_pointer = assign("getelementptr inbounds ", type, ", ", type, "* ", self, ", i32 0, i32 0");
+			std::string vtable = assign("load ", VTABLE_TYPE, ", ", VTABLE_TYPE, "* ", vtable_pointer);
+			std::string entry = assign("getelementptr inbounds i8*, ", VTABLE_TYPE, ' ', vtable, ", i64 ", id);
+			std::string target = assign("load i8*, ", VTABLE_TYPE, ' ', entry);
+			auto signature = fun.args;
+			signature.push_back(std::make_pair(arg.object->type, THIS_NAME));
+			std::string function = assign("bitcast i8* ", target, " to ", function_type(fun.return_type, signature), '*');
+			call(fun.return_type, function, args + (args.empty() ? "" : ", ") + type + "* " + self);
+		}
+		virtual void apply(const CallOperator& arg) {
+			(void) arg;
+			throw std::runtime_error("Internal type checker error.");
+		}
+		virtual void apply(const SubscriptOperator& arg) {
+			result = load(address_of(arg), arg.type);
+		}
+		virtual void apply(const ClassMember& arg) {
+			if(is_array(arg.object->type)) {
+				Value array = evaluate(*arg.object);
+				result = {"i64", array_length(array)};
+			} else {
+				result = load(address_of(arg), arg.type);
+			}
+		}
+		virtual void apply(const Cast& arg) {
+			Value value = evaluate(*arg.expr);
+			result = {value_type(arg.target), convert(value, value_type(arg.target))};
+		}
+		virtual void apply(const NewObject& arg) {
+			if(arg.on_stack) {
+				allocate_on_stack(arg);
+			} else {
+				call(arg.new_type, global(encode_constructor_name(arg.new_type)), "");
+			}
+		}
+		virtual void apply(const NewArray& arg) {
+			if(arg.on_stack) {
+				allocate_on_stack(arg);
+				return;
+			}
+			Value size = evaluate(*arg.size);
+			result = {ARRAY_TYPE + '*', assign("call ", ARRAY_TYPE, "* ", global(NEW_ARRAY_THUNK), "(i64 ", array_fill(arg.new_type), ", i64 ", size.name, ')')};
+		}
+		//the value is evaluated before the address, like in the x86_64 backend
+		virtual void apply(const Assignment& arg) {
+			Value value = evaluate(*arg.value);
+			store(address_of(*arg.var), arg.var->type, value);
+		}
+		void add_to(const Expression& var, const std::string& amount) {
+			Address address = address_of(var);
+			Value value = load(address, INT_NAME);
+			store(address, INT_NAME, {"i64", assign("add i64 ", value.name, ", ", amount)});
+		}
+		virtual void apply(const Incrementation& arg) {
+			add_to(*arg.var, "1");
+		}
+		virtual void apply(const Decrementation& arg) {
+			add_to(*arg.var, "-1");
+		}
+		virtual void apply(const ExprStatement& arg) {
+			evaluate(*arg.expr);
+		}
+		virtual void apply(const Return& arg) {
+			if(arg.val) {
+				Value value = evaluate(*arg.val);
+				std::string type = value_type(return_type);
+				terminate("ret ", type, ' ', convert(value, type));
+			} else {
+				terminate("ret void");
+			}
+		}
+		virtual void apply(const If& arg) {
+			Value condition = evaluate(*arg.condition);
+			std::string then_label = new_label("then");
+			std::string else_label = new_label("else");
+			std::string done = new_label("endif");
+			branch(condition.name, then_label, arg.case_else ? else_label : done);
+			start_block(then_label);
+			arg.case_then->visit(this);
+			if(arg.case_else) {
+				if(!terminated) {
+					terminate("br label %", done);
+				}
+				start_block(else_label);
+				arg.case_else->visit(this);
+			}
+			start_block(done);
+		}
+		virtual void apply(const While& arg) {
+			std::string condition_label = new_label("condition");
+			std::string body = new_label("body");
+			std::string done = new_label("endwhile");
+			start_block(condition_label);
+			Value condition = evaluate(*arg.condition);
+			branch(condition.name, body, done);
+			start_block(body);
+			arg.action->visit(this);
+			terminate("br label %", condition_label);
+			start_block(done);
+		}
+		virtual void apply(const For& arg) {
+			Value array = evaluate(*arg.array);
+			std::string index = new_alloca("i64");
+			emit("store i64 0, i64* ", index);
+			std::string type = value_type(arg.var_type);
+			std::string element = new_alloca(type);
+			last_block_variables.push(0);
+			declare(arg.var_name, arg.var_type, element);
+
+			std::string condition_label = new_label("condition");
+			std::string body = new_label("body");
+			std::string done = new_label("endfor");
+			start_block(condition_label);
+			std::string i = assign("load i64, i64* ", index);
+			branch(assign("icmp slt i64 ", i, ", ", array_length(array)), body, done);
+			start_block(body);
+			std::string element_type = arg.array->type.element().name();
+			store({element, false}, arg.var_type, load(element_address(array, i, element_type), element_type));
+			arg.action->visit(this);
+			std::string next = assign("load i64, i64* ", index);
+			emit("store i64 ", assign("add i64 ", next, ", 1"), ", i64* ", index);
+			terminate("br label %", condition_label);
+			start_block(done);
+
+			undeclare();
+			last_block_variables.pop();
+		}
+		virtual void apply(const Block& arg) {
+			last_block_variables.push(0);
+			for(const auto& s : arg.statements) {
+				s->visit(this);
+			}
+			while(last_block_variables.top()) {
+				undeclare();
+			}
+			last_block_variables.pop();
+		}
+		virtual void apply(const Empty& arg) {
+			(void) arg;
+		}
+		virtual void apply(const Definition& arg) {
+			for(const auto& def : arg.defs) {
+				Value value = def.second ? evaluate(*def.second) : Value{value_type(arg.type), default_value(arg.type)};
+				std::string slot = new_alloca(value_type(arg.type));
+				store({slot, false}, arg.type, value);
+				declare(def.first, arg.type, slot);
+			}
+		}
+
+		//the arguments are copied to allocas, so they can be assigned to
+		void begin_function() {
+			last_block_variables.push(0);
+			for(size_t i = 0; i < function_args.size(); ++i) {
+				std::string type = value_type(function_args[i].first);
+				std::string slot = new_alloca(type);
+				emit("store ", type, " %arg", i, ", ", type, "* ", slot);
+				declare(function_args[i].second, function_args[i].first, slot);
+			}
+		}
+
+		//the type checker ensures non-void functions return, the end is reachable only in void ones
+		void end_function() {
+			if(!terminated) {
+				terminate(return_type == VOID_NAME ? "ret void" : "unreachable");
+			}
+		}
+
+		LlvmIr() = delete;
+		LlvmIr(const TypeInfo& info, std::ostream& output, std::ostream& allocas, Module& module, const std::vector<std::pair<Type, std::string>>& function_args, const std::string& return_type) : info(info), output(output), allocas(allocas), module(module), function_args(function_args), return_type(return_type), registers(0), labels(0), block("entry"), terminated(false) {}
+	};
+
+	//everything but main is internal, so LLVM sees all the calls
+	void emit_function(const TypeInfo& info, std::ostream& output, Module& module, const std::string& name, const Block& body, const std::string& return_type, const std::vector<std::pair<Type, std::string>>& args) {
+		std::ostringstream allocas;
+		std::ostringstream code;
+		LlvmIr v(info, code, allocas, module, args, return_type);
+		v.begin_function();
+		body.visit(&v);
+		v.end_function();
+		std::string params;
+		for(size_t i = 0; i < args.size(); ++i) {
+			params += (i ? ", " : "") + value_type(args[i].first) + " %arg" + std::to_string(i);
+		}
+		print(output, "define ", name == "main" ? "" : "internal ", value_type(return_type), ' ', global(name), '(', params, ") #0 {");
+		print(output, "entry:");
+		output << allocas.str() << code.str();
+		print(output, "}\n");
+	}
+
+	void emit_class(const ClassInfo& cl, std::ostream& output) {
+		std::string type = class_type(cl.data->name);
+		std::string fields = VTABLE_TYPE;
+		for(const auto& var : cl.variables) {
+			fields += ", " + memory_type(var.first);
+		}
+		print(output, type, " = type { ", fields, " }");
+	}
+
+	void emit_constructor_and_vtable(const ClassInfo& cl, std::ostream& output) {
+		std::string type = class_type(cl.data->name);
+		std::string entries;
+		for(size_t i = 0; i < cl.functions.size(); ++i) {
+			const VirtualFunctionInfo& fun = *cl.functions[i];
+			std::string name;
+			for(const auto& f : cl.function_name_to_id) {
+				if(f.second == i) {
+					name = f.first;
+				}
+			}
+			entries += (i ? ", " : "") + std::string("i8* bitcast (") + function_type(fun.return_type, method_arguments(fun)) + "* " + global(encode_class_function_name(fun.class_info->data->name, name)) + " to i8*)";
+		}
+		print(output, global(encode_vtable_name(cl.data->name)), " = internal constant [", cl.functions.size(), " x i8*] [", entries, ']');
+		print(output, "define internal ", type, "* ", global(encode_constructor_name(cl.data->name)), "() #0 {");
+		print(output, "entry:");
+		print(output, "  %memory = call i8* ", global(ALLOC_THUNK), "(i64 ", (cl.variables.size() + 1) * 8, ')');
+		print(output, "  %object = bitcast i8* %memory to ", type, '*');
+		print(output, "  store ", type, ' ', initial_object(cl), ", ", type, "* %object");
+		print(output, "  ret ", type, "* %object");
+		print(output, "}\n");
+	}
+
+	void emit_asm(std::ostream& output, const std::string& line) {
+		print(output, "module asm \"", line, '"');
+	}
+
+	//pushes the arguments in the order of the x86_64 backend and keeps the registers the C calling convention preserves
+	void emit_thunk(std::ostream& output, const std::string& thunk, const std::string& target, size_t args) {
+		emit_asm(output, thunk + ':');
+		for(const char* reg : SAVED_REGISTERS) {
+			emit_asm(output, std::string("pushq ") + reg);
+		}
+		for(size_t i = 0; i < args; ++i) {
+			emit_asm(output, std::string("pushq ") + ARGUMENT_REGISTERS[i]);
+		}
+		emit_asm(output, "callq " + target);
+		if(args) {
+			emit_asm(output, "addq $" + std::to_string(args * 8) + ", %rsp");
+		}
+		for(size_t i = sizeof(SAVED_REGISTERS) / sizeof(SAVED_REGISTERS[0]); i > 0; --i) {
+			emit_asm(output, std::string("popq ") + SAVED_REGISTERS[i - 1]);
+		}
+		emit_asm(output, "retq");
+	}
+
+	void emit_runtime_interface(std::ostream& output) {
+		emit_asm(output, ".text");
+		emit_asm(output, ".globl _start");
+		emit_asm(output, "_start:");
+		emit_asm(output, "callq main");
+		emit_asm(output, "movq %rax, %rdi");
+		emit_asm(output, "movl $60, %eax");
+		emit_asm(output, "syscall");
+		for(const char* line : MEMORY_FUNCTIONS) {
+			emit_asm(output, line);
+		}
+		emit_thunk(output, ALLOC_THUNK, "_alloc", 1);
+		emit_thunk(output, NEW_ARRAY_THUNK, "_new_array", 2);
+		emit_thunk(output, CONCAT_THUNK, CONCAT_FUN_NAME, 2);
+		for(const auto& f : BUILTIN_FUNCTIONS) {
+			emit_thunk(output, THUNK_PREFIX + f.first, f.first, f.second.second.size());
+		}
+		//_concat_n takes the parts, their total length and their number on the stack
+		emit_asm(output, CONCAT_N_THUNK + ':');
+		for(const char* reg : SAVED_REGISTERS) {
+			emit_asm(output, std::string("pushq ") + reg);
+		}
+		emit_asm(output, "movq %rsp, %rbp");
+		emit_asm(output, "xorl %ecx, %ecx");
+		emit_asm(output, "1:");
+		emit_asm(output, "pushq (%rdi,%rcx,8)");
+		emit_asm(output, "incq %rcx");
+		emit_asm(output, "cmpq %rsi, %rcx");
+		emit_asm(output, "jb 1b");
+		emit_asm(output, "pushq %rdx");
+		emit_asm(output, "pushq %rsi");
+		emit_asm(output, "callq " + CONCAT_N_FUN_NAME);
+		emit_asm(output, "movq %rbp, %rsp");
+		for(size_t i = sizeof(SAVED_REGISTERS) / sizeof(SAVED_REGISTERS[0]); i > 0; --i) {
+			emit_asm(output, std::string("popq ") + SAVED_REGISTERS[i - 1]);
+		}
+		emit_asm(output, "retq");
+		output << '\n';
+
+		print(output, "declare dso_local noalias i8* ", global(ALLOC_THUNK), "(i64) nounwind");
+		print(output, "declare dso_local ", ARRAY_TYPE, "* ", global(NEW_ARRAY_THUNK), "(i64, i64) nounwind");
+		print(output, "declare dso_local ", STRING_TYPE, "* ", global(CONCAT_THUNK), '(', STRING_TYPE, "*, ", STRING_TYPE, "*) nounwind");
+		print(output, "declare dso_local ", STRING_TYPE, "* ", global(CONCAT_N_THUNK), '(', STRING_TYPE, "**, i64, i64) nounwind");
+		for(const auto& f : BUILTIN_FUNCTIONS) {
+			std::vector<std::pair<Type, std::string>> args;
+			for(const auto& a : f.second.second) {
+				args.push_back(std::make_pair(a, ""));
+			}
+			print(output, "declare dso_local ", value_type(f.second.first), ' ', global(THUNK_PREFIX + f.first), '(', arguments(args), ") nounwind", f.first == ERROR_FUN_NAME ? " noreturn" : "");
+		}
+		output << '\n';
+	}
+
+	void emit_string(std::ostream& output, const std::string& val, size_t id) {
+		output << string_literal_name(id) << " = private unnamed_addr constant " << string_literal_type(val) << " { i64 " << val.size() << ", [" << val.size() << " x i8] ";
+		if(val.empty()) {
+			output << "zeroinitializer }\n";
+			return;
+		}
+		output << "c\"";
+		const char* digits = "0123456789ABCDEF";
+		for(unsigned char c : val) {
+			if(c >= ' ' && c < 127 && c != '"' && c != '\\') {
+				output << c;
+			} else {
+				output << '\\' << digits[c >> 4] << digits[c & 15];
+			}
+		}
+		output << "\" }\n";
+	}
+
+	void emit_constant_array(std::ostream& output, const ConstantArray& c, size_t id) {
+		size_t size = c.values.size();
+		output << constant_name(id) << " = private unnamed_addr constant " << constant_type(size) << " { i64 " << size << ", [" << size << " x i64] ";
+		if(!size) {
+			output << "zeroinitializer }\n";
+			return;
+		}
+		for(size_t i = 0; i < size; ++i) {
+			output << (i ? ", i64 " : "[i64 ") << c.values[i];
+		}
+		output << "] }\n";
+	}
+}
+
+void emit_llvm_ir(const TypeInfo& info, std::ostream& output) {
+	output << HEADER << '\n';
+	for(const auto& cl : info.classes) {
+		emit_class(*cl.second, output);
+	}
+	output << '\n';
+	emit_runtime_interface(output);
+	Module module;
+	for(const auto& fun : info.functions) {
+		emit_function(info, output, module, fun.first, *fun.second->data->body, fun.second->return_type, fun.second->args);
+	}
+	for(const auto& cl : info.classes) {
+		for(const auto& fun : cl.second->function_name_to_id) {
+			const VirtualFunctionInfo& f = *cl.second->functions[fun.second];
+			if(f.class_info->data->name == cl.second->data->name) {
+				emit_function(info, output, module, encode_class_function_name(cl.second->data->name, fun.first), *f.data->body, f.return_type, method_arguments(f));
+			}
+		}
+		emit_constructor_and_vtable(*cl.second, output);
+	}
+	for(const auto& str : module.string_literals) {
+		emit_string(output, str.first, str.second);
+	}
+	for(const auto& arr : module.constant_arrays) {
+		emit_constant_array(output, *arr.second, arr.first);
+	}
+	print(output, "\nattributes #0 = { nounwind }");
+}
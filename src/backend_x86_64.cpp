@@ -1,9 +1,17 @@
 #include "backend.h"
 #include "program_tree.h"
 #include "helper_visitors.h"
+#include "vectorizer.h"
+#include "loop_unroller.h"
+#include "compile_time_evaluation.h"
+#include "profile.h"
+#include "parallel.h"
+#include "scoped_table.h"
 
+#include <algorithm>
 #include <functional>
-#include <stack>
+#include <set>
+#include <sstream>
 
 using namespace ProgramTree;
 using namespace TypeChecker;
@@ -27,8 +35,97 @@ namespace {
 
 	std::string str_zero = "0";
 
-	std::string string_label(size_t id) {
-		return "_string_" + std::to_string(id);
+	//labels are numbered within their function, which is numbered within the assembly, so that the functions can be generated independently
+	struct Label {
+		size_t function;
+		size_t number;
+	};
+
+	std::ostream& operator<<(std::ostream& output, const Label& label) {
+		return output << label.function << '_' << label.number;
+	}
+
+	std::string string_label(const Label& label) {
+		return "_string_" + std::to_string(label.function) + '_' + std::to_string(label.number);
+	}
+
+	std::string constant_label(const Label& label) {
+		return "_constant_" + std::to_string(label.function) + '_' + std::to_string(label.number);
+	}
+
+	std::string frame_address(size_t offset) {
+		return "[rbp-" + std::to_string(offset) + ']';
+	}
+
+	//bytes below rsp that leaf functions may use without moving it
+	const size_t RED_ZONE_SIZE = 128;
+
+	//percentage of the calls a receiver needs to get a direct call
+	const uint64_t DEVIRTUALIZATION_THRESHOLD = 90;
+
+	//branches taken at most this percentage of the times the profile saw their if go to the cold section
+	const uint64_t COLD_THRESHOLD = 1;
+
+	const std::string COLD_SECTION = "section .text.unlikely progbits alloc exec nowrite align=16";
+
+	const std::string ERROR_FUN_NAME = "error";
+
+	class EndsInError : public DefaultConstVisitor {
+		bool& result;
+		EndsInError() = delete;
+	public:
+		EndsInError(bool& result) : result(result) {
+			result = false;
+		}
+
+		virtual void default_action() override {}
+
+		virtual void apply(const StaticFunctionCall& arg) override {
+			result = arg.fun == ERROR_FUN_NAME;
+		}
+
+		virtual void apply(const ExprStatement& arg) override {
+			arg.expr->visit(this);
+		}
+
+		virtual void apply(const Block& arg) override {
+			if(!arg.statements.empty()) {
+				arg.statements.back()->visit(this);
+			}
+		}
+	};
+
+	//branches ending in error() are cold, others only if the profile says so
+	bool is_cold(const If& arg, size_t branch) {
+		const Statement* s = branch ? arg.case_else.get() : arg.case_then.get();
+		if(!s) {
+			return false;
+		}
+		bool result;
+		EndsInError e(result);
+		s->visit(&e);
+		if(result || !arg.profile || arg.profile->counts.empty()) {
+			return result;
+		}
+		uint64_t total = arg.profile->counts[0] + arg.profile->counts[1];
+		return total && arg.profile->counts[branch] * 100 <= total * COLD_THRESHOLD;
+	}
+
+	bool else_is_hotter(const If& arg) {
+		return arg.case_else && arg.profile && !arg.profile->counts.empty() && arg.profile->counts[1] > arg.profile->counts[0];
+	}
+
+	const ClassInfo* likely_receiver(const VirtualFunctionCall& arg) {
+		if(!arg.profile || arg.profile->counts.empty()) {
+			return nullptr;
+		}
+		const std::vector<uint64_t>& counts = arg.profile->counts;
+		size_t best = std::max_element(counts.begin(), counts.end()) - counts.begin();
+		uint64_t total = 0;
+		for(uint64_t c : counts) {
+			total += c;
+		}
+		return total && counts[best] * 100 >= total * DEVIRTUALIZATION_THRESHOLD ? arg.profile->receivers[best] : nullptr;
 	}
 
 	const std::string& get_def_val_for_type(const std::string& type) {
@@ -68,15 +165,97 @@ namespace {
 	class x86_64 : public ConstVisitor {
 		const TypeInfo& info;
 		std::ostream& output;
-		size_t& label;
-		std::stack<std::string> variable_names; //variables as they are on the stack
-		std::map<std::string, std::stack<size_t>> variable_ids; //name to stack of numbers on the stack
-		std::stack<size_t> last_block_variables; //how many variables have been declared in the current block
-		const std::vector<std::pair<std::string, std::string>>& function_args;
-		std::map<std::string, size_t>& string_literals;
+		const size_t function_number;
+		size_t labels;
+		ScopedTable<std::string> variables; //addresses, locals are below rbp, the arguments are above the saved rbp and the return address
+		size_t frame_depth; //slots of the frame in use, disjoint scopes and temporaries reuse them
+		size_t& frame_size; //slots the prologue allocates
+		bool& calls; //leaf functions keep the frame in the red zone
+		const bool instrument;
+		size_t cold_depth; //cold code nested in cold code stays where it is
+		std::map<std::string, Label>& string_literals;
+		std::vector<std::pair<Label, const ConstantArray*>>& constant_arrays; //arrays in the read-only data, with their labels
+		std::set<std::string>& references; //functions, constructors, vtables and counters used by the code, they may be in another shard
 
-		size_t next_label() {
-			return label++;
+		Label next_label() {
+			return {function_number, labels++};
+		}
+
+		std::string shared(const std::string& symbol) {
+			references.insert(symbol);
+			return symbol;
+		}
+
+		//returns the offset of the lowest of the new slots
+		size_t allocate_slots(size_t count) {
+			frame_depth += count;
+			frame_size = std::max(frame_size, frame_depth);
+			return frame_depth * 8;
+		}
+
+		void release_slots(size_t count) {
+			frame_depth -= count;
+		}
+
+		const std::string& variable_address(Symbol name) {
+			if(const std::string* address = variables.find(name)) {
+				return *address;
+			}
+			throw std::runtime_error("function in GetAddr::apply(const Variable&), type checker error!");
+		}
+
+		void call(const std::string& target) {
+			calls = true;
+			print("call ", shared(target));
+		}
+
+		void enter_cold() {
+			if(!cold_depth++) {
+				print(COLD_SECTION);
+			}
+		}
+
+		void leave_cold() {
+			if(!--cold_depth) {
+				print("section .text");
+			}
+		}
+
+		//targets of the back edges are aligned, except in cold code
+		void loop_head(const std::string& name, Label label) {
+			if(!cold_depth) {
+				print("align 16");
+			}
+			print(name, label, ':');
+		}
+
+		void count(const std::shared_ptr<ProfileCounters>& profile, size_t counter) {
+			if(instrument && profile) {
+				print("inc qword [", shared("_profile_counters"), '+', (profile->first + counter) * 8, ']');
+			}
+		}
+
+		//the vtable is expected in rax
+		void count_receiver(const VirtualFunctionCall& arg) {
+			Label label = next_label();
+			for(size_t i = 0; i < arg.profile->receivers.size(); ++i) {
+				print("cmp rax, ", shared(encode_vtable_name(arg.profile->receivers[i]->data->name)));
+				print("jne _receiver_", label, '_', i);
+				count(arg.profile, i);
+				print("jmp _receiver_done_", label);
+				print("_receiver_", label, '_', i, ':');
+			}
+			print("_receiver_done_", label, ':');
+		}
+
+		Label string_literal_id(const std::string& val) {
+			auto it = string_literals.find(val);
+			if(it != string_literals.end()) {
+				return it->second;
+			}
+			Label id = next_label();
+			string_literals.emplace(val, id);
+			return id;
 		}
 
 		template<typename ...Ts>
@@ -84,6 +263,13 @@ namespace {
 			::print(output, args...);
 		}
 
+		//frame slots of a for loop
+		struct ForSlots {
+			std::string array;
+			std::string index;
+			std::string element;
+		};
+
 		class GetAddr : public DefaultConstVisitor {
 			x86_64* parent;
 			GetAddr() = delete;
@@ -95,22 +281,7 @@ namespace {
 			}
 
 			virtual void apply(const Variable& arg) override {
-				if(parent->variable_ids.find(arg.name) != parent->variable_ids.end()) {
-					parent->print("lea rax, [rsp+", (parent->variable_names.size() - parent->variable_ids.at(arg.name).top() - 1) * 8, ']');
-					return;
-				}
-				size_t i = -1;
-				for(size_t j = 0; j < parent->function_args.size(); ++j) {
-					if(parent->function_args[j].second == arg.name) {
-						i = j;
-						break;
-					}
-				}
-				if(i != ((size_t) -1)) {
-					parent->print("lea rax, [rsp+", (parent->variable_names.size() + parent->function_args.size() - i) * 8, ']');
-					return;
-				}
-				throw std::runtime_error("function in GetAddr::apply(const Variable&), type checker error!");
+				parent->print("lea rax, ", parent->variable_address(arg.name));
 			}
 
 			virtual void apply(const SubscriptOperator& arg) override {
@@ -131,16 +302,61 @@ namespace {
 			}
 		};
 
+		class StackAllocation : public DefaultConstVisitor {
+			x86_64* parent;
+			bool& done;
+			StackAllocation() = delete;
+
+			//the vtable or the length goes to the lowest address, followed by the fields or the elements
+			void allocate(const std::vector<std::string>& values) {
+				size_t offset = parent->allocate_slots(values.size());
+				for(size_t i = 0; i < values.size(); ++i) {
+					parent->print("mov qword ", frame_address(offset - i * 8), ", ", values[i]);
+				}
+				parent->print("lea rax, ", frame_address(offset));
+			}
+		public:
+			StackAllocation(x86_64* parent, bool& done) : parent(parent), done(done) {}
+
+			virtual void default_action() override {
+				done = false;
+			}
+
+			virtual void apply(const NewObject& arg) override {
+				done = arg.on_stack;
+				if(!done) {
+					return;
+				}
+				const ClassInfo& cl = *parent->info.classes.at(arg.new_type);
+				std::vector<std::string> values = {parent->shared(encode_vtable_name(arg.new_type))};
+				for(const auto& var : cl.variables) {
+					values.push_back(get_def_val_for_type(var.first));
+				}
+				allocate(values);
+			}
+
+			virtual void apply(const NewArray& arg) override {
+				done = arg.on_stack;
+				if(!done) {
+					return;
+				}
+				const literal_type<LiteralType::Integer>::type* size = nullptr;
+				LiteralGetter<LiteralType::Integer> lg(size);
+				arg.size->visit(&lg);
+				std::vector<std::string> values(*size + 1, arg.new_type == STR_TYPE ? empty_string_label : str_zero);
+				values[0] = std::to_string(*size);
+				allocate(values);
+			}
+		};
+
 	public:
 		void get_two_variables(std::function<void()> rbx, std::function<void()> rax) {
 			rbx();
-			print("push rax");
-			++last_block_variables.top();
-			variable_names.push("");
+			size_t offset = allocate_slots(1);
+			print("mov ", frame_address(offset), ", rax");
 			rax();
-			print("pop rbx");
-			--last_block_variables.top();
-			variable_names.pop();
+			print("mov rbx, ", frame_address(offset));
+			release_slots(1);
 		}
 		void cmp_bin_op(const std::unique_ptr<Expression>& l, const std::unique_ptr<Expression>& r, const std::string& op) {
 			int_bin_op(l, r, "cmp");
@@ -174,7 +390,7 @@ namespace {
 			print("mov rax, rdx");
 		}
 		void boolean_op(const std::unique_ptr<Expression>& l, const std::unique_ptr<Expression>& r, const std::string& jump_cmd) {
-			size_t label = next_label();
+			Label label = next_label();
 			l->visit(this);
 			print("test rax, rax");
 			print(jump_cmd, " _boolean_op_after_", label);
@@ -223,56 +439,85 @@ namespace {
 			print("mov rax, ", arg.val);
 		}
 		virtual void apply(const Literal<LiteralType::String>& arg) {
-			size_t id;
-			if(string_literals.find(arg.val) != string_literals.end()) {
-				id = string_literals.at(arg.val);
-			} else {
-				id = next_label();
-				string_literals[arg.val] = id;
-			}
-			print("mov rax, ", string_label(id));
+			print("mov rax, ", string_label(string_literal_id(arg.val)));
 		}
 		virtual void apply(const Variable& arg) {
-			GetAddr ga(this);
-			ga.apply(arg);
-			print("mov rax, [rax]");
+			print("mov rax, ", variable_address(arg.name));
 		}
 		virtual void apply(const Null& arg) {
 			(void) arg;
 			print("mov rax, 0");
 		}
 		virtual void apply(const StaticFunctionCall& arg) {
+			if(arg.constant) {
+				Label id = next_label();
+				constant_arrays.emplace_back(id, arg.constant.get());
+				print("mov rax, ", constant_label(id));
+				return;
+			}
 			for(const auto& a : arg.args) {
 				a->visit(this);
 				print("push rax");
-				++last_block_variables.top();
-				variable_names.push("");
 			}
-			print("call ", arg.fun);
-			last_block_variables.top() -= arg.args.size();
+			size_t pushed = arg.args.size();
+			if(arg.fun == CONCAT_N_FUN_NAME) {
+				push_concat_length(arg);
+				pushed += 2;
+			}
+			call(arg.fun);
+			if(pushed) {
+				print("add rsp, ", pushed * 8);
+			}
+		}
+		//_concat_n expects the parts followed by their total length and their number, lengths of the literals are summed up here
+		void push_concat_length(const StaticFunctionCall& arg) {
+			size_t literals_length = 0;
+			std::vector<size_t> dynamic_parts;
 			for(size_t i = 0; i < arg.args.size(); ++i) {
-				variable_names.pop();
+				const literal_type<LiteralType::String>::type* val = nullptr;
+				LiteralGetter<LiteralType::String> lg(val);
+				arg.args[i]->visit(&lg);
+				if(val) {
+					literals_length += val->size();
+				} else {
+					dynamic_parts.push_back(i);
+				}
 			}
-			if(arg.args.size()) {
-				print("add rsp, ", arg.args.size() * 8);
+			print("mov rax, ", literals_length);
+			for(size_t i : dynamic_parts) {
+				print("mov rbx, [rsp+", (arg.args.size() - i - 1) * 8, ']');
+				print("add rax, [rbx]");
 			}
+			print("push rax");
+			print("push qword ", arg.args.size());
 		}
 		virtual void apply(const VirtualFunctionCall& arg) {
 			for(const auto& a : arg.args) {
 				a->visit(this);
 				print("push rax");
-				++last_block_variables.top();
-				variable_names.push("");
 			}
 			arg.object->visit(this);
 			print("push rax");
 			print("mov rax, [rax]");
-			print("add rax, ", info.classes.at(arg.object->type)->function_name_to_id.at(arg.fun) * 8);
-			print("mov rax, [rax]");
-			print("call rax");
-			last_block_variables.top() -= arg.args.size();
-			for(size_t i = 0; i < arg.args.size(); ++i) {
-				variable_names.pop();
+			if(instrument && arg.profile) {
+				count_receiver(arg);
+			}
+			size_t id = info.classes.at(arg.object->type)->function_name_to_id.at(arg.fun);
+			const ClassInfo* receiver = likely_receiver(arg);
+			if(receiver) {
+				//the profile says who usually receives the call, it gets a direct call guarded by a check of the vtable
+				Label label = next_label();
+				print("cmp rax, ", shared(encode_vtable_name(receiver->data->name)));
+				print("jne _virtual_call_", label);
+				call(encode_class_function_name(receiver->functions[id]->class_info->data->name, arg.fun));
+				print("jmp _virtual_done_", label);
+				print("_virtual_call_", label, ':');
+				call("[rax+" + std::to_string(id * 8) + ']');
+				print("_virtual_done_", label, ':');
+			} else {
+				print("add rax, ", id * 8);
+				print("mov rax, [rax]");
+				call("rax");
 			}
 			print("add rsp, ", (arg.args.size() + 1) * 8);
 		}
@@ -298,13 +543,13 @@ namespace {
 			arg.expr->visit(this);
 		}
 		virtual void apply(const NewObject& arg)  {
-			print("call ", encode_constructor_name(arg.new_type));
+			call(encode_constructor_name(arg.new_type));
 		}
 		virtual void apply(const NewArray& arg)  {
 			arg.size->visit(this);
-			print("push qword ", arg.new_type == STR_NAME ? empty_string_label : std::to_string(0));
+			print("push qword ", arg.new_type == STR_TYPE ? empty_string_label : std::to_string(0));
 			print("push rax");
-			print("call _new_array");
+			call("_new_array");
 			print("add rsp, 16");
 		}
 		virtual void apply(const Assignment& arg) {
@@ -328,21 +573,50 @@ namespace {
 			if(arg.val) {
 				arg.val->visit(this);
 			}
-			if(variable_names.size()) {
-				print("add rsp, ", variable_names.size() * 8);
-			}
+			print("leave");
 			print("ret");
 		}
+		//the cold branch goes to the cold section, the hot one falls through
+		void emit_if_with_cold_branch(const If& arg, bool then_cold, Label label) {
+			print(then_cold ? "jnz" : "jz", " _if_cold_", label);
+			count(arg.profile, then_cold ? 1 : 0);
+			const Statement* hot = then_cold ? arg.case_else.get() : arg.case_then.get();
+			if(hot) {
+				hot->visit(this);
+			}
+			print("_if_done_", label, ':');
+			enter_cold();
+			print("_if_cold_", label, ':');
+			count(arg.profile, then_cold ? 0 : 1);
+			(then_cold ? arg.case_then : arg.case_else)->visit(this);
+			print("jmp _if_done_", label);
+			leave_cold();
+		}
 		virtual void apply(const If& arg) {
-			size_t label = next_label();
+			Label label = next_label();
 			arg.condition->visit(this);
 			print("test rax, rax");
-			if(arg.case_else) {
+			bool then_cold = is_cold(arg, 0);
+			if(then_cold != is_cold(arg, 1)) {
+				emit_if_with_cold_branch(arg, then_cold, label);
+			} else if(else_is_hotter(arg)) {
+				//the hotter branch falls through
+				print("jnz _if_then_", label);
+				arg.case_else->visit(this);
+				print("jmp _if_done_", label);
+				print("_if_then_", label, ':');
+				arg.case_then->visit(this);
+				print("_if_done_", label, ':');
+			} else if(arg.case_else || instrument) {
 				print("jz _if_else_", label);
+				count(arg.profile, 0);
 				arg.case_then->visit(this);
 				print("jmp _if_done_", label);
 				print("_if_else_", label, ':');
-				arg.case_else->visit(this);
+				count(arg.profile, 1);
+				if(arg.case_else) {
+					arg.case_else->visit(this);
+				}
 				print("_if_done_", label, ':');
 			} else {
 				print("jz _if_done_", label);
@@ -350,10 +624,153 @@ namespace {
 				print("_if_done_", label, ':');
 			}
 		}
+		void load_address(const Variable& var) {
+			GetAddr ga(this);
+			ga.apply(var);
+		}
+		//adds up the two 64-bit lanes of the accumulator xmm3 into the variable
+		void store_vector_sum(const VectorLoop& loop) {
+			print("pshufd xmm0, xmm3, 0xee");
+			print("paddq xmm3, xmm0");
+			print("movq rbx, xmm3");
+			load_address(*loop.target);
+			print(loop.substraction ? "sub" : "add", " qword [rax], rbx");
+		}
+		//runs as many iterations as fit in both lanes and stay in the bounds of the arrays, the loop itself runs the rest
+		void emit_vector_loop(const VectorLoop& loop, Label label) {
+			print("pxor xmm3, xmm3");
+			load_address(*loop.index);
+			print("mov rcx, [rax]");
+			print("test rcx, rcx");
+			print("jl _vector_done_", label);
+			loop.bound->visit(this);
+			print("mov rdx, rax");
+			static const char* const array_registers[] = {"r8", "r9", "r10"};
+			static const char* const invariant_registers[] = {"xmm4", "xmm5"};
+			std::vector<const Variable*> arrays;
+			if(loop.kind == VectorLoop::Kind::Map) {
+				arrays.push_back(loop.target);
+			}
+			for(size_t i = 0; i < loop.operands.size(); ++i) {
+				if(loop.operands[i].array) {
+					arrays.push_back(loop.operands[i].array);
+				} else {
+					loop.operands[i].value->visit(this);
+					print("movq ", invariant_registers[i], ", rax");
+					print("punpcklqdq ", invariant_registers[i], ", ", invariant_registers[i]);
+				}
+			}
+			for(size_t i = 0; i < arrays.size(); ++i) {
+				load_address(*arrays[i]);
+				print("mov ", array_registers[i], ", [rax]");
+				print("cmp rdx, [", array_registers[i], "]");
+				print("cmovg rdx, [", array_registers[i], "]");
+			}
+			print("dec rdx");
+			loop_head("_vector_body_", label);
+			print("cmp rcx, rdx");
+			print("jge _vector_done_", label);
+			size_t array_id = loop.kind == VectorLoop::Kind::Map ? 1 : 0;
+			for(size_t i = 0; i < loop.operands.size(); ++i) {
+				if(loop.operands[i].array) {
+					print("movdqu xmm", i, ", [", array_registers[array_id++], " + rcx * 8 + 8]");
+				} else {
+					print("movdqa xmm", i, ", ", invariant_registers[i]);
+				}
+			}
+			if(loop.kind == VectorLoop::Kind::Map) {
+				if(loop.operands.size() == 2) {
+					print(loop.substraction ? "psubq" : "paddq", " xmm0, xmm1");
+				}
+				print("movdqu [r8 + rcx * 8 + 8], xmm0");
+			} else {
+				print("paddq xmm3, xmm0");
+			}
+			print("add rcx, 2");
+			print("jmp _vector_body_", label);
+			print("_vector_done_", label, ':');
+			load_address(*loop.index);
+			print("mov [rax], rcx");
+			if(loop.kind == VectorLoop::Kind::Sum) {
+				store_vector_sum(loop);
+			}
+		}
+		//the array, index and loop variable are expected in the slots set up by apply(const For&)
+		void emit_vector_for(const VectorLoop& loop, const ForSlots& slots, Label label) {
+			print("pxor xmm3, xmm3");
+			print("mov rbx, ", slots.array);
+			print("mov rdx, [rbx]");
+			print("dec rdx");
+			print("xor rcx, rcx");
+			loop_head("_vector_body_", label);
+			print("cmp rcx, rdx");
+			print("jge _vector_done_", label);
+			print("movdqu xmm0, [rbx + rcx * 8 + 8]");
+			print("paddq xmm3, xmm0");
+			print("add rcx, 2");
+			print("jmp _vector_body_", label);
+			print("_vector_done_", label, ':');
+			print("mov ", slots.index, ", rcx");
+			store_vector_sum(loop);
+		}
+		//the unrolled loop runs while index + factor - 1 is still in the bounds, the original loop runs the rest
+		void emit_unrolled_while(const While& arg, const LoopUnrolling& unrolling, Label label) {
+			if(!unrolling.loop) {
+				for(size_t i = 0; i < unrolling.factor; ++i) {
+					arg.action->visit(this);
+				}
+				return;
+			}
+			print("jmp _unrolled_condition_", label);
+			loop_head("_unrolled_body_", label);
+			for(size_t i = 0; i < unrolling.factor; ++i) {
+				arg.action->visit(this);
+			}
+			print("_unrolled_condition_", label, ':');
+			unrolling.bound->visit(this);
+			print("mov rbx, rax");
+			load_address(*unrolling.index);
+			print("mov rax, [rax]");
+			print("add rax, ", unrolling.factor - 1);
+			print("jo _unrolled_done_", label);
+			print("cmp rax, rbx");
+			print(unrolling.inclusive ? "jle" : "jl", " _unrolled_body_", label);
+			print("_unrolled_done_", label, ':');
+		}
+		//the array, index and loop variable are expected in the slots set up by apply(const For&)
+		void emit_unrolled_for(const For& arg, const LoopUnrolling& unrolling, const ForSlots& slots, Label label) {
+			print("jmp _unrolled_condition_", label);
+			loop_head("_unrolled_body_", label);
+			for(size_t i = 0; i < unrolling.factor; ++i) {
+				print("mov rax, ", slots.index);
+				print("mov rbx, ", slots.array);
+				print("mov rax, [rbx + rax * 8 + 8]");
+				print("mov ", slots.element, ", rax");
+				arg.action->visit(this);
+				print("inc qword ", slots.index);
+			}
+			print("_unrolled_condition_", label, ':');
+			print("mov rax, ", slots.index);
+			print("add rax, ", unrolling.factor - 1);
+			print("mov rbx, ", slots.array);
+			print("cmp rax, [rbx]");
+			print("jl _unrolled_body_", label);
+		}
 		virtual void apply(const While& arg) {
-			size_t label = next_label();
+			Label label = next_label();
+			count(arg.profile, 0);
+			if(arg.vector_loop) {
+				emit_vector_loop(*arg.vector_loop, label);
+			}
+			if(arg.unrolling) {
+				emit_unrolled_while(arg, *arg.unrolling, label);
+				if(!arg.unrolling->remainder) {
+					return;
+				}
+			}
 			print("jmp _while_condition_", label);
-			print("_while_body_", label, ':');
+			loop_head("_while_body_", label);
+			count(arg.profile, 1);
 			arg.action->visit(this);
 			print("_while_condition_", label, ':');
 			arg.condition->visit(this);
@@ -361,85 +778,90 @@ namespace {
 			print("jnz _while_body_", label);
 		}
 		virtual void apply(const For& arg) {
-			size_t label = next_label();
+			Label label = next_label();
 			arg.array->visit(this);
 
-			last_block_variables.top() += 3;
-			variable_names.push("");
-			variable_names.push("");
-			variable_ids[arg.var_name].push(variable_names.size());
-			variable_names.push(arg.var_name);
-			print("push rax");
-			print("push qword 0");
-			print("sub rsp, 8");
+			ForSlots slots;
+			slots.array = frame_address(allocate_slots(1));
+			slots.index = frame_address(allocate_slots(1));
+			slots.element = frame_address(allocate_slots(1));
+			variables.enter();
+			variables.declare(arg.var_name, slots.element);
+			print("mov ", slots.array, ", rax");
+			print("mov qword ", slots.index, ", 0");
+			count(arg.profile, 0);
 
+			if(arg.vector_loop) {
+				emit_vector_for(*arg.vector_loop, slots, label);
+			}
+			if(arg.unrolling) {
+				emit_unrolled_for(arg, *arg.unrolling, slots, label);
+			}
 			print("jmp _for_condition_", label);
-			print("_for_body_", label, ':');
-			print("lea rax, [rbx + rax * 8 + 8]");
-			print("mov rax, [rax]");
-			print("mov [rsp], rax");
+			loop_head("_for_body_", label);
+			print("mov rax, [rbx + rax * 8 + 8]");
+			print("mov ", slots.element, ", rax");
+			count(arg.profile, 1);
 			arg.action->visit(this);
-			print("inc qword [rsp+8]");
+			print("inc qword ", slots.index);
 			print("_for_condition_", label, ':');
-			print("mov rax, [rsp+8]");
-			print("mov rbx, [rsp+16]");
+			print("mov rax, ", slots.index);
+			print("mov rbx, ", slots.array);
 			print("cmp rax, [rbx]");
 			print("jl _for_body_", label);
 
-			print("add rsp, 24");
-			variable_ids[arg.var_name].pop();
-			variable_names.pop();
-			variable_names.pop();
-			variable_names.pop();
-			last_block_variables.top() -= 3;
+			variables.leave();
+			release_slots(3);
 		}
 		virtual void apply(const Block& arg) {
-			last_block_variables.push(0);
+			variables.enter();
+			size_t depth = frame_depth;
 			for (const auto& s : arg.statements) {
 				s->visit(this);
 			}
-			size_t popped_vars = last_block_variables.top();
-			last_block_variables.pop();
-			for(size_t i = 0; i < popped_vars; ++i) {
-				variable_ids.at(variable_names.top()).pop();
-				if(variable_ids.at(variable_names.top()).empty()) {
-					variable_ids.erase(variable_names.top());
-				}
-				variable_names.pop();
-			}
-			if(popped_vars) {
-				print("add rsp, ", popped_vars * 8);
-			}
+			variables.leave();
+			frame_depth = depth;
 		}
 		virtual void apply(const Empty& arg) {
 			(void) arg;
 		}
 		virtual void apply(const Definition& arg) {
 			for(const auto& def : arg.defs) {
+				size_t offset;
 				if(def.second) {
-					def.second->visit(this);
-					print("push rax");
+					bool on_stack;
+					StackAllocation sa(this, on_stack);
+					def.second->visit(&sa);
+					if(!on_stack) {
+						def.second->visit(this);
+					}
+					offset = allocate_slots(1);
+					print("mov ", frame_address(offset), ", rax");
 				} else {
-					print("push ", get_def_val_for_type(arg.type));
+					offset = allocate_slots(1);
+					print("mov qword ", frame_address(offset), ", ", get_def_val_for_type(arg.type));
 				}
-				++last_block_variables.top();
-				variable_ids[def.first].push(variable_names.size());
-				variable_names.push(def.first);
+				variables.declare(def.first, frame_address(offset));
 			}
 		}
 
 		x86_64() = delete;
-		x86_64(const TypeInfo& info, std::ostream& output, size_t& label, const std::vector<std::pair<std::string, std::string>>& function_args, std::map<std::string, size_t>& string_literals) : info(info), output(output), label(label), function_args(function_args), string_literals(string_literals) {}
+		x86_64(const TypeInfo& info, std::ostream& output, size_t function_number, const std::vector<std::pair<Type, std::string>>& function_args, std::map<std::string, Label>& string_literals, std::vector<std::pair<Label, const ConstantArray*>>& constant_arrays, size_t& frame_size, bool& calls, bool instrument, std::set<std::string>& references) : info(info), output(output), function_number(function_number), labels(0), frame_depth(0), frame_size(frame_size), calls(calls), instrument(instrument), cold_depth(0), string_literals(string_literals), constant_arrays(constant_arrays), references(references) {
+			variables.enter();
+			for(size_t i = 0; i < function_args.size(); ++i) {
+				variables.declare(function_args[i].second, "[rbp+" + std::to_string((function_args.size() - i + 1) * 8) + ']');
+			}
+		}
 	};
 
-	void generate_constructor_and_vtable(const ClassInfo& cl, std::ostream& output) {
+	void generate_constructor_and_vtable(const ClassInfo& cl, std::ostream& output, std::set<std::string>& references) {
 		print(output, encode_constructor_name(cl.data->name), ':');
 		print(output, "push qword ", (cl.variables.size() + 1) * 8);
 		print(output, "call _alloc");
 		print(output, "add rsp, 8");
 		print(output, "mov qword [rax], ", encode_vtable_name(cl.data->name));
 		size_t id = 1;
-		for(const std::pair<std::string, std::string>& var : cl.variables) {
+		for(const std::pair<Type, std::string>& var : cl.variables) {
 			print(output, "mov qword [rax+", id * 8, "], ", get_def_val_for_type(var.first));
 			++id;
 		}
@@ -450,55 +872,439 @@ namespace {
 			id_to_fun_name[fun.second] = fun.first;
 		}
 		for(size_t i = 0; i < cl.functions.size(); ++i) {
-			print(output, "dq ", encode_class_function_name(cl.functions[i]->class_info->data->name, id_to_fun_name.at(i)));
+			std::string implementation = encode_class_function_name(cl.functions[i]->class_info->data->name, id_to_fun_name.at(i));
+			references.insert(implementation);
+			print(output, "dq ", implementation);
+		}
+	}
+
+	//the code of a function and what the assembly needs for it, nothing is shared with the other functions so that they can be generated at the same time
+	struct FunctionOutput {
+		std::ostringstream code;
+		std::map<std::string, Label> string_literals;
+		std::vector<std::pair<Label, const ConstantArray*>> constant_arrays;
+		std::set<std::string> references;
+	};
+
+	//the body is generated first, the prologue then allocates the whole frame at once
+	void emit_function(const TypeInfo& info, FunctionOutput& output, const std::string& name, const Block& body, size_t number, const std::vector<std::pair<Type, std::string>>& args, bool instrument) {
+		std::ostringstream code;
+		size_t frame_size = 0;
+		bool calls = false;
+		x86_64 v(info, code, number, args, output.string_literals, output.constant_arrays, frame_size, calls, instrument, output.references);
+		body.visit(&v);
+		print(output.code, name, ':');
+		print(output.code, "push rbp");
+		print(output.code, "mov rbp, rsp");
+		if(frame_size && (calls || frame_size * 8 > RED_ZONE_SIZE)) {
+			print(output.code, "sub rsp, ", frame_size * 8);
+		}
+		output.code << code.str();
+	}
+
+	struct FunctionCode {
+		std::string name;
+		Block* body;
+		std::vector<std::pair<Type, std::string>> args;
+	};
+
+	//a call in a loop weighs this many times more than the same call outside of it
+	const size_t LOOP_WEIGHT = 10;
+
+	const size_t MAX_CALL_WEIGHT = 1000000;
+
+	void add_implementations(const InheritanceTreeNode& node, size_t id, const std::string& fun, std::set<std::string>& result) {
+		result.insert(encode_class_function_name(node.class_info->functions[id]->class_info->data->name, fun));
+		for(const auto& child : node.children) {
+			add_implementations(*child, id, fun, result);
+		}
+	}
+
+	//weights of the calls a function makes, by the names of the callees
+	class CallAffinity : public RecursiveVisitor {
+		const TypeInfo& info;
+		size_t weight;
+
+		template<typename T>
+		void visit_loop(T& loop) {
+			size_t outer = weight;
+			weight = std::min(weight * LOOP_WEIGHT, MAX_CALL_WEIGHT);
+			RecursiveVisitor::apply(loop);
+			weight = outer;
+		}
+
+	public:
+		std::map<std::string, size_t> weights;
+
+		virtual void apply(StaticFunctionCall& arg) {
+			if(info.functions.find(arg.fun) != info.functions.end()) {
+				weights[arg.fun] += weight;
+			}
+			RecursiveVisitor::apply(arg);
+		}
+
+		virtual void apply(VirtualFunctionCall& arg) {
+			const ClassInfo& cl = *info.classes.at(arg.object->type);
+			std::set<std::string> implementations;
+			add_implementations(*cl.inheritance_tree_node, cl.function_name_to_id.at(arg.fun), arg.fun, implementations);
+			for(const auto& fun : implementations) {
+				weights[fun] += weight;
+			}
+			RecursiveVisitor::apply(arg);
+		}
+
+		virtual void apply(While& arg) {
+			visit_loop(arg);
+		}
+
+		virtual void apply(For& arg) {
+			visit_loop(arg);
+		}
+
+		CallAffinity() = delete;
+		CallAffinity(const TypeInfo& info) : info(info), weight(1) {}
+	};
+
+	//callees follow their heaviest callers, starting from main, so that the code that runs together sits together
+	std::vector<size_t> order_by_affinity(const TypeInfo& info, const std::vector<FunctionCode>& functions) {
+		std::map<std::string, size_t> index;
+		for(size_t i = 0; i < functions.size(); ++i) {
+			index[functions[i].name] = i;
+		}
+		std::vector<std::vector<std::pair<size_t, size_t>>> callees(functions.size());
+		for(size_t i = 0; i < functions.size(); ++i) {
+			CallAffinity a(info);
+			functions[i].body->visit(&a);
+			//callees in other modules are placed by their own modules
+			for(const auto& w : a.weights) {
+				auto callee = index.find(w.first);
+				if(callee != index.end()) {
+					callees[i].emplace_back(w.second, callee->second);
+				}
+			}
+			std::stable_sort(callees[i].begin(), callees[i].end(), [](const std::pair<size_t, size_t>& a, const std::pair<size_t, size_t>& b) {
+				return a.first > b.first;
+			});
+		}
+		std::vector<size_t> order;
+		std::vector<bool> placed(functions.size(), false);
+		std::function<void(size_t)> place = [&](size_t i) {
+			if(placed[i]) {
+				return;
+			}
+			placed[i] = true;
+			order.push_back(i);
+			for(const auto& callee : callees[i]) {
+				place(callee.second);
+			}
+		};
+		auto main = index.find("main");
+		if(main != index.end()) {
+			place(main->second);
+		}
+		for(size_t i = 0; i < functions.size(); ++i) {
+			place(i);
+		}
+		return order;
+	}
+
+	//adds the counters to the ones already in the file if it was written by the same program
+	void generate_profile_dump(const Optimizer::Instrumentation& instrumentation, std::ostream& output) {
+		size_t size = (instrumentation.counters + 2) * 8;
+		print(output, "_profile_dump:");
+		print(output, "mov rax, 2");
+		print(output, "mov rdi, _profile_file");
+		print(output, "mov rsi, 66");
+		print(output, "mov rdx, 420");
+		print(output, "syscall");
+		print(output, "test rax, rax");
+		print(output, "js _profile_dump_done");
+		print(output, "mov r12, rax");
+		print(output, "mov rdi, rax");
+		print(output, "xor rax, rax");
+		print(output, "mov rsi, _profile_previous");
+		print(output, "mov rdx, ", size);
+		print(output, "syscall");
+		print(output, "cmp rax, ", size);
+		print(output, "jne _profile_dump_write");
+		print(output, "mov rax, [_profile_previous]");
+		print(output, "cmp rax, [_profile_data]");
+		print(output, "jne _profile_dump_write");
+		print(output, "xor rcx, rcx");
+		print(output, "jmp _profile_dump_condition");
+		print(output, "_profile_dump_add:");
+		print(output, "mov rax, [_profile_previous + rcx * 8 + 16]");
+		print(output, "add [_profile_counters + rcx * 8], rax");
+		print(output, "inc rcx");
+		print(output, "_profile_dump_condition:");
+		print(output, "cmp rcx, ", instrumentation.counters);
+		print(output, "jl _profile_dump_add");
+		print(output, "_profile_dump_write:");
+		print(output, "mov rax, 8");
+		print(output, "mov rdi, r12");
+		print(output, "xor rsi, rsi");
+		print(output, "xor rdx, rdx");
+		print(output, "syscall");
+		print(output, "mov rax, 1");
+		print(output, "mov rdi, r12");
+		print(output, "mov rsi, _profile_data");
+		print(output, "mov rdx, ", size);
+		print(output, "syscall");
+		print(output, "mov rax, 77");
+		print(output, "mov rdi, r12");
+		print(output, "mov rsi, ", size);
+		print(output, "syscall");
+		print(output, "mov rax, 3");
+		print(output, "mov rdi, r12");
+		print(output, "syscall");
+		print(output, "_profile_dump_done:");
+		print(output, "ret");
+	}
+
+	void generate_profile_data(const Optimizer::Instrumentation& instrumentation, std::ostream& output) {
+		print(output, "section .data");
+		print(output, "_profile_data dq ", (Integer) instrumentation.checksum, ", ", instrumentation.counters);
+		print(output, "_profile_counters times ", instrumentation.counters, " dq 0");
+		output << "_profile_file db ";
+		for(char c : instrumentation.filename) {
+			output << (short) c << ',';
 		}
+		output << "0\n";
+		print(output, "section .bss");
+		print(output, "_profile_previous resq ", instrumentation.counters + 2);
 	}
 }
 
-void emit_code(const TypeInfo& info, std::ostream& output) {
-	print(output, "section .text");
-	print(output, "extern _alloc");
-	print(output, "extern _new_array");
-	print(output, "extern ", empty_array_label);
-	print(output, "extern ", empty_string_label);
-	print(output, "extern ", CONCAT_FUN_NAME);
-	for(const auto& f : BUILTIN_FUNCTIONS) {
-		print(output, "extern ", f.first);
-	}
-	print(output, "global _start");
-	print(output, "_start:");
-	print(output, "call main");
-	print(output, "mov rdi, rax");
-	print(output, "mov rax, 60");
-	print(output, "syscall");
-	std::map<std::string, size_t> string_literals;
-	size_t label = 0;
-	for(const auto& fun : info.functions) {
-		print(output, fun.first, ':');
-		x86_64 v(info, output, label, fun.second->args, string_literals);
-		fun.second->data->body->visit(&v);
+namespace {
+	const size_t FUNCTIONS_PER_SHARD = 500;
+	const size_t MAX_SHARDS = 16;
+
+	//a part of the program assembled on its own, it declares its functions and classes for the other shards and keeps its literals to itself
+	struct Shard {
+		std::ostringstream code;
+		std::set<std::string> definitions;
+		std::set<std::string> references;
+		std::map<std::string, std::vector<Label>> string_literals; //the labels of the functions using the literal all point to it
+		std::vector<std::pair<Label, const ConstantArray*>> constant_arrays;
+	};
+
+	//the functions are numbered by their position in the order, so the output doesn't depend on the number of threads generating them
+	std::vector<FunctionOutput> emit_functions(const TypeInfo& info, const std::vector<FunctionCode>& functions, const std::vector<size_t>& order, bool instrument, size_t threads) {
+		std::vector<FunctionOutput> result(order.size());
+		parallel_for(order.size(), threads, [&](size_t i) {
+			const FunctionCode& function = functions[order[i]];
+			emit_function(info, result[i], function.name, *function.body, i, function.args, instrument);
+		});
+		return result;
 	}
-	for(const auto& cl : info.classes) {
-		generate_constructor_and_vtable(*(cl.second), output);
-		for(const auto& fun : cl.second->function_name_to_id) {
-			if(cl.second->functions[fun.second]->class_info->data->name == cl.second->data->name) {
-				print(output, encode_class_function_name(cl.second->data->name, fun.first), ':');
-				auto args = cl.second->functions[fun.second]->args;
-				args.push_back(std::make_pair(cl.second->data->name, "self"));
-				x86_64 v(info, output, label, args, string_literals);
-				cl.second->functions[fun.second]->data->body->visit(&v);
+
+	void add_function(Shard& shard, std::ostream& code, const std::string& name, const FunctionOutput& function) {
+		shard.definitions.insert(name);
+		code << function.code.str();
+		for(const auto& str : function.string_literals) {
+			shard.string_literals[str.first].push_back(str.second);
+		}
+		shard.constant_arrays.insert(shard.constant_arrays.end(), function.constant_arrays.begin(), function.constant_arrays.end());
+		shard.references.insert(function.references.begin(), function.references.end());
+	}
+
+	//only the first shard has the entry point
+	void emit_header(std::ostream& output, bool entry, const Optimizer::Instrumentation* instrumentation) {
+		print(output, "section .text");
+		print(output, "extern _alloc");
+		print(output, "extern _new_array");
+		print(output, "extern ", empty_array_label);
+		print(output, "extern ", empty_string_label);
+		print(output, "extern ", CONCAT_FUN_NAME);
+		print(output, "extern ", CONCAT_N_FUN_NAME);
+		for(const auto& f : BUILTIN_FUNCTIONS) {
+			print(output, "extern ", f.first);
+		}
+		if(!entry) {
+			return;
+		}
+		print(output, "global _start");
+		if(instrumentation) {
+			print(output, "extern _exit_hook");
+		}
+		print(output, "_start:");
+		//error() exits without returning to _start, the cold paths it ends need the profile the most
+		if(instrumentation) {
+			print(output, "mov rax, _profile_dump");
+			print(output, "mov [_exit_hook], rax");
+		}
+		print(output, "call main");
+		if(instrumentation) {
+			print(output, "push rax");
+			print(output, "call _profile_dump");
+			print(output, "pop rax");
+		}
+		print(output, "mov rdi, rax");
+		print(output, "mov rax, 60");
+		print(output, "syscall");
+		if(instrumentation) {
+			generate_profile_dump(*instrumentation, output);
+		}
+	}
+
+	void emit_read_only_data(std::ostream& output, const std::map<std::string, std::vector<Label>>& string_literals, const std::vector<std::pair<Label, const ConstantArray*>>& constant_arrays) {
+		print(output, "section .rodata");
+		for(const auto& arr : constant_arrays) {
+			const ConstantArray& c = *arr.second;
+			size_t size = c.values.size();
+			print(output, constant_label(arr.first), " dq ", size);
+			for(size_t i = 0; i < size; ++i) {
+				output << (i ? "," : "dq ") << c.values[i];
+			}
+			if(size) {
+				output << '\n';
+			}
+		}
+		for(const auto& str : string_literals) {
+			for(size_t i = 0; i + 1 < str.second.size(); ++i) {
+				output << string_label(str.second[i]) << ":\n";
+			}
+			output << string_label(str.second.back()) << " dq " << str.first.size() << '\n';
+			if(str.first.empty()) {
+				continue;
+			}
+			output << "db " << (short) str.first[0];
+			for(size_t i = 1; i < str.first.size(); ++i) {
+				output << ',' << (short) str.first[i];
+			}
+			output << '\n';
+		}
+	}
+
+	//the global functions and the methods of the classes, only those in the given sets if there are any
+	std::vector<FunctionCode> collect_functions(const TypeInfo& info, const std::set<std::string>* functions = nullptr, const std::set<std::string>* classes = nullptr) {
+		std::vector<FunctionCode> result;
+		for(const auto& fun : info.functions) {
+			if(!functions || functions->count(fun.first)) {
+				result.push_back({fun.first, fun.second->data->body.get(), fun.second->args});
+			}
+		}
+		for(const auto& cl : info.classes) {
+			if(classes && !classes->count(cl.first)) {
+				continue;
+			}
+			for(const auto& fun : cl.second->function_name_to_id) {
+				if(cl.second->functions[fun.second]->class_info->data->name == cl.second->data->name) {
+					auto args = cl.second->functions[fun.second]->args;
+					args.push_back(std::make_pair(cl.second->data->name, "self"));
+					result.push_back({encode_class_function_name(cl.second->data->name, fun.first), cl.second->functions[fun.second]->data->body.get(), std::move(args)});
+				}
 			}
 		}
+		return result;
 	}
-	for(const auto& str : string_literals) {
-		output << string_label(str.second) << " dq " << str.first.size() << '\n';
-		if(str.first.empty()) {
-			continue;
+
+	size_t count_functions(const TypeInfo& info) {
+		size_t result = info.functions.size();
+		for(const auto& cl : info.classes) {
+			for(const auto& fun : cl.second->functions) {
+				result += fun->class_info->data->name == cl.second->data->name;
+			}
 		}
-		output << "db " << (short) str.first[0];
-		for(size_t i = 1; i < str.first.size(); ++i) {
-			output << ',' << (short) str.first[i];
+		return result;
+	}
+}
+
+size_t count_shards(const TypeInfo& info) {
+	return std::min(MAX_SHARDS, 1 + count_functions(info) / FUNCTIONS_PER_SHARD);
+}
+
+void emit_code(const TypeInfo& info, std::ostream& output, const Optimizer::Instrumentation* instrumentation, size_t threads) {
+	emit_code(info, std::vector<std::ostream*>{&output}, instrumentation, threads);
+}
+
+void emit_code(const TypeInfo& info, const std::vector<std::ostream*>& outputs, const Optimizer::Instrumentation* instrumentation, size_t threads) {
+	std::vector<FunctionCode> functions = collect_functions(info);
+	std::vector<size_t> order = order_by_affinity(info, functions);
+	//a single shard declares nothing for the others and its code goes straight to the output, the others are buffered until it's known what they need
+	size_t count = outputs.size();
+	std::vector<Shard> shards(count);
+	auto code = [&](size_t shard) -> std::ostream& {
+		return count == 1 ? *outputs[0] : shards[shard].code;
+	};
+	if(count == 1) {
+		emit_header(*outputs[0], true, instrumentation);
+	}
+	shards[0].references.insert("main");
+	if(instrumentation) {
+		shards[0].definitions.insert("_profile_counters");
+	}
+	//the labels stay unique in the whole program, affine functions stay together
+	std::vector<FunctionOutput> outputs_of_functions = emit_functions(info, functions, order, instrumentation != nullptr, threads);
+	for(size_t i = 0; i < order.size(); ++i) {
+		size_t index = i * count / order.size();
+		add_function(shards[index], code(index), functions[order[i]].name, outputs_of_functions[i]);
+	}
+	size_t class_index = 0;
+	for(const auto& cl : info.classes) {
+		size_t index = class_index++ * count / info.classes.size();
+		shards[index].definitions.insert(encode_constructor_name(cl.first));
+		shards[index].definitions.insert(encode_vtable_name(cl.first));
+		generate_constructor_and_vtable(*(cl.second), code(index), shards[index].references);
+	}
+	std::map<std::string, size_t> defining_shard;
+	for(size_t i = 0; i < count; ++i) {
+		for(const std::string& symbol : shards[i].definitions) {
+			defining_shard[symbol] = i;
+		}
+	}
+	for(size_t i = 0; i < count; ++i) {
+		std::ostream& output = *outputs[i];
+		if(count > 1) {
+			emit_header(output, i == 0, instrumentation);
+			for(const std::string& symbol : shards[i].definitions) {
+				print(output, "global ", symbol);
+			}
+			for(const std::string& symbol : shards[i].references) {
+				auto it = defining_shard.find(symbol);
+				if(it != defining_shard.end() && it->second != i) {
+					print(output, "extern ", symbol);
+				}
+			}
+			output << shards[i].code.str();
+		}
+		emit_read_only_data(output, shards[i].string_literals, shards[i].constant_arrays);
+		if(i == 0 && instrumentation) {
+			generate_profile_data(*instrumentation, output);
+		}
+	}
+}
+
+void emit_module_code(const TypeInfo& info, const std::set<std::string>& functions, const std::set<std::string>& classes, std::ostream& output, size_t threads) {
+	std::set<std::string> program_symbols;
+	for(const FunctionCode& function : collect_functions(info)) {
+		program_symbols.insert(function.name);
+	}
+	for(const auto& cl : info.classes) {
+		program_symbols.insert(encode_constructor_name(cl.first));
+		program_symbols.insert(encode_vtable_name(cl.first));
+	}
+	std::vector<FunctionCode> module_functions = collect_functions(info, &functions, &classes);
+	Shard shard;
+	std::vector<size_t> order = order_by_affinity(info, module_functions);
+	std::vector<FunctionOutput> outputs_of_functions = emit_functions(info, module_functions, order, false, threads);
+	for(size_t i = 0; i < order.size(); ++i) {
+		add_function(shard, shard.code, module_functions[order[i]].name, outputs_of_functions[i]);
+	}
+	for(const std::string& cl : classes) {
+		shard.definitions.insert(encode_constructor_name(cl));
+		shard.definitions.insert(encode_vtable_name(cl));
+		generate_constructor_and_vtable(*info.classes.at(cl), shard.code, shard.references);
+	}
+	emit_header(output, functions.count("main"), nullptr);
+	for(const std::string& symbol : shard.definitions) {
+		print(output, "global ", symbol);
+	}
+	for(const std::string& symbol : shard.references) {
+		if(program_symbols.count(symbol) && !shard.definitions.count(symbol)) {
+			print(output, "extern ", symbol);
 		}
-		output << '\n';
 	}
+	output << shard.code.str();
+	emit_read_only_data(output, shard.string_literals, shard.constant_arrays);
 }
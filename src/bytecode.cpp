@@ -0,0 +1,689 @@
+#include "bytecode.h"
+#include "helper_visitors.h"
+
+#include <limits>
+#include <map>
+#include <stack>
+
+using namespace ProgramTree;
+using namespace TypeChecker;
+using Bytecode::Opcode;
+
+namespace {
+	const std::string ERROR_FUN_NAME = "error";
+	const std::string PRINT_INT_FUN_NAME = "printInt";
+	const std::string PRINT_STRING_FUN_NAME = "printString";
+	const std::string READ_INT_FUN_NAME = "readInt";
+
+	const size_t NO_INSTRUCTION = std::numeric_limits<size_t>::max();
+
+	std::string encode_class_function_name(const std::string& cl, const std::string& fun) {
+		return "_class_" + cl + '$' + fun;
+	}
+
+	bool is_immediate(Integer val) {
+		return val >= std::numeric_limits<int32_t>::min() && val <= std::numeric_limits<int32_t>::max();
+	}
+
+	//ids of the functions, classes and string literals of the whole program
+	struct Symbols {
+		std::map<std::string, size_t> functions;
+		std::map<std::string, size_t> classes;
+		std::map<std::string, size_t> strings;
+	};
+
+	//where an assigned value goes, a variable is a register, an element or a field is a word in the memory
+	struct Location {
+		enum class Kind {
+			Variable, Element, Field
+		};
+
+		Kind kind;
+		int32_t object; //the variable, the array or the object
+		int32_t index; //the register of the index or the word of the field
+	};
+
+	//variables get registers from the bottom of the frame, temporaries are taken above them and released after each statement
+	class Compiler : public ConstVisitor {
+		const TypeInfo& info;
+		Symbols& symbols;
+		Bytecode::Program& program;
+		size_t& frame_size;
+		std::vector<int32_t> labels; //instruction of each label
+		std::vector<std::pair<size_t, size_t>> jumps; //instruction and its label
+		std::map<std::string, std::stack<int32_t>> variables;
+		std::vector<std::string> variable_names; //in the order of their declarations
+		std::stack<std::pair<size_t, int32_t>> scopes; //variable names and registers of the enclosing blocks
+		int32_t locals; //registers of the variables in scope
+		int32_t top; //first free register
+		int32_t target; //where the visited expression should leave its value, -1 for anywhere
+		int32_t result; //of the last visited expression
+		size_t retargetable; //the last instruction, if it's the only one writing the result
+
+		std::vector<Bytecode::Instruction>& code() {
+			return program.code;
+		}
+
+		void emit(Opcode op, int32_t a = 0, int32_t b = 0, int32_t c = 0) {
+			code().push_back({op, a, b, c});
+			retargetable = NO_INSTRUCTION;
+		}
+
+		void produce(Opcode op, int32_t a, int32_t b = 0, int32_t c = 0) {
+			emit(op, a, b, c);
+			retargetable = code().size() - 1;
+			result = a;
+		}
+
+		int32_t temporaries(size_t count) {
+			int32_t first = top;
+			top += count;
+			frame_size = std::max(frame_size, (size_t) top);
+			return first;
+		}
+
+		int32_t local() {
+			int32_t reg = locals++;
+			top = std::max(top, locals);
+			frame_size = std::max(frame_size, (size_t) top);
+			return reg;
+		}
+
+		int32_t destination() {
+			int32_t reg = target >= 0 ? target : temporaries(1);
+			target = -1;
+			return reg;
+		}
+
+		int32_t evaluate(const Expression& expr) {
+			target = -1;
+			expr.visit(this);
+			return result;
+		}
+
+		void evaluate_into(const Expression& expr, int32_t reg) {
+			target = reg;
+			expr.visit(this);
+			if(result != reg) {
+				emit(Opcode::Move, reg, result);
+			}
+		}
+
+		size_t new_label() {
+			labels.push_back(-1);
+			return labels.size() - 1;
+		}
+
+		//nothing before the label writes only the result anymore, as the label may be reached without it
+		void bind(size_t label) {
+			labels[label] = code().size();
+			retargetable = NO_INSTRUCTION;
+		}
+
+		void jump(Opcode op, size_t label, int32_t b = 0, int32_t c = 0) {
+			jumps.emplace_back(code().size(), label);
+			emit(op, 0, b, c);
+		}
+
+		void declare(const std::string& name, int32_t reg) {
+			variables[name].push(reg);
+			variable_names.push_back(name);
+		}
+
+		int32_t variable(const std::string& name) {
+			auto it = variables.find(name);
+			if(it == variables.end()) {
+				throw std::runtime_error("function in Compiler::variable, type checker error!");
+			}
+			return it->second.top();
+		}
+
+		void open_scope() {
+			scopes.push(std::make_pair(variable_names.size(), locals));
+		}
+
+		void close_scope() {
+			while(variable_names.size() > scopes.top().first) {
+				auto it = variables.find(variable_names.back());
+				it->second.pop();
+				if(it->second.empty()) {
+					variables.erase(it);
+				}
+				variable_names.pop_back();
+			}
+			locals = top = scopes.top().second;
+			scopes.pop();
+		}
+
+		void statement(const Statement& stmt) {
+			stmt.visit(this);
+			top = locals;
+		}
+
+		//a single statement after if, while or for is a block of its own
+		void scoped_statement(const Statement& stmt) {
+			open_scope();
+			statement(stmt);
+			close_scope();
+		}
+
+		class GetLocation : public DefaultConstVisitor {
+			Compiler* parent;
+			Location& location;
+			GetLocation() = delete;
+		public:
+			GetLocation(Compiler* parent, Location& location) : parent(parent), location(location) {}
+
+			virtual void default_action() override {
+				throw std::runtime_error("expected address of a non-variable variable, type checker error");
+			}
+
+			virtual void apply(const Variable& arg) override {
+				location = {Location::Kind::Variable, parent->variable(arg.name), 0};
+			}
+
+			//the index is evaluated before the array, like in the x86_64 backend
+			virtual void apply(const SubscriptOperator& arg) override {
+				int32_t index = parent->evaluate(*arg.index);
+				int32_t array = parent->evaluate(*arg.arr);
+				location = {Location::Kind::Element, array, index};
+			}
+
+			virtual void apply(const Cast& arg) override {
+				arg.expr->visit(this);
+			}
+
+			virtual void apply(const ClassMember& arg) override {
+				int32_t object = parent->evaluate(*arg.object);
+				const ClassInfo& cl = *parent->info.classes.at(arg.object->type);
+				location = {Location::Kind::Field, object, (int32_t) cl.variable_name_to_id.at(arg.member) + 1};
+			}
+		};
+
+		Location locate(const Expression& expr) {
+			Location location;
+			GetLocation gl(this, location);
+			expr.visit(&gl);
+			return location;
+		}
+
+		int32_t load(const Location& location) {
+			int32_t reg = temporaries(1);
+			emit(location.kind == Location::Kind::Element ? Opcode::LoadElement : Opcode::LoadField, reg, location.object, location.index);
+			return reg;
+		}
+
+		//a value computed by the last instruction into a temporary is computed right into the variable instead
+		void store(const Location& location, int32_t value) {
+			if(location.kind == Location::Kind::Element) {
+				emit(Opcode::StoreElement, location.object, location.index, value);
+			} else if(location.kind == Location::Kind::Field) {
+				emit(Opcode::StoreField, location.object, location.index, value);
+			} else if(retargetable == code().size() - 1 && value >= locals && code().back().a == value) {
+				code().back().a = location.object;
+				retargetable = NO_INSTRUCTION;
+			} else if(value != location.object) {
+				emit(Opcode::Move, location.object, value);
+			}
+		}
+
+		void add_to(const Expression& var, int32_t amount) {
+			Location location = locate(var);
+			if(location.kind == Location::Kind::Variable) {
+				emit(Opcode::AddImmediate, location.object, location.object, amount);
+				return;
+			}
+			int32_t value = load(location);
+			emit(Opcode::AddImmediate, value, value, amount);
+			store(location, value);
+		}
+
+		//a literal small enough for the instruction, null otherwise
+		const Integer* immediate(const Expression& expr) {
+			const literal_type<LiteralType::Integer>::type* val = nullptr;
+			LiteralGetter<LiteralType::Integer> lg(val);
+			expr.visit(&lg);
+			return val && is_immediate(*val) ? val : nullptr;
+		}
+
+		//the right operand is evaluated first, like in the x86_64 backend
+		void int_op(const Expression& l, const Expression& r, Opcode op) {
+			int32_t dest = destination();
+			int32_t b = evaluate(r);
+			int32_t a = evaluate(l);
+			produce(op, dest, a, b);
+		}
+
+		//adding a small literal takes one register less
+		void add(const Expression& l, const Expression& r, bool negate) {
+			const Integer* literal = immediate(r);
+			if(!literal || (negate && *literal == std::numeric_limits<int32_t>::min())) {
+				int_op(l, r, negate ? Opcode::Substract : Opcode::Add);
+				return;
+			}
+			int32_t dest = destination();
+			int32_t a = evaluate(l);
+			produce(Opcode::AddImmediate, dest, a, negate ? -*literal : *literal);
+		}
+
+		void boolean_op(const Expression& l, const Expression& r, bool conjunction) {
+			int32_t dest = destination();
+			size_t done = new_label();
+			evaluate_into(l, dest);
+			jump(conjunction ? Opcode::JumpUnless : Opcode::JumpIf, done, dest);
+			evaluate_into(r, dest);
+			bind(done);
+			result = dest;
+		}
+
+		//conditions of ifs and loops jump on the comparison right away instead of computing a boolean first
+		class Branch : public DefaultConstVisitor {
+			Compiler* parent;
+			bool when;
+			size_t label;
+			bool& done;
+			Branch() = delete;
+
+			void compare(const Expression& l, const Expression& r, Opcode op, Opcode negated) {
+				int32_t b = parent->evaluate(r);
+				int32_t a = parent->evaluate(l);
+				parent->jump(when ? op : negated, label, a, b);
+			}
+
+			//jumps if both are true or any is false, otherwise it checks both
+			void boolean_op(const Expression& l, const Expression& r, bool conjunction) {
+				if(when != conjunction) {
+					parent->branch(l, when, label);
+					parent->branch(r, when, label);
+					return;
+				}
+				size_t skip = parent->new_label();
+				parent->branch(l, !when, skip);
+				parent->branch(r, when, label);
+				parent->bind(skip);
+			}
+		public:
+			Branch(Compiler* parent, bool when, size_t label, bool& done) : parent(parent), when(when), label(label), done(done) {}
+
+			virtual void default_action() override {
+				done = false;
+			}
+
+			virtual void apply(const BinaryOperator<BinOpType::Alternative>& arg) override {
+				boolean_op(*arg.left, *arg.right, false);
+			}
+
+			virtual void apply(const BinaryOperator<BinOpType::Conjunction>& arg) override {
+				boolean_op(*arg.left, *arg.right, true);
+			}
+
+			virtual void apply(const BinaryOperator<BinOpType::LessThan>& arg) override {
+				compare(*arg.left, *arg.right, Opcode::JumpLess, Opcode::JumpGreaterEqual);
+			}
+
+			virtual void apply(const BinaryOperator<BinOpType::LessEqual>& arg) override {
+				compare(*arg.left, *arg.right, Opcode::JumpLessEqual, Opcode::JumpGreater);
+			}
+
+			virtual void apply(const BinaryOperator<BinOpType::GreaterThan>& arg) override {
+				compare(*arg.left, *arg.right, Opcode::JumpGreater, Opcode::JumpLessEqual);
+			}
+
+			virtual void apply(const BinaryOperator<BinOpType::GreaterEqual>& arg) override {
+				compare(*arg.left, *arg.right, Opcode::JumpGreaterEqual, Opcode::JumpLess);
+			}
+
+			virtual void apply(const BinaryOperator<BinOpType::Equal>& arg) override {
+				compare(*arg.left, *arg.right, Opcode::JumpEqual, Opcode::JumpNotEqual);
+			}
+
+			virtual void apply(const BinaryOperator<BinOpType::NotEqual>& arg) override {
+				compare(*arg.left, *arg.right, Opcode::JumpNotEqual, Opcode::JumpEqual);
+			}
+
+			virtual void apply(const UnaryOperator<UnOpType::BoolNegation>& arg) override {
+				parent->branch(*arg.expr, !when, label);
+			}
+
+			virtual void apply(const Literal<LiteralType::Bool>& arg) override {
+				if(arg.val == when) {
+					parent->jump(Opcode::Jump, label);
+				}
+			}
+		};
+
+		//jumps to the label if the condition is equal to when, otherwise falls through
+		void branch(const Expression& condition, bool when, size_t label) {
+			bool done = true;
+			Branch b(this, when, label, done);
+			condition.visit(&b);
+			if(!done) {
+				jump(when ? Opcode::JumpIf : Opcode::JumpUnless, label, evaluate(condition));
+			}
+		}
+
+		int32_t string_literal(const std::string& val) {
+			auto it = symbols.strings.find(val);
+			if(it != symbols.strings.end()) {
+				return it->second;
+			}
+			symbols.strings[val] = program.strings.size();
+			program.strings.push_back(val);
+			return program.strings.size() - 1;
+		}
+
+		void call_arguments(const std::vector<std::unique_ptr<Expression>>& args, int32_t first) {
+			for(size_t i = 0; i < args.size(); ++i) {
+				evaluate_into(*args[i], first + i);
+			}
+		}
+
+		void builtin_call(const StaticFunctionCall& arg) {
+			if(arg.fun == ERROR_FUN_NAME) {
+				emit(Opcode::Error);
+			} else if(arg.fun == PRINT_INT_FUN_NAME || arg.fun == PRINT_STRING_FUN_NAME) {
+				emit(arg.fun == PRINT_INT_FUN_NAME ? Opcode::PrintInt : Opcode::PrintString, evaluate(*arg.args[0]));
+			} else {
+				produce(arg.fun == READ_INT_FUN_NAME ? Opcode::ReadInt : Opcode::ReadString, destination());
+				return;
+			}
+			target = -1;
+			result = -1;
+		}
+
+	public:
+		virtual void apply(const BinaryOperator<BinOpType::Addition>& arg) {
+			add(*arg.left, *arg.right, false);
+		}
+		virtual void apply(const BinaryOperator<BinOpType::Substraction>& arg) {
+			add(*arg.left, *arg.right, true);
+		}
+		virtual void apply(const BinaryOperator<BinOpType::Multiplication>& arg) {
+			int_op(*arg.left, *arg.right, Opcode::Multiply);
+		}
+		virtual void apply(const BinaryOperator<BinOpType::Division>& arg) {
+			int_op(*arg.left, *arg.right, Opcode::Divide);
+		}
+		virtual void apply(const BinaryOperator<BinOpType::Modulo>& arg) {
+			int_op(*arg.left, *arg.right, Opcode::Modulo);
+		}
+		virtual void apply(const BinaryOperator<BinOpType::Alternative>& arg) {
+			boolean_op(*arg.left, *arg.right, false);
+		}
+		virtual void apply(const BinaryOperator<BinOpType::Conjunction>& arg) {
+			boolean_op(*arg.left, *arg.right, true);
+		}
+		virtual void apply(const BinaryOperator<BinOpType::LessThan>& arg) {
+			int_op(*arg.left, *arg.right, Opcode::Less);
+		}
+		virtual void apply(const BinaryOperator<BinOpType::LessEqual>& arg) {
+			int_op(*arg.left, *arg.right, Opcode::LessEqual);
+		}
+		virtual void apply(const BinaryOperator<BinOpType::GreaterThan>& arg) {
+			int_op(*arg.left, *arg.right, Opcode::Greater);
+		}
+		virtual void apply(const BinaryOperator<BinOpType::GreaterEqual>& arg) {
+			int_op(*arg.left, *arg.right, Opcode::GreaterEqual);
+		}
+		virtual void apply(const BinaryOperator<BinOpType::Equal>& arg) {
+			int_op(*arg.left, *arg.right, Opcode::Equal);
+		}
+		virtual void apply(const BinaryOperator<BinOpType::NotEqual>& arg) {
+			int_op(*arg.left, *arg.right, Opcode::NotEqual);
+		}
+		virtual void apply(const UnaryOperator<UnOpType::IntNegation>& arg) {
+			int32_t dest = destination();
+			produce(Opcode::Negate, dest, evaluate(*arg.expr));
+		}
+		virtual void apply(const UnaryOperator<UnOpType::BoolNegation>& arg) {
+			int32_t dest = destination();
+			produce(Opcode::Not, dest, evaluate(*arg.expr));
+		}
+		virtual void apply(const Literal<LiteralType::Bool>& arg) {
+			produce(Opcode::LoadInt, destination(), arg.val);
+		}
+		virtual void apply(const Literal<LiteralType::Integer>& arg) {
+			if(is_immediate(arg.val)) {
+				produce(Opcode::LoadInt, destination(), arg.val);
+			} else {
+				program.constants.push_back(arg.val);
+				produce(Opcode::LoadConstant, destination(), program.constants.size() - 1);
+			}
+		}
+		virtual void apply(const Literal<LiteralType::String>& arg) {
+			produce(Opcode::LoadString, destination(), string_literal(arg.val));
+		}
+		virtual void apply(const Variable& arg) {
+			int32_t reg = variable(arg.name);
+			if(target >= 0) {
+				produce(Opcode::Move, destination(), reg);
+			} else {
+				result = reg;
+			}
+		}
+		virtual void apply(const Null& arg) {
+			(void) arg;
+			produce(Opcode::LoadInt, destination(), 0);
+		}
+		virtual void apply(const StaticFunctionCall& arg) {
+			if(arg.constant) {
+				program.arrays.push_back(arg.constant.get());
+				produce(Opcode::LoadArray, destination(), program.arrays.size() - 1);
+				return;
+			}
+			if(BUILTIN_FUNCTIONS.count(arg.fun)) {
+				builtin_call(arg);
+				return;
+			}
+			int32_t dest = destination();
+			if(arg.fun == CONCAT_FUN_NAME) {
+				int32_t a = evaluate(*arg.args[0]);
+				int32_t b = evaluate(*arg.args[1]);
+				produce(Opcode::Concat, dest, a, b);
+				return;
+			}
+			int32_t first = temporaries(arg.args.size());
+			call_arguments(arg.args, first);
+			if(arg.fun == CONCAT_N_FUN_NAME) {
+				produce(Opcode::ConcatN, dest, first, arg.args.size());
+			} else {
+				produce(Opcode::Call, dest, symbols.functions.at(arg.fun), first);
+			}
+		}
+		//the arguments are evaluated before the object, like in the x86_64 backend
+		virtual void apply(const VirtualFunctionCall& arg) {
+			int32_t dest = destination();
+			int32_t first = temporaries(arg.args.size() + 1);
+			call_arguments(arg.args, first + 1);
+			evaluate_into(*arg.object, first);
+			const ClassInfo& cl = *info.classes.at(arg.object->type);
+			produce(Opcode::CallVirtual, dest, cl.function_name_to_id.at(arg.fun), first);
+		}
+		virtual void apply(const CallOperator& arg) {
+			(void) arg;
+			throw std::runtime_error("Internal type checker error.");
+		}
+		virtual void apply(const SubscriptOperator& arg) {
+			int32_t dest = destination();
+			Location location = locate(arg);
+			produce(Opcode::LoadElement, dest, location.object, location.index);
+		}
+		virtual void apply(const ClassMember& arg) {
+			int32_t dest = destination();
+			if(is_array(arg.object->type)) {
+				produce(Opcode::Length, dest, evaluate(*arg.object));
+				return;
+			}
+			Location location = locate(arg);
+			produce(Opcode::LoadField, dest, location.object, location.index);
+		}
+		virtual void apply(const Cast& arg) {
+			arg.expr->visit(this);
+		}
+		//objects and arrays the escape analysis would put on the stack don't cost more on the heap here
+		virtual void apply(const NewObject& arg) {
+			produce(Opcode::NewObject, destination(), symbols.classes.at(arg.new_type));
+		}
+		virtual void apply(const NewArray& arg) {
+			int32_t dest = destination();
+			produce(Opcode::NewArray, dest, evaluate(*arg.size), arg.new_type == STR_TYPE);
+		}
+		//the value is evaluated before the address, like in the x86_64 backend
+		virtual void apply(const Assignment& arg) {
+			int32_t value = evaluate(*arg.value);
+			store(locate(*arg.var), value);
+		}
+		virtual void apply(const Incrementation& arg) {
+			add_to(*arg.var, 1);
+		}
+		virtual void apply(const Decrementation& arg) {
+			add_to(*arg.var, -1);
+		}
+		virtual void apply(const ExprStatement& arg) {
+			evaluate(*arg.expr);
+		}
+		virtual void apply(const Return& arg) {
+			if(arg.val) {
+				emit(Opcode::Return, evaluate(*arg.val));
+			} else {
+				emit(Opcode::ReturnVoid);
+			}
+		}
+		virtual void apply(const If& arg) {
+			size_t else_label = new_label();
+			size_t done = new_label();
+			branch(*arg.condition, false, arg.case_else ? else_label : done);
+			scoped_statement(*arg.case_then);
+			if(arg.case_else) {
+				jump(Opcode::Jump, done);
+				bind(else_label);
+				scoped_statement(*arg.case_else);
+			}
+			bind(done);
+		}
+		//the condition is checked at the bottom, so an iteration takes a single jump
+		virtual void apply(const While& arg) {
+			size_t body = new_label();
+			size_t condition = new_label();
+			jump(Opcode::Jump, condition);
+			bind(body);
+			scoped_statement(*arg.action);
+			bind(condition);
+			branch(*arg.condition, true, body);
+		}
+		virtual void apply(const For& arg) {
+			open_scope();
+			int32_t array = local();
+			evaluate_into(*arg.array, array);
+			int32_t length = local();
+			emit(Opcode::Length, length, array);
+			int32_t index = local();
+			emit(Opcode::LoadInt, index, 0);
+			int32_t element = local();
+			declare(arg.var_name, element);
+
+			size_t body = new_label();
+			size_t condition = new_label();
+			jump(Opcode::Jump, condition);
+			bind(body);
+			emit(Opcode::LoadElement, element, array, index);
+			scoped_statement(*arg.action);
+			emit(Opcode::AddImmediate, index, index, 1);
+			bind(condition);
+			jump(Opcode::JumpLess, body, index, length);
+			close_scope();
+		}
+		virtual void apply(const Block& arg) {
+			open_scope();
+			for(const auto& s : arg.statements) {
+				statement(*s);
+			}
+			close_scope();
+		}
+		virtual void apply(const Empty& arg) {
+			(void) arg;
+		}
+		virtual void apply(const Definition& arg) {
+			for(const auto& def : arg.defs) {
+				int32_t reg = local();
+				if(def.second) {
+					evaluate_into(*def.second, reg);
+				} else if(arg.type == STR_TYPE || is_array(arg.type)) {
+					emit(Opcode::LoadEmpty, reg, is_array(arg.type));
+				} else {
+					emit(Opcode::LoadInt, reg, 0);
+				}
+				top = locals;
+				declare(def.first, reg);
+			}
+		}
+
+		//the arguments are the first registers, the end of a function is reachable only in void ones
+		void compile_function(const std::vector<std::pair<Type, std::string>>& args, const Block& body) {
+			for(const auto& a : args) {
+				declare(a.second, local());
+			}
+			statement(body);
+			emit(Opcode::ReturnVoid);
+			for(const auto& j : jumps) {
+				code()[j.first].a = labels[j.second];
+			}
+		}
+
+		Compiler() = delete;
+		Compiler(const TypeInfo& info, Symbols& symbols, Bytecode::Program& program, size_t& frame_size) : info(info), symbols(symbols), program(program), frame_size(frame_size), locals(0), top(0), target(-1), result(-1), retargetable(NO_INSTRUCTION) {}
+	};
+
+	void compile_function(const TypeInfo& info, Symbols& symbols, Bytecode::Program& program, size_t id, const std::vector<std::pair<Type, std::string>>& args, const Block& body) {
+		Bytecode::Function& function = program.functions[id];
+		function.entry = program.code.size();
+		function.frame_size = 0;
+		Compiler c(info, symbols, program, function.frame_size);
+		c.compile_function(args, body);
+	}
+}
+
+Bytecode::Program Bytecode::compile(const TypeInfo& info) {
+	Program program;
+	Symbols symbols;
+	//every function gets its id before any call is compiled
+	for(const auto& fun : info.functions) {
+		size_t id = symbols.functions.size();
+		symbols.functions[fun.first] = id;
+	}
+	for(const auto& cl : info.classes) {
+		size_t id = symbols.classes.size();
+		symbols.classes[cl.first] = id;
+		for(const auto& fun : cl.second->function_name_to_id) {
+			if(cl.second->functions[fun.second]->class_info == cl.second.get()) {
+				size_t method_id = symbols.functions.size();
+				symbols.functions[encode_class_function_name(cl.first, fun.first)] = method_id;
+			}
+		}
+	}
+	program.functions.resize(symbols.functions.size());
+	program.main = symbols.functions.at("main");
+
+	for(const auto& fun : info.functions) {
+		compile_function(info, symbols, program, symbols.functions.at(fun.first), fun.second->args, *fun.second->data->body);
+	}
+	for(const auto& cl : info.classes) {
+		Bytecode::Class layout;
+		layout.vtable.resize(cl.second->functions.size());
+		for(const auto& fun : cl.second->function_name_to_id) {
+			const VirtualFunctionInfo& f = *cl.second->functions[fun.second];
+			size_t id = symbols.functions.at(encode_class_function_name(f.class_info->data->name, fun.first));
+			layout.vtable[fun.second] = id;
+			if(f.class_info == cl.second.get()) {
+				std::vector<std::pair<Type, std::string>> args = {std::make_pair(cl.first, THIS_NAME)};
+				args.insert(args.end(), f.args.begin(), f.args.end());
+				compile_function(info, symbols, program, id, args, *f.data->body);
+			}
+		}
+		for(const auto& var : cl.second->variables) {
+			layout.fields.push_back(var.first == STR_NAME ? Bytecode::Field::EmptyString : is_array(var.first) ? Bytecode::Field::EmptyArray : Bytecode::Field::Zero);
+		}
+		program.classes.push_back(std::move(layout));
+	}
+	return program;
+}
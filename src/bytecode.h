@@ -0,0 +1,88 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "program_tree.h"
+#include "type_info_builder.h"
+#include "compile_time_evaluation.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Bytecode {
+	//a is the destination unless said otherwise, b and c are the operands, registers are numbered from the base of the current frame
+	enum class Opcode : uint32_t {
+		Move, //a = b
+		LoadInt, //a = b as a signed immediate
+		LoadConstant, //a = constants[b]
+		LoadString, //a = strings[b]
+		LoadArray, //a = arrays[b]
+		LoadEmpty, //a = the empty string, or the empty array if b is set
+		Add, Substract, Multiply, Divide, Modulo, //a = b op c, division by zero is an error
+		AddImmediate, //a = b + c as a signed immediate
+		Negate, //a = -b
+		Not, //a = !b
+		Less, LessEqual, Greater, GreaterEqual, Equal, NotEqual, //a = b op c
+		Jump, //to a
+		JumpIf, JumpUnless, //to a if b is true or false
+		JumpLess, JumpLessEqual, JumpGreater, JumpGreaterEqual, JumpEqual, JumpNotEqual, //to a if b op c
+		Call, //a = functions[b] called with the registers from c on as its first ones
+		CallVirtual, //like Call, but the function is the b-th in the vtable of the object in c, followed by the arguments
+		Return, //returns a
+		ReturnVoid,
+		PrintInt, PrintString, //prints a
+		ReadInt, ReadString,
+		Error,
+		Concat, //a = b + c
+		ConcatN, //a = the c strings from b on concatenated
+		NewObject, //a = new classes[b]
+		NewArray, //a = new array of size b, of strings if c is set
+		Length, //a = b.length
+		LoadElement, //a = b[c], out of bounds is an error
+		StoreElement, //a[b] = c
+		LoadField, //a = the c-th word of the object b
+		StoreField, //the b-th word of the object a = c
+		Count
+	};
+
+	struct Instruction {
+		Opcode op;
+		int32_t a;
+		int32_t b;
+		int32_t c;
+	};
+
+	struct Function {
+		size_t entry; //index of the first instruction
+		size_t frame_size; //registers used by the function, arguments come first
+	};
+
+	//initial value of a field
+	enum class Field : uint8_t {
+		Zero, EmptyString, EmptyArray
+	};
+
+	//the object is its vtable followed by the fields
+	struct Class {
+		std::vector<size_t> vtable; //functions
+		std::vector<Field> fields;
+	};
+
+	struct Program {
+		std::vector<Instruction> code;
+		std::vector<Function> functions;
+		std::vector<Class> classes;
+		std::vector<ProgramTree::Integer> constants; //ints that don't fit an immediate
+		std::vector<std::string> strings;
+		std::vector<const ProgramTree::ConstantArray*> arrays;
+		size_t main;
+	};
+
+	//methods get the object as the first argument, values are kept in the memory layout of the compiled code
+	Program compile(const TypeChecker::TypeInfo& info);
+
+	//runs main with computed-goto dispatch, the runtime's functions are reimplemented with the same results, the program's exit ends the process
+	[[noreturn]] void interpret(const Program& program);
+}
+
+#endif
@@ -0,0 +1,105 @@
+#include "cache.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+	const std::string ENTRY_PREFIX = "latc-";
+	const std::string STATISTICS_FILE = "statistics";
+	const char HIT = 'h';
+	const char MISS = 'm';
+
+	std::atomic<uint64_t> stores(0);
+}
+
+std::string CompilationCache::entry(uint64_t key) const {
+	std::ostringstream result;
+	result << directory << '/' << ENTRY_PREFIX << std::hex << key;
+	return result.str();
+}
+
+//one character per lookup appended at once, compilations running in parallel don't lose each other's counts
+void CompilationCache::count(char event) const {
+	int file = open((directory + '/' + STATISTICS_FILE).data(), O_WRONLY | O_CREAT | O_APPEND, 0666);
+	if(file < 0) {
+		return;
+	}
+	ssize_t written = write(file, &event, 1);
+	(void) written;
+	close(file);
+}
+
+std::string CompilationCache::find(uint64_t key) const {
+	std::string path = entry(key);
+	bool hit = access(path.data(), X_OK) == 0;
+	count(hit ? HIT : MISS);
+	return hit ? path : "";
+}
+
+void CompilationCache::store(uint64_t key, const std::string& executable) const {
+	std::string path = entry(key);
+	//the threads of a batch share the pid, every store needs a file of its own
+	std::string temporary = path + '.' + std::to_string(getpid()) + '.' + std::to_string(stores++);
+	int file = open(temporary.data(), O_WRONLY | O_CREAT | O_TRUNC, 0777);
+	if(file < 0) {
+		throw std::runtime_error("Can't write to the cache " + directory + ".");
+	}
+	size_t done = 0;
+	while(done < executable.size()) {
+		ssize_t written = write(file, executable.data() + done, executable.size() - done);
+		if(written <= 0) {
+			break;
+		}
+		done += written;
+	}
+	bool success = !close(file) && done == executable.size();
+	if(success && !rename(temporary.data(), path.data())) {
+		return;
+	}
+	unlink(temporary.data());
+	//another store of the same key got there first, the entries are the same
+	struct stat existing;
+	if(!success || stat(path.data(), &existing)) {
+		throw std::runtime_error("Can't write to the cache " + directory + ".");
+	}
+}
+
+CompilationCache::Statistics CompilationCache::statistics() const {
+	Statistics result = {0, 0, 0, 0};
+	std::ifstream counts(directory + '/' + STATISTICS_FILE, std::ios_base::binary);
+	char event;
+	while(counts.get(event)) {
+		result.hits += event == HIT;
+		result.misses += event == MISS;
+	}
+	DIR* entries = opendir(directory.data());
+	if(!entries) {
+		return result;
+	}
+	while(dirent* e = readdir(entries)) {
+		std::string name(e->d_name);
+		struct stat s;
+		//unfinished entries have a dot after the key
+		if(name.compare(0, ENTRY_PREFIX.size(), ENTRY_PREFIX) || name.find('.') != std::string::npos || stat((directory + '/' + name).data(), &s)) {
+			continue;
+		}
+		++result.entries;
+		result.bytes += s.st_size;
+	}
+	closedir(entries);
+	return result;
+}
+
+CompilationCache::CompilationCache(const std::string& directory) : directory(directory) {
+	if(mkdir(directory.data(), 0777) && errno != EEXIST) {
+		throw std::runtime_error("Can't create the cache " + directory + ".");
+	}
+}
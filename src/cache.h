@@ -0,0 +1,35 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <cstdint>
+#include <string>
+
+//executables compiled before, named by the hash of everything they were compiled from, shared by all the programs compiled with the same directory
+class CompilationCache {
+	const std::string directory;
+
+	std::string entry(uint64_t key) const;
+	void count(char event) const;
+
+public:
+	struct Statistics {
+		size_t hits;
+		size_t misses;
+		size_t entries;
+		uint64_t bytes;
+	};
+
+	//the path of the cached executable, or an empty string, the lookup counts as a hit or a miss
+	std::string find(uint64_t key) const;
+
+	//the entry appears at once, so concurrent compilations never see a partial executable
+	void store(uint64_t key, const std::string& executable) const;
+
+	Statistics statistics() const;
+
+	CompilationCache() = delete;
+	//the directory is created if it doesn't exist
+	CompilationCache(const std::string& directory);
+};
+
+#endif
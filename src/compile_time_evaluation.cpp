@@ -0,0 +1,736 @@
+#include "compile_time_evaluation.h"
+#include "helper_visitors.h"
+
+#include <limits>
+#include <map>
+#include <set>
+
+using namespace ProgramTree;
+using namespace TypeChecker;
+
+namespace {
+	//statements and expressions executed during the evaluation of one call
+	const size_t STEP_LIMIT = 1000000;
+
+	const size_t CALL_DEPTH_LIMIT = 512;
+
+	//array elements and string characters created during the evaluation of one call
+	const size_t ALLOCATION_LIMIT = 1 << 16;
+
+	//elements of an array that replaces a call
+	const size_t RESULT_SIZE_LIMIT = 1024;
+
+	//thrown when the evaluation reaches something that has to be left for the run time
+	struct NotConstant {};
+
+	struct Constant {
+		enum class Kind {
+			Integer, Bool, String, Array
+		};
+
+		Kind kind;
+		Integer integer;
+		bool boolean;
+		std::string string;
+		std::shared_ptr<std::vector<Constant>> array;
+
+		Constant() : kind(Kind::Integer), integer(0), boolean(false) {}
+	};
+
+	Constant make_integer(Integer integer) {
+		Constant c;
+		c.integer = integer;
+		return c;
+	}
+
+	Constant make_bool(bool boolean) {
+		Constant c;
+		c.kind = Constant::Kind::Bool;
+		c.boolean = boolean;
+		return c;
+	}
+
+	Constant make_string(std::string&& string) {
+		Constant c;
+		c.kind = Constant::Kind::String;
+		c.string = std::move(string);
+		return c;
+	}
+
+	Integer wrap(uint64_t val) {
+		return (Integer) val;
+	}
+
+	void check_division(Integer a, Integer b) {
+		if(b == 0 || (b == -1 && a == std::numeric_limits<Integer>::min())) {
+			throw NotConstant();
+		}
+	}
+
+	//calls with scalar arguments are memoized, the key is the function name followed by the arguments
+	bool append_key(std::string& key, const Constant& c) {
+		switch(c.kind) {
+		case Constant::Kind::Integer:
+			key += 'i' + std::to_string(c.integer) + ',';
+			return true;
+		case Constant::Kind::Bool:
+			key += c.boolean ? "t," : "f,";
+			return true;
+		case Constant::Kind::String:
+			key += 's' + std::to_string(c.string.size()) + ':' + c.string + ',';
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	bool get_literal(const Expression& e, Constant& result) {
+		const literal_type<LiteralType::Integer>::type* integer = nullptr;
+		LiteralGetter<LiteralType::Integer> ig(integer);
+		e.visit(&ig);
+		if(integer) {
+			result = make_integer(*integer);
+			return true;
+		}
+		const literal_type<LiteralType::Bool>::type* boolean = nullptr;
+		LiteralGetter<LiteralType::Bool> bg(boolean);
+		e.visit(&bg);
+		if(boolean) {
+			result = make_bool(*boolean);
+			return true;
+		}
+		const literal_type<LiteralType::String>::type* string = nullptr;
+		LiteralGetter<LiteralType::String> sg(string);
+		e.visit(&sg);
+		if(string) {
+			result = make_string(std::string(*string));
+			return true;
+		}
+		return false;
+	}
+
+	//interprets calls of functions without side effects, objects and anything that would fail at run time abort the evaluation
+	class Evaluator : public DefaultConstVisitor {
+		const TypeInfo& info;
+		std::map<std::string, Constant>& memo;
+		std::vector<std::map<std::string, Constant>> scopes;
+		Constant value; //of the last evaluated expression or return statement
+		bool returned;
+		size_t steps;
+		size_t depth;
+		size_t allocated;
+
+		//a variable or an array element that's written to
+		class Target : public DefaultConstVisitor {
+			Evaluator* parent;
+			Constant* variable;
+			std::shared_ptr<std::vector<Constant>> array;
+			size_t index;
+			Target() = delete;
+		public:
+			Target(Evaluator* parent) : parent(parent), variable(nullptr), index(0) {}
+
+			virtual void default_action() override {
+				throw NotConstant();
+			}
+
+			virtual void apply(const Variable& arg) override {
+				variable = &parent->lookup(arg.name);
+			}
+
+			virtual void apply(const SubscriptOperator& arg) override {
+				array = parent->eval_array(*arg.arr);
+				index = parent->eval_index(*arg.index, *array);
+			}
+
+			Constant& get() {
+				return variable ? *variable : (*array)[index];
+			}
+		};
+
+		void step() {
+			if(++steps > STEP_LIMIT) {
+				throw NotConstant();
+			}
+		}
+
+		void allocate(size_t size) {
+			if(size > ALLOCATION_LIMIT || (allocated += size) > ALLOCATION_LIMIT) {
+				throw NotConstant();
+			}
+		}
+
+		Constant& lookup(const std::string& name) {
+			for(auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+				auto var = it->find(name);
+				if(var != it->end()) {
+					return var->second;
+				}
+			}
+			throw NotConstant();
+		}
+
+		Constant default_value(Type type) {
+			if(type == INT_TYPE) {
+				return make_integer(0);
+			}
+			if(type == BOOL_TYPE) {
+				return make_bool(false);
+			}
+			if(type == STR_TYPE) {
+				return make_string("");
+			}
+			if(is_array(type)) {
+				Constant c;
+				c.kind = Constant::Kind::Array;
+				c.array = std::make_shared<std::vector<Constant>>();
+				return c;
+			}
+			throw NotConstant();
+		}
+
+		Constant eval(const Expression& e) {
+			step();
+			e.visit(this);
+			return value;
+		}
+
+		Integer eval_integer(const Expression& e) {
+			Constant c = eval(e);
+			if(c.kind != Constant::Kind::Integer) {
+				throw NotConstant();
+			}
+			return c.integer;
+		}
+
+		bool eval_bool(const Expression& e) {
+			Constant c = eval(e);
+			if(c.kind != Constant::Kind::Bool) {
+				throw NotConstant();
+			}
+			return c.boolean;
+		}
+
+		std::shared_ptr<std::vector<Constant>> eval_array(const Expression& e) {
+			Constant c = eval(e);
+			if(c.kind != Constant::Kind::Array) {
+				throw NotConstant();
+			}
+			return c.array;
+		}
+
+		size_t eval_index(const Expression& e, const std::vector<Constant>& array) {
+			Integer index = eval_integer(e);
+			if(index < 0 || (size_t) index >= array.size()) {
+				throw NotConstant();
+			}
+			return index;
+		}
+
+		void execute(const Statement& s) {
+			step();
+			s.visit(this);
+		}
+
+		template<typename F>
+		void integer_operation(const Expression& l, const Expression& r, F operation) {
+			Integer a = eval_integer(l);
+			Integer b = eval_integer(r);
+			value = operation(a, b);
+		}
+
+		//only ints and booleans, other types are compared by their addresses
+		template<BinOpType T>
+		bool equal(const BinaryOperator<T>& arg) {
+			Constant l = eval(*arg.left);
+			Constant r = eval(*arg.right);
+			if(l.kind != r.kind || (l.kind != Constant::Kind::Integer && l.kind != Constant::Kind::Bool)) {
+				throw NotConstant();
+			}
+			return l.kind == Constant::Kind::Integer ? l.integer == r.integer : l.boolean == r.boolean;
+		}
+
+		void step_target(const Expression& e, uint64_t delta) {
+			Target t(this);
+			e.visit(&t);
+			Constant& c = t.get();
+			if(c.kind != Constant::Kind::Integer) {
+				throw NotConstant();
+			}
+			c.integer = wrap(c.integer + delta);
+		}
+
+		Constant call(const FunctionInfo& fun, std::vector<Constant>&& args) {
+			if(fun.side_effects || fun.return_type == VOID_TYPE || depth >= CALL_DEPTH_LIMIT) {
+				throw NotConstant();
+			}
+			std::string key = fun.data->name + '(';
+			bool memoized = true;
+			for(const auto& a : args) {
+				memoized = memoized && append_key(key, a);
+			}
+			if(memoized) {
+				auto it = memo.find(key);
+				if(it != memo.end()) {
+					return it->second;
+				}
+			}
+			std::vector<std::map<std::string, Constant>> frame(1);
+			for(size_t i = 0; i < args.size(); ++i) {
+				frame[0][fun.args[i].second] = std::move(args[i]);
+			}
+			std::swap(frame, scopes);
+			++depth;
+			execute(*fun.data->body);
+			--depth;
+			std::swap(frame, scopes);
+			if(!returned) {
+				throw NotConstant();
+			}
+			returned = false;
+			if(memoized && value.kind != Constant::Kind::Array) {
+				memo[key] = value;
+			}
+			return value;
+		}
+
+	public:
+		virtual void default_action() override {
+			throw NotConstant();
+		}
+
+		virtual void apply(const BinaryOperator<BinOpType::Addition>& arg) override {
+			integer_operation(*arg.left, *arg.right, [](Integer a, Integer b) {
+				return make_integer(wrap((uint64_t) a + (uint64_t) b));
+			});
+		}
+
+		virtual void apply(const BinaryOperator<BinOpType::Multiplication>& arg) override {
+			integer_operation(*arg.left, *arg.right, [](Integer a, Integer b) {
+				return make_integer(wrap((uint64_t) a * (uint64_t) b));
+			});
+		}
+
+		virtual void apply(const BinaryOperator<BinOpType::Division>& arg) override {
+			integer_operation(*arg.left, *arg.right, [](Integer a, Integer b) {
+				check_division(a, b);
+				return make_integer(a / b);
+			});
+		}
+
+		virtual void apply(const BinaryOperator<BinOpType::Substraction>& arg) override {
+			integer_operation(*arg.left, *arg.right, [](Integer a, Integer b) {
+				return make_integer(wrap((uint64_t) a - (uint64_t) b));
+			});
+		}
+
+		virtual void apply(const BinaryOperator<BinOpType::Alternative>& arg) override {
+			value = make_bool(eval_bool(*arg.left) || eval_bool(*arg.right));
+		}
+
+		virtual void apply(const BinaryOperator<BinOpType::Conjunction>& arg) override {
+			value = make_bool(eval_bool(*arg.left) && eval_bool(*arg.right));
+		}
+
+		virtual void apply(const BinaryOperator<BinOpType::Modulo>& arg) override {
+			integer_operation(*arg.left, *arg.right, [](Integer a, Integer b) {
+				check_division(a, b);
+				return make_integer(a % b);
+			});
+		}
+
+		virtual void apply(const BinaryOperator<BinOpType::LessThan>& arg) override {
+			integer_operation(*arg.left, *arg.right, [](Integer a, Integer b) {
+				return make_bool(a < b);
+			});
+		}
+
+		virtual void apply(const BinaryOperator<BinOpType::LessEqual>& arg) override {
+			integer_operation(*arg.left, *arg.right, [](Integer a, Integer b) {
+				return make_bool(a <= b);
+			});
+		}
+
+		virtual void apply(const BinaryOperator<BinOpType::GreaterThan>& arg) override {
+			integer_operation(*arg.left, *arg.right, [](Integer a, Integer b) {
+				return make_bool(a > b);
+			});
+		}
+
+		virtual void apply(const BinaryOperator<BinOpType::GreaterEqual>& arg) override {
+			integer_operation(*arg.left, *arg.right, [](Integer a, Integer b) {
+				return make_bool(a >= b);
+			});
+		}
+
+		virtual void apply(const BinaryOperator<BinOpType::Equal>& arg) override {
+			value = make_bool(equal(arg));
+		}
+
+		virtual void apply(const BinaryOperator<BinOpType::NotEqual>& arg) override {
+			value = make_bool(!equal(arg));
+		}
+
+		virtual void apply(const UnaryOperator<UnOpType::IntNegation>& arg) override {
+			value = make_integer(wrap(-(uint64_t) eval_integer(*arg.expr)));
+		}
+
+		virtual void apply(const UnaryOperator<UnOpType::BoolNegation>& arg) override {
+			value = make_bool(!eval_bool(*arg.expr));
+		}
+
+		virtual void apply(const Literal<LiteralType::Bool>& arg) override {
+			value = make_bool(arg.val);
+		}
+
+		virtual void apply(const Literal<LiteralType::Integer>& arg) override {
+			value = make_integer(arg.val);
+		}
+
+		virtual void apply(const Literal<LiteralType::String>& arg) override {
+			value = make_string(std::string(arg.val));
+		}
+
+		virtual void apply(const Variable& arg) override {
+			value = lookup(arg.name);
+		}
+
+		virtual void apply(const StaticFunctionCall& arg) override {
+			std::vector<Constant> args;
+			for(const auto& a : arg.args) {
+				args.push_back(eval(*a));
+			}
+			if(arg.fun == CONCAT_FUN_NAME || arg.fun == CONCAT_N_FUN_NAME) {
+				std::string result;
+				for(const auto& a : args) {
+					result += a.string;
+				}
+				allocate(result.size());
+				value = make_string(std::move(result));
+				return;
+			}
+			auto fun = info.functions.find(arg.fun);
+			if(fun == info.functions.end()) {
+				throw NotConstant();
+			}
+			value = call(*fun->second, std::move(args));
+		}
+
+		virtual void apply(const SubscriptOperator& arg) override {
+			auto array = eval_array(*arg.arr);
+			value = (*array)[eval_index(*arg.index, *array)];
+		}
+
+		virtual void apply(const ClassMember& arg) override {
+			if(arg.member != LENGTH_ATTR_NAME) {
+				throw NotConstant();
+			}
+			value = make_integer(eval_array(*arg.object)->size());
+		}
+
+		virtual void apply(const NewArray& arg) override {
+			Integer size = eval_integer(*arg.size);
+			if(size < 0) {
+				throw NotConstant();
+			}
+			allocate(size);
+			Constant c;
+			c.kind = Constant::Kind::Array;
+			c.array = std::make_shared<std::vector<Constant>>(size, default_value(arg.new_type));
+			value = std::move(c);
+		}
+
+		virtual void apply(const Assignment& arg) override {
+			Constant v = eval(*arg.value);
+			Target t(this);
+			arg.var->visit(&t);
+			t.get() = std::move(v);
+		}
+
+		virtual void apply(const Incrementation& arg) override {
+			step_target(*arg.var, 1);
+		}
+
+		virtual void apply(const Decrementation& arg) override {
+			step_target(*arg.var, -1);
+		}
+
+		virtual void apply(const ExprStatement& arg) override {
+			eval(*arg.expr);
+		}
+
+		virtual void apply(const Return& arg) override {
+			value = arg.val ? eval(*arg.val) : Constant();
+			returned = true;
+		}
+
+		virtual void apply(const If& arg) override {
+			if(eval_bool(*arg.condition)) {
+				execute(*arg.case_then);
+			} else if(arg.case_else) {
+				execute(*arg.case_else);
+			}
+		}
+
+		virtual void apply(const While& arg) override {
+			while(!returned && eval_bool(*arg.condition)) {
+				execute(*arg.action);
+			}
+		}
+
+		virtual void apply(const For& arg) override {
+			auto array = eval_array(*arg.array);
+			for(size_t i = 0; i < array->size() && !returned; ++i) {
+				scopes.emplace_back();
+				scopes.back()[arg.var_name] = (*array)[i];
+				execute(*arg.action);
+				scopes.pop_back();
+			}
+		}
+
+		virtual void apply(const Block& arg) override {
+			scopes.emplace_back();
+			for(size_t i = 0; i < arg.statements.size() && !returned; ++i) {
+				execute(*arg.statements[i]);
+			}
+			scopes.pop_back();
+		}
+
+		virtual void apply(const Empty& arg) override {
+			(void) arg;
+		}
+
+		virtual void apply(const Definition& arg) override {
+			for(const auto& def : arg.defs) {
+				Constant v = def.second ? eval(*def.second) : default_value(arg.type);
+				scopes.back()[def.first] = std::move(v);
+			}
+		}
+
+		//returns false if the call has to be left for the run time
+		bool evaluate(const FunctionInfo& fun, std::vector<Constant>&& args, Constant& result) {
+			try {
+				result = call(fun, std::move(args));
+				return true;
+			} catch (const NotConstant&) {
+				return false;
+			}
+		}
+
+		Evaluator() = delete;
+		Evaluator(const TypeInfo& info, std::map<std::string, Constant>& memo) : info(info), memo(memo), returned(false), steps(0), depth(0), allocated(0) {}
+	};
+
+	//names of the array variables which are used other than by reading their elements and length or iterating over them
+	struct ArrayUses : public RecursiveVisitor {
+		std::set<std::string> escaping;
+
+		void note_write(Expression& target) {
+			SubscriptOperator* s = get_node<SubscriptOperator>(target);
+			Variable* var = s ? get_node<Variable>(*s->arr) : nullptr;
+			if(var) {
+				escaping.insert(var->name);
+			}
+		}
+
+		void visit_target(std::unique_ptr<Expression>& target) {
+			note_write(*target);
+			if(!get_node<Variable>(*target)) {
+				visit_child(target);
+			}
+		}
+
+		virtual void apply(Variable& arg) {
+			escaping.insert(arg.name);
+		}
+
+		virtual void apply(SubscriptOperator& arg) {
+			if(!get_node<Variable>(*arg.arr)) {
+				visit_child(arg.arr);
+			}
+			visit_child(arg.index);
+		}
+
+		virtual void apply(ClassMember& arg) {
+			if(!is_array(arg.object->type) || !get_node<Variable>(*arg.object)) {
+				visit_child(arg.object);
+			}
+		}
+
+		virtual void apply(For& arg) {
+			if(!get_node<Variable>(*arg.array)) {
+				visit_child(arg.array);
+			}
+			visit_child(arg.action);
+		}
+
+		virtual void apply(Assignment& arg) {
+			visit_target(arg.var);
+			visit_child(arg.value);
+		}
+
+		virtual void apply(Incrementation& arg) {
+			visit_target(arg.var);
+		}
+
+		virtual void apply(Decrementation& arg) {
+			visit_target(arg.var);
+		}
+	};
+
+	class CallFolder : public RecursiveVisitor {
+		const TypeInfo& info;
+		std::map<std::string, Constant> memo;
+		std::set<std::string> escaping;
+		const Expression* read_only_array; //call which may be replaced by an array in the read-only data
+
+		void visit_read_only(std::unique_ptr<Expression>& child) {
+			read_only_array = child.get();
+			visit_child(child);
+		}
+
+		void visit_target(std::unique_ptr<Expression>& target) {
+			SubscriptOperator* s = get_node<SubscriptOperator>(*target);
+			if(s) {
+				visit_child(s->arr);
+				visit_child(s->index);
+			} else {
+				visit_child(target);
+			}
+		}
+
+		std::shared_ptr<ConstantArray> make_array(const std::vector<Constant>& elements) {
+			auto result = std::make_shared<ConstantArray>();
+			for(const auto& e : elements) {
+				switch(e.kind) {
+				case Constant::Kind::Integer:
+					result->values.push_back(e.integer);
+					break;
+				case Constant::Kind::Bool:
+					result->values.push_back(e.boolean);
+					break;
+				default:
+					return nullptr;
+				}
+			}
+			return result;
+		}
+
+	public:
+		virtual void apply(StaticFunctionCall& arg) {
+			bool array_allowed = read_only_array == &arg;
+			read_only_array = nullptr;
+			RecursiveVisitor::apply(arg);
+			auto fun = info.functions.find(arg.fun);
+			if(fun == info.functions.end() || fun->second->side_effects) {
+				return;
+			}
+			std::vector<Constant> args(arg.args.size());
+			for(size_t i = 0; i < arg.args.size(); ++i) {
+				if(!get_literal(*arg.args[i], args[i])) {
+					return;
+				}
+			}
+			Constant result;
+			Evaluator e(info, memo);
+			if(!e.evaluate(*fun->second, std::move(args), result)) {
+				return;
+			}
+			switch(result.kind) {
+			case Constant::Kind::Integer:
+				optimized_expression = std::make_unique<Literal<LiteralType::Integer>>(arg.begin, arg.end, std::move(result.integer));
+				break;
+			case Constant::Kind::Bool:
+				optimized_expression = std::make_unique<Literal<LiteralType::Bool>>(arg.begin, arg.end, std::move(result.boolean));
+				break;
+			case Constant::Kind::String:
+				//a new string at run time, the literal would be equal to the other ones with the same characters
+				break;
+			case Constant::Kind::Array:
+				if(array_allowed && result.array->size() <= RESULT_SIZE_LIMIT) {
+					arg.constant = make_array(*result.array);
+				}
+				break;
+			}
+			if(optimized_expression) {
+				optimized_expression->type = arg.type;
+			}
+		}
+
+		virtual void apply(SubscriptOperator& arg) {
+			visit_read_only(arg.arr);
+			visit_child(arg.index);
+		}
+
+		virtual void apply(ClassMember& arg) {
+			if(is_array(arg.object->type)) {
+				visit_read_only(arg.object);
+			} else {
+				visit_child(arg.object);
+			}
+		}
+
+		virtual void apply(For& arg) {
+			visit_read_only(arg.array);
+			visit_child(arg.action);
+		}
+
+		virtual void apply(Definition& arg) {
+			for(auto& def : arg.defs) {
+				if(!def.second) {
+					continue;
+				}
+				if(is_array(arg.type) && !escaping.count(def.first)) {
+					visit_read_only(def.second);
+				} else {
+					visit_child(def.second);
+				}
+			}
+		}
+
+		virtual void apply(Assignment& arg) {
+			Variable* var = get_node<Variable>(*arg.var);
+			if(var && is_array(var->type) && !escaping.count(var->name)) {
+				visit_read_only(arg.value);
+			} else {
+				visit_child(arg.value);
+			}
+			visit_target(arg.var);
+		}
+
+		virtual void apply(Incrementation& arg) {
+			visit_target(arg.var);
+		}
+
+		virtual void apply(Decrementation& arg) {
+			visit_target(arg.var);
+		}
+
+		void fold(const FunctionInfo& fun) {
+			ArrayUses uses;
+			fun.data->body->visit(&uses);
+			escaping = std::move(uses.escaping);
+			read_only_array = nullptr;
+			fun.data->body->visit(this);
+		}
+
+		CallFolder() = delete;
+		CallFolder(const TypeInfo& info) : info(info), read_only_array(nullptr) {}
+	};
+}
+
+namespace Optimizer {
+	void evaluate_pure_calls(const TypeInfo& info) {
+		CallFolder f(info);
+		for(const auto& fun : info.functions) {
+			f.fold(*fun.second);
+		}
+		for(const auto& cl : info.classes) {
+			for(const auto& fun : cl.second->functions) {
+				if(fun->class_info == cl.second.get()) {
+					f.fold(*fun);
+				}
+			}
+		}
+	}
+}
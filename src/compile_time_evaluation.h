@@ -0,0 +1,21 @@
+#ifndef COMPILE_TIME_EVALUATION_H
+#define COMPILE_TIME_EVALUATION_H
+
+#include "program_tree.h"
+#include "type_info_builder.h"
+
+#include <vector>
+
+namespace ProgramTree {
+	//int or boolean array returned by a call evaluated at compile time, emitted as read-only data
+	struct ConstantArray {
+		std::vector<Integer> values;
+	};
+}
+
+namespace Optimizer {
+	//calls of functions without side effects with literal arguments are replaced by their int or boolean results, strings are compared by address, so a literal can't stand for a new one
+	void evaluate_pure_calls(const TypeChecker::TypeInfo& info);
+}
+
+#endif
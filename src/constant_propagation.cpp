@@ -0,0 +1,567 @@
+#include "constant_propagation.h"
+#include "helper_visitors.h"
+
+#include <limits>
+#include <map>
+#include <vector>
+
+using namespace ProgramTree;
+using namespace TypeChecker;
+
+namespace {
+	//declaration of a local variable, a function argument or a loop variable
+	using VariableId = const void*;
+
+	struct Value {
+		enum class Kind {
+			Overdefined, Integer, Bool, Copy
+		};
+
+		Kind kind;
+		literal_type<LiteralType::Integer>::type integer;
+		literal_type<LiteralType::Bool>::type boolean;
+		VariableId source; //the variable holds the current value of 'source'
+
+		bool is_constant() const {
+			return kind == Kind::Integer || kind == Kind::Bool;
+		}
+
+		bool operator==(const Value& other) const {
+			if(kind != other.kind) {
+				return false;
+			}
+			switch(kind) {
+			case Kind::Integer:
+				return integer == other.integer;
+			case Kind::Bool:
+				return boolean == other.boolean;
+			case Kind::Copy:
+				return source == other.source;
+			default:
+				return true;
+			}
+		}
+
+		Value() : kind(Kind::Overdefined), integer(0), boolean(false), source(nullptr) {}
+	};
+
+	Value make_integer(Integer integer) {
+		Value v;
+		v.kind = Value::Kind::Integer;
+		v.integer = integer;
+		return v;
+	}
+
+	Value make_bool(bool boolean) {
+		Value v;
+		v.kind = Value::Kind::Bool;
+		v.boolean = boolean;
+		return v;
+	}
+
+	Value make_copy(VariableId source) {
+		Value v;
+		v.kind = Value::Kind::Copy;
+		v.source = source;
+		return v;
+	}
+
+	bool is_bool(const Value& v, bool boolean) {
+		return v.kind == Value::Kind::Bool && v.boolean == boolean;
+	}
+
+	bool both_integers(const Value& l, const Value& r) {
+		return l.kind == Value::Kind::Integer && r.kind == Value::Kind::Integer;
+	}
+
+	//arithmetic wraps around like the generated code does
+	Integer wrap(uint64_t val) {
+		return (Integer) val;
+	}
+
+	//copies are only propagated between variables of the same type
+	Value converted(const Value& v, Type from, Type to) {
+		return v.kind == Value::Kind::Copy && from != to ? Value() : v;
+	}
+
+	//values of the variables at some point of the function, overdefined ones aren't stored
+	struct State {
+		bool reachable;
+		std::map<VariableId, Value> values;
+
+		Value get(VariableId id) const {
+			auto it = values.find(id);
+			return it == values.end() ? Value() : it->second;
+		}
+
+		//copies of the variable become overdefined
+		void kill(VariableId id) {
+			for(auto it = values.begin(); it != values.end();) {
+				if(it->second.kind == Value::Kind::Copy && it->second.source == id) {
+					it = values.erase(it);
+				} else {
+					++it;
+				}
+			}
+		}
+
+		void set(VariableId id, const Value& v) {
+			if(v.kind == Value::Kind::Copy && v.source == id) {
+				return;
+			}
+			kill(id);
+			if(v.kind == Value::Kind::Overdefined) {
+				values.erase(id);
+			} else {
+				values[id] = v;
+			}
+		}
+
+		bool operator==(const State& other) const {
+			return reachable == other.reachable && values == other.values;
+		}
+
+		State() : reachable(true) {}
+	};
+
+	State meet(const State& a, const State& b) {
+		if(!a.reachable) {
+			return b;
+		}
+		if(!b.reachable) {
+			return a;
+		}
+		State result;
+		for(const auto& v : a.values) {
+			auto it = b.values.find(v.first);
+			if(it != b.values.end() && it->second == v.second) {
+				result.values.insert(v);
+			}
+		}
+		return result;
+	}
+
+	class ConstantPropagator : public RecursiveVisitor {
+		State state;
+		Value value; //of the last visited expression
+		bool rewrite; //false while a loop is analysed until its fixed point, the tree is changed only afterwards
+		std::vector<std::map<std::string, VariableId>> scopes;
+		std::map<VariableId, const std::string*> names;
+
+		VariableId lookup(const std::string& name) const {
+			for(auto it = scopes.rbegin(); it != scopes.rend(); ++it) {
+				auto var = it->find(name);
+				if(var != it->end()) {
+					return var->second;
+				}
+			}
+			return nullptr;
+		}
+
+		void declare(VariableId id, const std::string& name, const Value& v) {
+			scopes.back()[name] = id;
+			names[id] = &name;
+			state.set(id, v);
+		}
+
+		void leave_scope() {
+			for(const auto& var : scopes.back()) {
+				state.set(var.second, Value());
+			}
+			scopes.pop_back();
+		}
+
+		void replace_with_literal(const Expression& arg) {
+			if(!rewrite) {
+				return;
+			}
+			if(value.kind == Value::Kind::Integer) {
+				optimized_expression = std::make_unique<Literal<LiteralType::Integer>>(arg.begin, arg.end, literal_type<LiteralType::Integer>::type(value.integer));
+				optimized_expression->type = INT_NAME;
+			} else if(value.kind == Value::Kind::Bool) {
+				optimized_expression = std::make_unique<Literal<LiteralType::Bool>>(arg.begin, arg.end, literal_type<LiteralType::Bool>::type(value.boolean));
+				optimized_expression->type = BOOL_NAME;
+			}
+		}
+
+		template<BinOpType T, typename F>
+		void fold(BinaryOperator<T>& arg, F operation) {
+			visit_child(arg.left);
+			Value left = value;
+			visit_child(arg.right);
+			value = operation(left, value);
+			replace_with_literal(arg);
+		}
+
+		//false && x is false and true && x is x, the same goes for the alternative with true
+		template<BinOpType T>
+		void short_circuit(BinaryOperator<T>& arg, bool absorbing) {
+			visit_child(arg.left);
+			Value left = value;
+			visit_child(arg.right);
+			if(left.kind != Value::Kind::Bool) {
+				value = Value();
+			} else if(left.boolean == absorbing) {
+				value = make_bool(absorbing);
+				replace_with_literal(arg);
+			} else if(rewrite) {
+				optimized_expression = std::move(arg.right);
+			}
+		}
+
+		//inc/dec and assignment change the state only when they write to a local variable
+		VariableId get_target(std::unique_ptr<Expression>& target) {
+			Variable* var = get_node<Variable>(*target);
+			if(!var) {
+				visit_child(target);
+				return nullptr;
+			}
+			return lookup(var->name);
+		}
+
+		void step(std::unique_ptr<Expression>& target, uint64_t delta) {
+			VariableId id = get_target(target);
+			if(id) {
+				Value v = state.get(id);
+				state.set(id, v.kind == Value::Kind::Integer ? make_integer(wrap(v.integer + delta)) : Value());
+			}
+		}
+
+		//runs the analysis of the loop until the state at its beginning stops changing, returns that state
+		template<typename F>
+		State loop_head(F iteration) {
+			bool rewriting = rewrite;
+			rewrite = false;
+			State head = state;
+			while(true) {
+				state = head;
+				iteration();
+				State next = meet(head, state);
+				if(next == head) {
+					break;
+				}
+				head = std::move(next);
+			}
+			rewrite = rewriting;
+			return head;
+		}
+
+	public:
+		virtual void apply(BinaryOperator<BinOpType::Addition>& arg) {
+			fold(arg, [](const Value& l, const Value& r) {
+				return both_integers(l, r) ? make_integer(wrap((uint64_t) l.integer + (uint64_t) r.integer)) : Value();
+			});
+		}
+
+		virtual void apply(BinaryOperator<BinOpType::Multiplication>& arg) {
+			fold(arg, [](const Value& l, const Value& r) {
+				return both_integers(l, r) ? make_integer(wrap((uint64_t) l.integer * (uint64_t) r.integer)) : Value();
+			});
+		}
+
+		virtual void apply(BinaryOperator<BinOpType::Division>& arg) {
+			fold(arg, [](const Value& l, const Value& r) {
+				if(!both_integers(l, r) || r.integer == 0 || (r.integer == -1 && l.integer == std::numeric_limits<Integer>::min())) {
+					return Value();
+				}
+				return make_integer(l.integer / r.integer);
+			});
+		}
+
+		virtual void apply(BinaryOperator<BinOpType::Substraction>& arg) {
+			fold(arg, [](const Value& l, const Value& r) {
+				return both_integers(l, r) ? make_integer(wrap((uint64_t) l.integer - (uint64_t) r.integer)) : Value();
+			});
+		}
+
+		virtual void apply(BinaryOperator<BinOpType::Alternative>& arg) {
+			short_circuit(arg, true);
+		}
+
+		virtual void apply(BinaryOperator<BinOpType::Conjunction>& arg) {
+			short_circuit(arg, false);
+		}
+
+		virtual void apply(BinaryOperator<BinOpType::Modulo>& arg) {
+			fold(arg, [](const Value& l, const Value& r) {
+				if(!both_integers(l, r) || r.integer == 0 || (r.integer == -1 && l.integer == std::numeric_limits<Integer>::min())) {
+					return Value();
+				}
+				return make_integer(l.integer % r.integer);
+			});
+		}
+
+		virtual void apply(BinaryOperator<BinOpType::LessThan>& arg) {
+			fold(arg, [](const Value& l, const Value& r) {
+				return both_integers(l, r) ? make_bool(l.integer < r.integer) : Value();
+			});
+		}
+
+		virtual void apply(BinaryOperator<BinOpType::LessEqual>& arg) {
+			fold(arg, [](const Value& l, const Value& r) {
+				return both_integers(l, r) ? make_bool(l.integer <= r.integer) : Value();
+			});
+		}
+
+		virtual void apply(BinaryOperator<BinOpType::GreaterThan>& arg) {
+			fold(arg, [](const Value& l, const Value& r) {
+				return both_integers(l, r) ? make_bool(l.integer > r.integer) : Value();
+			});
+		}
+
+		virtual void apply(BinaryOperator<BinOpType::GreaterEqual>& arg) {
+			fold(arg, [](const Value& l, const Value& r) {
+				return both_integers(l, r) ? make_bool(l.integer >= r.integer) : Value();
+			});
+		}
+
+		virtual void apply(BinaryOperator<BinOpType::Equal>& arg) {
+			fold(arg, [](const Value& l, const Value& r) {
+				return l.is_constant() && l.kind == r.kind ? make_bool(l == r) : Value();
+			});
+		}
+
+		virtual void apply(BinaryOperator<BinOpType::NotEqual>& arg) {
+			fold(arg, [](const Value& l, const Value& r) {
+				return l.is_constant() && l.kind == r.kind ? make_bool(!(l == r)) : Value();
+			});
+		}
+
+		virtual void apply(UnaryOperator<UnOpType::IntNegation>& arg) {
+			visit_child(arg.expr);
+			value = value.kind == Value::Kind::Integer ? make_integer(wrap(-(uint64_t) value.integer)) : Value();
+			replace_with_literal(arg);
+		}
+
+		virtual void apply(UnaryOperator<UnOpType::BoolNegation>& arg) {
+			visit_child(arg.expr);
+			value = value.kind == Value::Kind::Bool ? make_bool(!value.boolean) : Value();
+			replace_with_literal(arg);
+		}
+
+		virtual void apply(Literal<LiteralType::Bool>& arg) {
+			value = make_bool(arg.val);
+		}
+
+		virtual void apply(Literal<LiteralType::Integer>& arg) {
+			value = make_integer(arg.val);
+		}
+
+		virtual void apply(Literal<LiteralType::String>& arg) {
+			(void) arg;
+			value = Value();
+		}
+
+		virtual void apply(Variable& arg) {
+			VariableId id = lookup(arg.name);
+			if(!id) {
+				value = Value();
+				return;
+			}
+			value = state.get(id);
+			if(value.is_constant()) {
+				replace_with_literal(arg);
+			} else if(value.kind == Value::Kind::Copy && lookup(*names.at(value.source)) == value.source) {
+				if(rewrite) {
+					optimized_expression = std::make_unique<Variable>(arg.begin, arg.end, std::string(*names.at(value.source)));
+					optimized_expression->type = arg.type;
+				}
+			} else {
+				value = make_copy(id);
+			}
+		}
+
+		virtual void apply(Null& arg) {
+			(void) arg;
+			value = Value();
+		}
+
+		virtual void apply(CallOperator& arg) {
+			RecursiveVisitor::apply(arg);
+			value = Value();
+		}
+
+		virtual void apply(StaticFunctionCall& arg) {
+			RecursiveVisitor::apply(arg);
+			value = Value();
+		}
+
+		virtual void apply(VirtualFunctionCall& arg) {
+			RecursiveVisitor::apply(arg);
+			value = Value();
+		}
+
+		virtual void apply(SubscriptOperator& arg) {
+			RecursiveVisitor::apply(arg);
+			value = Value();
+		}
+
+		virtual void apply(ClassMember& arg) {
+			RecursiveVisitor::apply(arg);
+			value = Value();
+		}
+
+		virtual void apply(Cast& arg) {
+			RecursiveVisitor::apply(arg);
+			value = Value();
+		}
+
+		virtual void apply(NewObject& arg) {
+			(void) arg;
+			value = Value();
+		}
+
+		virtual void apply(NewArray& arg) {
+			RecursiveVisitor::apply(arg);
+			value = Value();
+		}
+
+		virtual void apply(Assignment& arg) {
+			visit_child(arg.value);
+			Value assigned = converted(value, arg.value->type, arg.var->type);
+			VariableId id = get_target(arg.var);
+			if(id) {
+				state.set(id, assigned);
+			}
+		}
+
+		virtual void apply(Incrementation& arg) {
+			step(arg.var, 1);
+		}
+
+		virtual void apply(Decrementation& arg) {
+			step(arg.var, -1);
+		}
+
+		virtual void apply(ExprStatement& arg) {
+			visit_child(arg.expr);
+			StaticFunctionCall* call = get_node<StaticFunctionCall>(*arg.expr);
+			if(call && call->fun == "error") {
+				state.reachable = false;
+			}
+		}
+
+		virtual void apply(Return& arg) {
+			RecursiveVisitor::apply(arg);
+			state.reachable = false;
+		}
+
+		virtual void apply(If& arg) {
+			visit_child(arg.condition);
+			if(value.kind == Value::Kind::Bool) {
+				std::unique_ptr<Statement>& taken = value.boolean ? arg.case_then : arg.case_else;
+				if(taken) {
+					visit_child(taken);
+				}
+				if(!rewrite) {
+					return;
+				}
+				if(taken) {
+					optimized_statement = std::move(taken);
+				} else {
+					optimized_statement = std::make_unique<Empty>(arg.begin, arg.end);
+				}
+				return;
+			}
+			State entry = state;
+			visit_child(arg.case_then);
+			std::swap(state, entry);
+			if(arg.case_else) {
+				visit_child(arg.case_else);
+			}
+			state = meet(entry, state);
+		}
+
+		virtual void apply(While& arg) {
+			State head = loop_head([this, &arg]() {
+				visit_child(arg.condition);
+				if(!is_bool(value, false)) {
+					visit_child(arg.action);
+				}
+			});
+			state = head;
+			visit_child(arg.condition);
+			Value condition = value;
+			if(is_bool(condition, false)) {
+				if(rewrite) {
+					optimized_statement = std::make_unique<Empty>(arg.begin, arg.end);
+				}
+				return;
+			}
+			visit_child(arg.action);
+			state = head;
+			state.reachable = !is_bool(condition, true);
+		}
+
+		virtual void apply(For& arg) {
+			visit_child(arg.array);
+			scopes.emplace_back();
+			State head = loop_head([this, &arg]() {
+				declare(&arg, arg.var_name, Value());
+				visit_child(arg.action);
+			});
+			state = head;
+			declare(&arg, arg.var_name, Value());
+			visit_child(arg.action);
+			state = head;
+			leave_scope();
+		}
+
+		virtual void apply(Block& arg) {
+			scopes.emplace_back();
+			size_t reachable = 0;
+			while(reachable < arg.statements.size() && state.reachable) {
+				visit_child(arg.statements[reachable++]);
+			}
+			if(rewrite) {
+				arg.statements.erase(arg.statements.begin() + reachable, arg.statements.end());
+			}
+			leave_scope();
+		}
+
+		virtual void apply(Definition& arg) {
+			for(auto& def : arg.defs) {
+				Value v;
+				if(def.second) {
+					visit_child(def.second);
+					v = converted(value, def.second->type, arg.type);
+				} else if(arg.type == INT_TYPE) {
+					v = make_integer(0);
+				} else if(arg.type == BOOL_TYPE) {
+					v = make_bool(false);
+				}
+				declare(&def, def.first, v);
+			}
+		}
+
+		void propagate(const FunctionInfo& fun) {
+			state = State();
+			rewrite = true;
+			scopes.clear();
+			names.clear();
+			scopes.emplace_back();
+			for(const auto& a : fun.args) {
+				declare(&a, a.second, Value());
+			}
+			fun.data->body->visit(this);
+		}
+
+		ConstantPropagator() : rewrite(true) {}
+	};
+}
+
+namespace Optimizer {
+	void propagate_constants(const TypeInfo& info) {
+		ConstantPropagator p;
+		for(const auto& fun : info.functions) {
+			p.propagate(*fun.second);
+		}
+		for(const auto& cl : info.classes) {
+			for(const auto& fun : cl.second->functions) {
+				if(fun->class_info == cl.second.get()) {
+					p.propagate(*fun);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,11 @@
+#ifndef CONSTANT_PROPAGATION_H
+#define CONSTANT_PROPAGATION_H
+
+#include "type_info_builder.h"
+
+namespace Optimizer {
+	//propagates constants and copies of local variables along the control flow, folds the branches they decide and removes unreachable code
+	void propagate_constants(const TypeChecker::TypeInfo& info);
+}
+
+#endif
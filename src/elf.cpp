@@ -0,0 +1,97 @@
+#include "elf.h"
+
+#include <stdexcept>
+
+namespace Elf {
+	size_t Buffer::size() const {
+		return bytes.size();
+	}
+
+	void Buffer::word(uint64_t value, size_t size) {
+		for(size_t i = 0; i < size; ++i) {
+			bytes.push_back(i < 8 ? (value >> (8 * i)) & 0xff : 0);
+		}
+	}
+
+	void Buffer::append(const std::vector<uint8_t>& data) {
+		bytes.insert(bytes.end(), data.begin(), data.end());
+	}
+
+	void Buffer::align(size_t alignment) {
+		while(bytes.size() % alignment) {
+			bytes.push_back(0);
+		}
+	}
+
+	void Buffer::patch(size_t offset, uint64_t value, size_t size) {
+		for(size_t i = 0; i < size; ++i) {
+			bytes[offset + i] = (value >> (8 * i)) & 0xff;
+		}
+	}
+
+	void Buffer::write(std::ostream& output) const {
+		output.write((const char*) bytes.data(), bytes.size());
+	}
+
+	StringTable::StringTable() : bytes(1, 0) {}
+
+	size_t StringTable::add(const std::string& s) {
+		size_t result = bytes.size();
+		bytes.insert(bytes.end(), s.begin(), s.end());
+		bytes.push_back(0);
+		return result;
+	}
+
+	void write_section_header(Buffer& file, const SectionHeader& header) {
+		file.word(header.name, 4);
+		file.word(header.type, 4);
+		file.word(header.flags, 8);
+		file.word(header.address, 8);
+		file.word(header.offset, 8);
+		file.word(header.size, 8);
+		file.word(header.link, 4);
+		file.word(header.info, 4);
+		file.word(header.alignment, 8);
+		file.word(header.entry_size, 8);
+	}
+
+	void write_symbol(Buffer& file, size_t name, uint8_t info, uint16_t section, uint64_t value) {
+		file.word(name, 4);
+		file.word(info, 1);
+		file.word(0, 1);
+		file.word(section, 2);
+		file.word(value, 8);
+		file.word(0, 8);
+	}
+
+	void write_header(Buffer& file, uint16_t type, uint64_t entry, size_t program_headers, size_t section_headers_offset, size_t section_headers) {
+		//magic, 64-bit, little endian, version 1, System V ABI
+		file.patch(0, 0x00010102464c457full, 8);
+		file.patch(8, 0, 8);
+		file.patch(16, type, 2);
+		file.patch(18, EM_X86_64, 2);
+		file.patch(20, 1, 4);
+		file.patch(24, entry, 8);
+		file.patch(32, program_headers ? HEADER_SIZE : 0, 8);
+		file.patch(40, section_headers_offset, 8);
+		file.patch(48, 0, 4);
+		file.patch(52, HEADER_SIZE, 2);
+		file.patch(54, program_headers ? PROGRAM_HEADER_SIZE : 0, 2);
+		file.patch(56, program_headers, 2);
+		file.patch(58, SECTION_HEADER_SIZE, 2);
+		file.patch(60, section_headers, 2);
+		//the section names are always the last section
+		file.patch(62, section_headers - 1, 2);
+	}
+
+	uint64_t read(const std::string& file, size_t offset, size_t size) {
+		if(offset > file.size() || file.size() - offset < size) {
+			throw std::runtime_error("Truncated ELF file.");
+		}
+		uint64_t result = 0;
+		for(size_t i = size; i > 0; --i) {
+			result = (result << 8) | (unsigned char) file[offset + i - 1];
+		}
+		return result;
+	}
+}
@@ -0,0 +1,98 @@
+#ifndef ELF_H
+#define ELF_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace Elf {
+	const uint16_t ET_REL = 1;
+	const uint16_t ET_EXEC = 2;
+	const uint16_t EM_X86_64 = 62;
+
+	const uint32_t R_X86_64_64 = 1;
+	const uint32_t R_X86_64_PC32 = 2;
+	const uint32_t R_X86_64_PLT32 = 4;
+	const uint32_t R_X86_64_32 = 10;
+	const uint32_t R_X86_64_32S = 11;
+
+	const uint32_t SHT_PROGBITS = 1;
+	const uint32_t SHT_SYMTAB = 2;
+	const uint32_t SHT_STRTAB = 3;
+	const uint32_t SHT_RELA = 4;
+	const uint32_t SHT_NOBITS = 8;
+
+	const uint64_t SHF_WRITE = 1;
+	const uint64_t SHF_ALLOC = 2;
+	const uint64_t SHF_EXECINSTR = 4;
+	const uint64_t SHF_INFO_LINK = 0x40;
+
+	const uint16_t SHN_UNDEF = 0;
+	const uint16_t SHN_ABS = 0xfff1;
+
+	const uint8_t STB_LOCAL = 0;
+	const uint8_t STB_GLOBAL = 1;
+	const uint8_t STB_WEAK = 2;
+	const uint8_t STT_SECTION = 3;
+	const uint8_t STT_FILE = 4;
+
+	const uint32_t PT_LOAD = 1;
+	const uint32_t PT_GNU_STACK = 0x6474e551;
+	const uint32_t PF_X = 1;
+	const uint32_t PF_W = 2;
+	const uint32_t PF_R = 4;
+
+	const size_t HEADER_SIZE = 64;
+	const size_t SECTION_HEADER_SIZE = 64;
+	const size_t PROGRAM_HEADER_SIZE = 56;
+	const size_t SYMBOL_SIZE = 24;
+	const size_t RELOCATION_SIZE = 24;
+
+	//little-endian contents of a file being written
+	class Buffer {
+	public:
+		std::vector<uint8_t> bytes;
+
+		size_t size() const;
+		void word(uint64_t value, size_t size);
+		void append(const std::vector<uint8_t>& data);
+		void align(size_t alignment);
+		void patch(size_t offset, uint64_t value, size_t size);
+		void write(std::ostream& output) const;
+	};
+
+	class StringTable {
+	public:
+		std::vector<uint8_t> bytes;
+
+		size_t add(const std::string& s);
+
+		StringTable();
+	};
+
+	struct SectionHeader {
+		size_t name;
+		uint32_t type;
+		uint64_t flags;
+		uint64_t address;
+		size_t offset;
+		size_t size;
+		uint32_t link;
+		uint32_t info;
+		size_t alignment;
+		size_t entry_size;
+	};
+
+	void write_section_header(Buffer& file, const SectionHeader& header);
+
+	void write_symbol(Buffer& file, size_t name, uint8_t info, uint16_t section, uint64_t value);
+
+	//fills the first HEADER_SIZE bytes of the file, the program headers have to follow them
+	void write_header(Buffer& file, uint16_t type, uint64_t entry, size_t program_headers, size_t section_headers_offset, size_t section_headers);
+
+	//the little-endian number at the offset, throws if the file is too short
+	uint64_t read(const std::string& file, size_t offset, size_t size);
+}
+
+#endif
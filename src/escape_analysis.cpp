@@ -0,0 +1,417 @@
+#include "escape_analysis.h"
+#include "helper_visitors.h"
+
+#include <map>
+#include <stack>
+#include <vector>
+
+using namespace ProgramTree;
+using namespace TypeChecker;
+using Optimizer::EscapeSummary;
+
+namespace {
+	//larger arrays are still allocated on the heap, so that the stack doesn't grow with a constant in the source
+	const Integer STACK_ARRAY_MAX_SIZE = 16;
+
+	struct Binding {
+		bool escapes;
+		bool fields_only; //every use is a member access, so the object can be replaced by its fields
+		Binding() : escapes(false), fields_only(true) {}
+	};
+
+	//finds allocations which may be moved to the stack: objects and arrays of a small constant size
+	struct AllocationGetter : public DefaultVisitor {
+		virtual void default_action() {
+		}
+
+		virtual void apply(NewObject& arg) {
+			dest = &arg;
+		}
+
+		virtual void apply(NewArray& arg) {
+			const literal_type<LiteralType::Integer>::type* size = nullptr;
+			LiteralGetter<LiteralType::Integer> lg(size);
+			arg.size->visit(&lg);
+			if(size && *size >= 0 && *size <= STACK_ARRAY_MAX_SIZE) {
+				dest = &arg;
+			}
+		}
+
+		AllocationGetter() = delete;
+		AllocationGetter(Expression*& dest) : dest(dest) {}
+	private:
+		Expression*& dest;
+	};
+
+	//all the functions a virtual call on an object of the given static type may end up in
+	std::vector<const FunctionInfo*> virtual_call_targets(const TypeInfo& info, const std::string& cl, const std::string& fun) {
+		const ClassInfo* base = info.classes.at(cl).get();
+		size_t id = base->function_name_to_id.at(fun);
+		std::vector<const FunctionInfo*> result;
+		for(const auto& c : info.classes) {
+			for(InheritanceTreeNode* node = c.second->inheritance_tree_node; node; node = node->parent) {
+				if(node->class_info == base) {
+					result.push_back(c.second->functions[id].get());
+					break;
+				}
+			}
+		}
+		return result;
+	}
+
+	class EscapeVisitor : public RecursiveVisitor {
+		const TypeInfo& info;
+		const EscapeSummary& summary;
+		std::map<std::string, std::stack<Binding*>> variables; //null for variables which are not tracked
+		std::stack<std::vector<std::string>> block_declarations;
+
+		void declare(const std::string& name, Binding* binding) {
+			variables[name].push(binding);
+			block_declarations.top().push_back(name);
+		}
+
+		void remove_last_variable_block() {
+			for(const std::string& name : block_declarations.top()) {
+				auto st = variables.find(name);
+				st->second.pop();
+				if(st->second.empty()) {
+					variables.erase(st);
+				}
+			}
+			block_declarations.pop();
+		}
+
+		Binding* tracked(const std::unique_ptr<Expression>& e) {
+			const Variable* var = get_node<Variable>(*e);
+			if(!var) {
+				return nullptr;
+			}
+			auto st = variables.find(var->name);
+			if(st == variables.end()) {
+				return nullptr;
+			}
+			return st->second.top();
+		}
+
+		void pass_argument(std::unique_ptr<Expression>& arg, bool escapes) {
+			Binding* b = tracked(arg);
+			if(!b) {
+				visit_child(arg);
+				return;
+			}
+			b->fields_only = false;
+			b->escapes = b->escapes || escapes;
+		}
+
+		void compare(std::unique_ptr<Expression>& l, std::unique_ptr<Expression>& r) {
+			pass_argument(l, false);
+			pass_argument(r, false);
+		}
+
+	public:
+		std::vector<Binding> arguments;
+		std::map<Expression*, Binding> allocations;
+
+		virtual void apply(Variable& arg) {
+			//every use not recognized by the parent node lets the object escape
+			auto st = variables.find(arg.name);
+			if(st != variables.end() && st->second.top()) {
+				st->second.top()->escapes = true;
+			}
+		}
+
+		virtual void apply(ClassMember& arg) {
+			if(tracked(arg.object)) {
+				return;
+			}
+			visit_child(arg.object);
+		}
+
+		virtual void apply(SubscriptOperator& arg) {
+			pass_argument(arg.arr, false);
+			visit_child(arg.index);
+		}
+
+		virtual void apply(BinaryOperator<BinOpType::Equal>& arg) {
+			compare(arg.left, arg.right);
+		}
+
+		virtual void apply(BinaryOperator<BinOpType::NotEqual>& arg) {
+			compare(arg.left, arg.right);
+		}
+
+		virtual void apply(StaticFunctionCall& arg) {
+			auto f = info.functions.find(arg.fun);
+			for(size_t i = 0; i < arg.args.size(); ++i) {
+				//builtins don't keep their arguments
+				pass_argument(arg.args[i], f != info.functions.end() && summary.at(f->second->data.get())[i]);
+			}
+		}
+
+		virtual void apply(VirtualFunctionCall& arg) {
+			std::vector<const FunctionInfo*> targets = virtual_call_targets(info, arg.object->type, arg.fun);
+			auto escapes = [&](size_t id) {
+				for(const FunctionInfo* f : targets) {
+					if(summary.at(f->data.get())[id]) {
+						return true;
+					}
+				}
+				return false;
+			};
+			pass_argument(arg.object, escapes(arg.args.size()));
+			for(size_t i = 0; i < arg.args.size(); ++i) {
+				pass_argument(arg.args[i], escapes(i));
+			}
+		}
+
+		virtual void apply(Assignment& arg) {
+			Binding* b = tracked(arg.var);
+			if(b) {
+				b->escapes = true;
+			} else {
+				visit_child(arg.var);
+			}
+			visit_child(arg.value);
+		}
+
+		virtual void apply(For& arg) {
+			pass_argument(arg.array, false);
+			block_declarations.emplace();
+			declare(arg.var_name, nullptr);
+			visit_child(arg.action);
+			remove_last_variable_block();
+		}
+
+		virtual void apply(Block& arg) {
+			block_declarations.emplace();
+			RecursiveVisitor::apply(arg);
+			remove_last_variable_block();
+		}
+
+		virtual void apply(Definition& arg) {
+			for(auto& def : arg.defs) {
+				Binding* b = nullptr;
+				if(def.second) {
+					visit_child(def.second);
+					Expression* allocation = nullptr;
+					AllocationGetter ag(allocation);
+					def.second->visit(&ag);
+					if(allocation) {
+						b = &allocations[allocation];
+					}
+				}
+				declare(def.first, b);
+			}
+		}
+
+		EscapeVisitor() = delete;
+		EscapeVisitor(const TypeInfo& info, const EscapeSummary& summary) : info(info), summary(summary) {}
+		void analyse(const FunctionInfo& fun, const std::string* class_name) {
+			arguments.assign(fun.args.size() + (class_name ? 1 : 0), Binding());
+			allocations.clear();
+			block_declarations.emplace();
+			for(size_t i = 0; i < fun.args.size(); ++i) {
+				declare(fun.args[i].second, &arguments[i]);
+			}
+			if(class_name) {
+				declare(THIS_NAME, &arguments.back());
+			}
+			fun.data->body->visit(this);
+			remove_last_variable_block();
+		}
+	};
+
+	//replaces the objects that are only used through their fields with a local variable per field
+	class ScalarReplacer : public RecursiveVisitor {
+		const TypeInfo& info;
+		const std::map<Expression*, Binding>& allocations;
+		std::map<std::string, std::stack<bool>> variables; //whether the variable has been replaced
+		std::stack<std::vector<std::string>> block_declarations;
+
+		void declare(const std::string& name, bool replaced) {
+			variables[name].push(replaced);
+			block_declarations.top().push_back(name);
+		}
+
+		void remove_last_variable_block() {
+			for(const std::string& name : block_declarations.top()) {
+				auto st = variables.find(name);
+				st->second.pop();
+				if(st->second.empty()) {
+					variables.erase(st);
+				}
+			}
+			block_declarations.pop();
+		}
+
+		bool is_replaced(Expression* allocation) {
+			auto a = allocations.find(allocation);
+			return a != allocations.end() && !a->second.escapes && a->second.fields_only && !is_array(allocation->type);
+		}
+
+		static std::string field_variable_name(const std::string& var, const std::string& field) {
+			//not a valid identifier, so it can't clash with a user variable
+			return var + '.' + field;
+		}
+
+		void replace_definition(Definition& arg, std::vector<std::unique_ptr<Statement>>& output) {
+			std::vector<std::pair<Symbol, std::unique_ptr<Expression>>> kept;
+			auto flush = [&]() {
+				if(!kept.empty()) {
+					output.push_back(std::make_unique<Definition>(arg.begin, arg.end, std::string(arg.type), std::move(kept)));
+					kept.clear();
+				}
+			};
+			for(auto& def : arg.defs) {
+				if(def.second && is_replaced(def.second.get())) {
+					flush();
+					for(const std::pair<Type, std::string>& field : info.classes.at(def.second->type)->variables) {
+						std::vector<std::pair<Symbol, std::unique_ptr<Expression>>> field_def;
+						field_def.emplace_back(field_variable_name(def.first, field.second), nullptr);
+						output.push_back(std::make_unique<Definition>(arg.begin, arg.end, std::string(field.first), std::move(field_def)));
+					}
+					declare(def.first, true);
+				} else {
+					if(def.second) {
+						visit_child(def.second);
+					}
+					declare(def.first, false);
+					kept.push_back(std::move(def));
+				}
+			}
+			flush();
+		}
+
+	public:
+		virtual void apply(ClassMember& arg) {
+			const Variable* var = get_node<Variable>(*arg.object);
+			if(var) {
+				auto st = variables.find(var->name);
+				if(st != variables.end() && st->second.top()) {
+					optimized_expression = std::make_unique<Variable>(arg.begin, arg.end, field_variable_name(var->name, arg.member));
+					optimized_expression->type = arg.type;
+					return;
+				}
+			}
+			visit_child(arg.object);
+		}
+
+		virtual void apply(For& arg) {
+			visit_child(arg.array);
+			block_declarations.emplace();
+			declare(arg.var_name, false);
+			visit_child(arg.action);
+			remove_last_variable_block();
+		}
+
+		virtual void apply(Block& arg) {
+			block_declarations.emplace();
+			std::vector<std::unique_ptr<Statement>> statements;
+			for(auto& s : arg.statements) {
+				Definition* def = get_node<Definition>(*s);
+				if(def) {
+					replace_definition(*def, statements);
+				} else {
+					visit_child(s);
+					statements.push_back(std::move(s));
+				}
+			}
+			arg.statements = std::move(statements);
+			remove_last_variable_block();
+		}
+
+		ScalarReplacer() = delete;
+		ScalarReplacer(const TypeInfo& info, const std::map<Expression*, Binding>& allocations) : info(info), allocations(allocations) {}
+		void replace(const FunctionInfo& fun, const std::string* class_name) {
+			block_declarations.emplace();
+			for(const auto& a : fun.args) {
+				declare(a.second, false);
+			}
+			if(class_name) {
+				declare(THIS_NAME, false);
+			}
+			fun.data->body->visit(this);
+			remove_last_variable_block();
+		}
+	};
+
+	//marks the remaining non-escaping allocations, to be placed in the stack frame by the backend
+	struct StackAllocationMarker : public DefaultVisitor {
+		virtual void default_action() {
+		}
+
+		virtual void apply(NewObject& arg) {
+			arg.on_stack = true;
+		}
+
+		virtual void apply(NewArray& arg) {
+			arg.on_stack = true;
+		}
+	};
+
+	class EscapeAnalysis {
+		const TypeInfo& info;
+		EscapeSummary summary;
+
+		template<typename F>
+		void for_each_function(F f) {
+			for(const auto& fun : info.functions) {
+				f(*fun.second, nullptr);
+			}
+			for(const auto& cl : info.classes) {
+				for(const auto& fun : cl.second->functions) {
+					if(fun->class_info == cl.second.get()) {
+						f(*fun, &cl.first);
+					}
+				}
+			}
+		}
+
+		bool update_summary() {
+			bool changed = false;
+			for_each_function([&](const FunctionInfo& fun, const std::string* class_name) {
+				EscapeVisitor v(info, summary);
+				v.analyse(fun, class_name);
+				std::vector<bool>& s = summary.at(fun.data.get());
+				for(size_t i = 0; i < s.size(); ++i) {
+					if(v.arguments[i].escapes && !s[i]) {
+						s[i] = true;
+						changed = true;
+					}
+				}
+			});
+			return changed;
+		}
+
+	public:
+		EscapeAnalysis() = delete;
+		EscapeAnalysis(const TypeInfo& info) : info(info) {}
+
+		EscapeSummary run() {
+			//optimistic start, arguments are marked as escaping until a fixed point is reached
+			for_each_function([&](const FunctionInfo& fun, const std::string* class_name) {
+				summary[fun.data.get()].resize(fun.args.size() + (class_name ? 1 : 0), false);
+			});
+			while(update_summary());
+			for_each_function([&](const FunctionInfo& fun, const std::string* class_name) {
+				EscapeVisitor v(info, summary);
+				v.analyse(fun, class_name);
+				ScalarReplacer r(info, v.allocations);
+				r.replace(fun, class_name);
+				StackAllocationMarker m;
+				for(auto& a : v.allocations) {
+					if(!a.second.escapes && !(a.second.fields_only && !is_array(a.first->type))) {
+						a.first->visit(&m);
+					}
+				}
+			});
+			return summary;
+		}
+	};
+}
+
+namespace Optimizer {
+	EscapeSummary optimize_allocations(const TypeInfo& info) {
+		return EscapeAnalysis(info).run();
+	}
+}
@@ -0,0 +1,17 @@
+#ifndef ESCAPE_ANALYSIS_H
+#define ESCAPE_ANALYSIS_H
+
+#include "type_info_builder.h"
+
+#include <map>
+#include <vector>
+
+namespace Optimizer {
+	//for every function: whether an object passed as the given argument may outlive the call ('self' is the last argument of a method)
+	using EscapeSummary = std::map<const ProgramTree::Function*, std::vector<bool>>;
+
+	//replaces objects that never leave their function with local variables (one per field) or moves them to the stack frame, returns the summary it was based on
+	EscapeSummary optimize_allocations(const TypeChecker::TypeInfo& info);
+}
+
+#endif
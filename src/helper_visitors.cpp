@@ -316,6 +316,175 @@ void DefaultVisitor::apply(Definition& arg) {
 	default_action();
 }
 
+void RecursiveVisitor::apply(BinaryOperator<BinOpType::Addition>& arg) {
+	visit_child(arg.left);
+	visit_child(arg.right);
+}
+void RecursiveVisitor::apply(BinaryOperator<BinOpType::Multiplication>& arg) {
+	visit_child(arg.left);
+	visit_child(arg.right);
+}
+void RecursiveVisitor::apply(BinaryOperator<BinOpType::Division>& arg) {
+	visit_child(arg.left);
+	visit_child(arg.right);
+}
+void RecursiveVisitor::apply(BinaryOperator<BinOpType::Substraction>& arg) {
+	visit_child(arg.left);
+	visit_child(arg.right);
+}
+void RecursiveVisitor::apply(BinaryOperator<BinOpType::Alternative>& arg) {
+	visit_child(arg.left);
+	visit_child(arg.right);
+}
+void RecursiveVisitor::apply(BinaryOperator<BinOpType::Conjunction>& arg) {
+	visit_child(arg.left);
+	visit_child(arg.right);
+}
+void RecursiveVisitor::apply(BinaryOperator<BinOpType::Modulo>& arg) {
+	visit_child(arg.left);
+	visit_child(arg.right);
+}
+void RecursiveVisitor::apply(BinaryOperator<BinOpType::LessThan>& arg) {
+	visit_child(arg.left);
+	visit_child(arg.right);
+}
+void RecursiveVisitor::apply(BinaryOperator<BinOpType::LessEqual>& arg) {
+	visit_child(arg.left);
+	visit_child(arg.right);
+}
+void RecursiveVisitor::apply(BinaryOperator<BinOpType::GreaterThan>& arg) {
+	visit_child(arg.left);
+	visit_child(arg.right);
+}
+void RecursiveVisitor::apply(BinaryOperator<BinOpType::GreaterEqual>& arg) {
+	visit_child(arg.left);
+	visit_child(arg.right);
+}
+void RecursiveVisitor::apply(BinaryOperator<BinOpType::Equal>& arg) {
+	visit_child(arg.left);
+	visit_child(arg.right);
+}
+void RecursiveVisitor::apply(BinaryOperator<BinOpType::NotEqual>& arg) {
+	visit_child(arg.left);
+	visit_child(arg.right);
+}
+void RecursiveVisitor::apply(UnaryOperator<UnOpType::IntNegation>& arg) {
+	visit_child(arg.expr);
+}
+void RecursiveVisitor::apply(UnaryOperator<UnOpType::BoolNegation>& arg) {
+	visit_child(arg.expr);
+}
+void RecursiveVisitor::apply(Literal<LiteralType::Bool>& arg) {
+	(void) arg;
+}
+void RecursiveVisitor::apply(Literal<LiteralType::Integer>& arg) {
+	(void) arg;
+}
+void RecursiveVisitor::apply(Literal<LiteralType::String>& arg) {
+	(void) arg;
+}
+void RecursiveVisitor::apply(Variable& arg) {
+	(void) arg;
+}
+void RecursiveVisitor::apply(Null& arg) {
+	(void) arg;
+}
+void RecursiveVisitor::apply(CallOperator& arg) {
+	visit_child(arg.fun);
+	for(auto& a : arg.args) {
+		visit_child(a);
+	}
+}
+void RecursiveVisitor::apply(StaticFunctionCall& arg) {
+	for(auto& a : arg.args) {
+		visit_child(a);
+	}
+}
+void RecursiveVisitor::apply(VirtualFunctionCall& arg) {
+	visit_child(arg.object);
+	for(auto& a : arg.args) {
+		visit_child(a);
+	}
+}
+void RecursiveVisitor::apply(SubscriptOperator& arg) {
+	visit_child(arg.arr);
+	visit_child(arg.index);
+}
+void RecursiveVisitor::apply(ClassMember& arg) {
+	visit_child(arg.object);
+}
+void RecursiveVisitor::apply(Cast& arg) {
+	visit_child(arg.expr);
+}
+void RecursiveVisitor::apply(NewObject& arg) {
+	(void) arg;
+}
+void RecursiveVisitor::apply(NewArray& arg) {
+	visit_child(arg.size);
+}
+void RecursiveVisitor::apply(Assignment& arg) {
+	visit_child(arg.var);
+	visit_child(arg.value);
+}
+void RecursiveVisitor::apply(Incrementation& arg) {
+	visit_child(arg.var);
+}
+void RecursiveVisitor::apply(Decrementation& arg) {
+	visit_child(arg.var);
+}
+void RecursiveVisitor::apply(ExprStatement& arg) {
+	visit_child(arg.expr);
+}
+void RecursiveVisitor::apply(Return& arg) {
+	if(arg.val) {
+		visit_child(arg.val);
+	}
+}
+void RecursiveVisitor::apply(If& arg) {
+	visit_child(arg.condition);
+	visit_child(arg.case_then);
+	if(arg.case_else) {
+		visit_child(arg.case_else);
+	}
+}
+void RecursiveVisitor::apply(While& arg) {
+	visit_child(arg.condition);
+	visit_child(arg.action);
+}
+void RecursiveVisitor::apply(For& arg) {
+	visit_child(arg.array);
+	visit_child(arg.action);
+}
+void RecursiveVisitor::apply(Block& arg) {
+	for(auto& s : arg.statements) {
+		visit_child(s);
+	}
+}
+void RecursiveVisitor::apply(Empty& arg) {
+	(void) arg;
+}
+void RecursiveVisitor::apply(Definition& arg) {
+	for(auto& def : arg.defs) {
+		if(def.second) {
+			visit_child(def.second);
+		}
+	}
+}
+void RecursiveVisitor::visit_child(std::unique_ptr<Expression>& child) {
+	child->visit(this);
+	if(optimized_expression) {
+		std::swap(child, optimized_expression);
+		optimized_expression = nullptr;
+	}
+}
+void RecursiveVisitor::visit_child(std::unique_ptr<Statement>& child) {
+	child->visit(this);
+	if(optimized_statement) {
+		std::swap(child, optimized_statement);
+		optimized_statement = nullptr;
+	}
+}
+
 template<>
 void LiteralGetter<LiteralType::Integer>::apply(const Literal<LiteralType::Integer> &arg) {
 	dest = &arg.val;
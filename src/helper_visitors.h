@@ -90,6 +90,78 @@ namespace ProgramTree {
 		virtual void apply(Definition& arg);
 	};
 
+	struct RecursiveVisitor : public Visitor {
+		//visits every subtree, an overriding apply may set 'optimized_expression' or 'optimized_statement' to replace the visited node
+		virtual void apply(BinaryOperator<BinOpType::Addition>& arg);
+		virtual void apply(BinaryOperator<BinOpType::Multiplication>& arg);
+		virtual void apply(BinaryOperator<BinOpType::Division>& arg);
+		virtual void apply(BinaryOperator<BinOpType::Substraction>& arg);
+		virtual void apply(BinaryOperator<BinOpType::Alternative>& arg);
+		virtual void apply(BinaryOperator<BinOpType::Conjunction>& arg);
+		virtual void apply(BinaryOperator<BinOpType::Modulo>& arg);
+		virtual void apply(BinaryOperator<BinOpType::LessThan>& arg);
+		virtual void apply(BinaryOperator<BinOpType::LessEqual>& arg);
+		virtual void apply(BinaryOperator<BinOpType::GreaterThan>& arg);
+		virtual void apply(BinaryOperator<BinOpType::GreaterEqual>& arg);
+		virtual void apply(BinaryOperator<BinOpType::Equal>& arg);
+		virtual void apply(BinaryOperator<BinOpType::NotEqual>& arg);
+		virtual void apply(UnaryOperator<UnOpType::IntNegation>& arg);
+		virtual void apply(UnaryOperator<UnOpType::BoolNegation>& arg);
+		virtual void apply(Literal<LiteralType::Bool>& arg);
+		virtual void apply(Literal<LiteralType::Integer>& arg);
+		virtual void apply(Literal<LiteralType::String>& arg);
+		virtual void apply(Variable& arg);
+		virtual void apply(Null& arg);
+		virtual void apply(CallOperator& arg);
+		virtual void apply(StaticFunctionCall& arg);
+		virtual void apply(VirtualFunctionCall& arg);
+		virtual void apply(SubscriptOperator& arg);
+		virtual void apply(ClassMember& arg);
+		virtual void apply(Cast& arg);
+		virtual void apply(NewObject& arg);
+		virtual void apply(NewArray& arg);
+		virtual void apply(Assignment& arg);
+		virtual void apply(Incrementation& arg);
+		virtual void apply(Decrementation& arg);
+		virtual void apply(ExprStatement& arg);
+		virtual void apply(Return& arg);
+		virtual void apply(If& arg);
+		virtual void apply(While& arg);
+		virtual void apply(For& arg);
+		virtual void apply(Block& arg);
+		virtual void apply(Empty& arg);
+		virtual void apply(Definition& arg);
+	protected:
+		std::unique_ptr<Expression> optimized_expression;
+		std::unique_ptr<Statement> optimized_statement;
+		virtual void visit_child(std::unique_ptr<Expression>& child);
+		virtual void visit_child(std::unique_ptr<Statement>& child);
+	};
+
+	template<typename T>
+	struct NodeGetter : public DefaultVisitor {
+		virtual void default_action() {
+		}
+
+		virtual void apply(T& arg) {
+			dest = &arg;
+		}
+
+		NodeGetter() = delete;
+		NodeGetter(T*& dest) : dest(dest) {}
+	private:
+		T*& dest;
+	};
+
+	//returns the node as T, or null if it's of some other type
+	template<typename T, typename U>
+	T* get_node(U& node) {
+		T* result = nullptr;
+		NodeGetter<T> ng(result);
+		node.visit(&ng);
+		return result;
+	}
+
 	template<LiteralType LT>
 	struct LiteralGetter : public DefaultConstVisitor {
 		virtual void default_action() {
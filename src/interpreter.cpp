@@ -0,0 +1,549 @@
+#include "bytecode.h"
+
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <memory>
+#include <unistd.h>
+
+using ProgramTree::Integer;
+using Bytecode::Opcode;
+
+namespace {
+	//registers of all the frames, only the used part of the memory is ever touched
+	const size_t STACK_SIZE = 1 << 24;
+
+	const size_t MAX_CALL_DEPTH = 1 << 20;
+
+	//small allocations are cut from chunks, nothing is ever freed, like in the runtime
+	const size_t CHUNK_SIZE = 1 << 20;
+
+	const size_t INPUT_BUFFER_SIZE = 4096;
+
+	const size_t OUTPUT_BUFFER_SIZE = 1 << 16;
+
+	//the same limit as in the runtime's readInt, one more digit may overflow
+	const Integer READ_INT_LIMIT = 922337203685477579;
+
+	//array sizes the runtime's _new_array refuses
+	const uint64_t ARRAY_SIZE_MASK = 0xf000000000000000;
+
+	//an instruction with the address of the code of its opcode
+	struct Threaded {
+		const void* handler;
+		int32_t a;
+		int32_t b;
+		int32_t c;
+	};
+
+	struct Frame {
+		const Threaded* pc; //the call
+		Integer* base;
+	};
+
+	//the runtime's functions, strings and arrays are a length followed by the characters or the elements
+	class Runtime {
+		char* next;
+		char* limit;
+		char output[OUTPUT_BUFFER_SIZE];
+		size_t output_size;
+		char input[INPUT_BUFFER_SIZE];
+		size_t input_pos;
+		size_t input_limit;
+
+		void write_all(const char* data, size_t size) {
+			while(size) {
+				ssize_t written = write(STDOUT_FILENO, data, size);
+				if(written <= 0) {
+					_exit(1);
+				}
+				data += written;
+				size -= written;
+			}
+		}
+
+		void print(const char* data, size_t size) {
+			if(output_size + size > OUTPUT_BUFFER_SIZE) {
+				flush();
+				if(size > OUTPUT_BUFFER_SIZE) {
+					write_all(data, size);
+					return;
+				}
+			}
+			memcpy(output + output_size, data, size);
+			output_size += size;
+		}
+
+		//the output is flushed first, in case the input depends on it
+		size_t refill() {
+			flush();
+			ssize_t size = read(STDIN_FILENO, input, INPUT_BUFFER_SIZE);
+			if(size < 0) {
+				error();
+			}
+			input_pos = 0;
+			input_limit = size;
+			return size;
+		}
+
+		bool is_whitespace(char c) {
+			return (c >= 9 && c <= 13) || c == ' ';
+		}
+
+	public:
+		Integer empty_string;
+		Integer empty_array;
+
+		Integer* allocate(size_t size) {
+			size = (size + 7) & ~(size_t) 7;
+			if(size > CHUNK_SIZE / 4) {
+				void* memory = std::malloc(size);
+				if(!memory) {
+					error();
+				}
+				return static_cast<Integer*>(memory);
+			}
+			if(size > (size_t) (limit - next)) {
+				next = static_cast<char*>(std::malloc(CHUNK_SIZE));
+				if(!next) {
+					error();
+				}
+				limit = next + CHUNK_SIZE;
+			}
+			Integer* result = reinterpret_cast<Integer*>(next);
+			next += size;
+			return result;
+		}
+
+		Integer string(const char* data, size_t size) {
+			Integer* result = allocate(size + sizeof(Integer));
+			result[0] = size;
+			memcpy(result + 1, data, size);
+			return reinterpret_cast<Integer>(result);
+		}
+
+		static size_t length(Integer str) {
+			return *reinterpret_cast<const Integer*>(str);
+		}
+
+		static const char* characters(Integer str) {
+			return reinterpret_cast<const char*>(reinterpret_cast<const Integer*>(str) + 1);
+		}
+
+		//only two empty strings give the empty one, otherwise the result is new
+		Integer concat(const Integer* parts, size_t count) {
+			size_t size = 0;
+			for(size_t i = 0; i < count; ++i) {
+				size += length(parts[i]);
+			}
+			if(!size) {
+				return reinterpret_cast<Integer>(&empty_string);
+			}
+			Integer* result = allocate(size + sizeof(Integer));
+			result[0] = size;
+			char* position = reinterpret_cast<char*>(result + 1);
+			for(size_t i = 0; i < count; ++i) {
+				memcpy(position, characters(parts[i]), length(parts[i]));
+				position += length(parts[i]);
+			}
+			return reinterpret_cast<Integer>(result);
+		}
+
+		Integer new_array(Integer size, Integer fill) {
+			if(!size) {
+				return reinterpret_cast<Integer>(&empty_array);
+			}
+			if(size & ARRAY_SIZE_MASK) {
+				error();
+			}
+			Integer* result = allocate((size + 1) * sizeof(Integer));
+			result[0] = size;
+			std::fill(result + 1, result + size + 1, fill);
+			return reinterpret_cast<Integer>(result);
+		}
+
+		//the smallest int stays negative after the runtime's negation and comes out as -0
+		void print_int(Integer val) {
+			char buffer[24];
+			char* position = buffer + sizeof(buffer);
+			*--position = '\n';
+			uint64_t absolute = val == std::numeric_limits<Integer>::min() ? 0 : val < 0 ? -(uint64_t) val : val;
+			do {
+				*--position = '0' + absolute % 10;
+				absolute /= 10;
+			} while(absolute);
+			if(val < 0) {
+				*--position = '-';
+			}
+			print(position, buffer + sizeof(buffer) - position);
+		}
+
+		void print_string(Integer str) {
+			print(characters(str), length(str));
+			print("\n", 1);
+		}
+
+		//a number without leading whitespace, the whitespace after it is skipped up to the end of the line
+		Integer read_int() {
+			if(input_pos == input_limit && !refill()) {
+				error();
+			}
+			Integer sign = 1;
+			if(input[input_pos] == '-') {
+				sign = -1;
+				if(++input_pos == input_limit && !refill()) {
+					error();
+				}
+			}
+			Integer result = 0;
+			bool digits = false;
+			while(input_pos < input_limit || refill()) {
+				char c = input[input_pos];
+				if(c < '0' || c > '9') {
+					break;
+				}
+				if(result >= READ_INT_LIMIT) {
+					error();
+				}
+				result = result * 10 + (c - '0');
+				digits = true;
+				++input_pos;
+			}
+			while(input_pos < input_limit || refill()) {
+				char c = input[input_pos];
+				if(!is_whitespace(c)) {
+					break;
+				}
+				++input_pos;
+				if(c == '\n') {
+					break;
+				}
+			}
+			if(!digits) {
+				error();
+			}
+			return result * sign;
+		}
+
+		//the rest of the line without the newline
+		Integer read_string() {
+			std::string line;
+			while(input_pos < input_limit || refill()) {
+				const char* begin = input + input_pos;
+				const char* end = static_cast<const char*>(memchr(begin, '\n', input_limit - input_pos));
+				if(end) {
+					line.append(begin, end);
+					input_pos = end - input + 1;
+					break;
+				}
+				line.append(begin, input_limit - input_pos);
+				input_pos = input_limit;
+			}
+			return line.empty() ? reinterpret_cast<Integer>(&empty_string) : string(line.data(), line.size());
+		}
+
+		void flush() {
+			write_all(output, output_size);
+			output_size = 0;
+		}
+
+		[[noreturn]] void exit(Integer code) {
+			flush();
+			_exit(code);
+		}
+
+		[[noreturn]] void error() {
+			exit(1);
+		}
+
+		//where the machine code faults, SIGFPE from idiv or SIGSEGV from a null pointer or the end of the stack, the process dies of the same signal
+		[[noreturn]] void trap(int signal) {
+			flush();
+			std::signal(signal, SIG_DFL);
+			std::raise(signal);
+			_exit(128 + signal);
+		}
+
+		Runtime() : next(nullptr), limit(nullptr), output_size(0), input_pos(0), input_limit(0), empty_string(0), empty_array(0) {}
+	};
+}
+
+void Bytecode::interpret(const Program& program) {
+	static Runtime runtime;
+
+	//the labels of the opcodes, in their order
+	static const void* const handlers[] = {
+		&&Move, &&LoadInt, &&LoadConstant, &&LoadString, &&LoadArray, &&LoadEmpty,
+		&&Add, &&Substract, &&Multiply, &&Divide, &&Modulo, &&AddImmediate, &&Negate, &&Not,
+		&&Less, &&LessEqual, &&Greater, &&GreaterEqual, &&Equal, &&NotEqual,
+		&&Jump, &&JumpIf, &&JumpUnless,
+		&&JumpLess, &&JumpLessEqual, &&JumpGreater, &&JumpGreaterEqual, &&JumpEqual, &&JumpNotEqual,
+		&&Call, &&CallVirtual, &&Return, &&ReturnVoid,
+		&&PrintInt, &&PrintString, &&ReadInt, &&ReadString, &&Error,
+		&&Concat, &&ConcatN, &&NewObject, &&NewArray, &&Length,
+		&&LoadElement, &&StoreElement, &&LoadField, &&StoreField
+	};
+	static_assert(sizeof(handlers) / sizeof(handlers[0]) == (size_t) Opcode::Count, "Every opcode needs a handler.");
+
+	//the handlers are resolved once, each instruction jumps straight to the next one's
+	std::vector<Threaded> code;
+	code.reserve(program.code.size());
+	for(const Instruction& instruction : program.code) {
+		code.push_back({handlers[(size_t) instruction.op], instruction.a, instruction.b, instruction.c});
+	}
+
+	std::vector<Integer> strings;
+	for(const std::string& str : program.strings) {
+		strings.push_back(runtime.string(str.data(), str.size()));
+	}
+	std::vector<Integer> arrays;
+	for(const ProgramTree::ConstantArray* c : program.arrays) {
+		size_t size = c->values.size();
+		Integer* array = runtime.allocate((size + 1) * sizeof(Integer));
+		array[0] = size;
+		for(size_t i = 0; i < size; ++i) {
+			array[i + 1] = c->values[i];
+		}
+		arrays.push_back(reinterpret_cast<Integer>(array));
+	}
+
+	//each class has its vtable of function ids and an object with the initial values to copy
+	std::vector<std::vector<Integer>> vtables;
+	std::vector<std::vector<Integer>> objects;
+	for(const Class& cl : program.classes) {
+		vtables.emplace_back(cl.vtable.begin(), cl.vtable.end());
+		objects.emplace_back(1, reinterpret_cast<Integer>(vtables.back().data()));
+		for(Field field : cl.fields) {
+			Integer* empty = field == Field::EmptyString ? &runtime.empty_string : field == Field::EmptyArray ? &runtime.empty_array : nullptr;
+			objects.back().push_back(reinterpret_cast<Integer>(empty));
+		}
+	}
+
+	std::unique_ptr<Integer[]> stack(new Integer[STACK_SIZE]);
+	std::unique_ptr<Frame[]> frames(new Frame[MAX_CALL_DEPTH]);
+	const Integer* const stack_end = stack.get() + STACK_SIZE;
+	const Frame* const frames_end = frames.get() + MAX_CALL_DEPTH;
+	const Function* const functions = program.functions.data();
+	const Threaded* const start = code.data();
+
+	Integer* base = stack.get();
+	Frame* frame = frames.get();
+	const Threaded* pc = start + functions[program.main].entry;
+
+#define DISPATCH() goto *pc->handler
+#define NEXT() do { ++pc; DISPATCH(); } while(false)
+#define A base[pc->a]
+#define B base[pc->b]
+#define C base[pc->c]
+#define INT_OP(op) A = (Integer) ((uint64_t) B op (uint64_t) C); NEXT()
+#define COMPARE(op) A = B op C; NEXT()
+#define JUMP_IF(condition) pc = (condition) ? start + pc->a : pc + 1; DISPATCH()
+#define CHECK_NULL(object) if(!(object)) { runtime.trap(SIGSEGV); }
+
+	DISPATCH();
+
+Move:
+	A = B;
+	NEXT();
+LoadInt:
+	A = pc->b;
+	NEXT();
+LoadConstant:
+	A = program.constants[pc->b];
+	NEXT();
+LoadString:
+	A = strings[pc->b];
+	NEXT();
+LoadArray:
+	A = arrays[pc->b];
+	NEXT();
+LoadEmpty:
+	A = reinterpret_cast<Integer>(pc->b ? &runtime.empty_array : &runtime.empty_string);
+	NEXT();
+Add:
+	INT_OP(+);
+Substract:
+	INT_OP(-);
+Multiply:
+	INT_OP(*);
+//idiv faults on the quotient of the smallest int and -1 too
+Divide:
+	if(!C || (C == -1 && B == std::numeric_limits<Integer>::min())) {
+		runtime.trap(SIGFPE);
+	}
+	A = B / C;
+	NEXT();
+Modulo:
+	if(!C || (C == -1 && B == std::numeric_limits<Integer>::min())) {
+		runtime.trap(SIGFPE);
+	}
+	A = B % C;
+	NEXT();
+AddImmediate:
+	A = (Integer) ((uint64_t) B + (uint64_t) (Integer) pc->c);
+	NEXT();
+Negate:
+	A = (Integer) -(uint64_t) B;
+	NEXT();
+Not:
+	A = !B;
+	NEXT();
+Less:
+	COMPARE(<);
+LessEqual:
+	COMPARE(<=);
+Greater:
+	COMPARE(>);
+GreaterEqual:
+	COMPARE(>=);
+Equal:
+	COMPARE(==);
+NotEqual:
+	COMPARE(!=);
+Jump:
+	pc = start + pc->a;
+	DISPATCH();
+JumpIf:
+	JUMP_IF(B);
+JumpUnless:
+	JUMP_IF(!B);
+JumpLess:
+	JUMP_IF(B < C);
+JumpLessEqual:
+	JUMP_IF(B <= C);
+JumpGreater:
+	JUMP_IF(B > C);
+JumpGreaterEqual:
+	JUMP_IF(B >= C);
+JumpEqual:
+	JUMP_IF(B == C);
+JumpNotEqual:
+	JUMP_IF(B != C);
+//running out of the stack faults like the machine stack, the callee's frame starts at the arguments
+Call: {
+		const Function& function = functions[pc->b];
+		Integer* callee = &C;
+		if(callee + function.frame_size > stack_end || frame == frames_end) {
+			runtime.trap(SIGSEGV);
+		}
+		*frame++ = {pc, base};
+		base = callee;
+		pc = start + function.entry;
+		DISPATCH();
+	}
+CallVirtual: {
+		const Integer* object = reinterpret_cast<const Integer*>(C);
+		CHECK_NULL(object);
+		const Function& function = functions[reinterpret_cast<const Integer*>(object[0])[pc->b]];
+		Integer* callee = &C;
+		if(callee + function.frame_size > stack_end || frame == frames_end) {
+			runtime.trap(SIGSEGV);
+		}
+		*frame++ = {pc, base};
+		base = callee;
+		pc = start + function.entry;
+		DISPATCH();
+	}
+//the result goes to the destination of the call, main's result is the exit code
+Return: {
+		Integer value = A;
+		if(frame == frames.get()) {
+			runtime.exit(value);
+		}
+		--frame;
+		pc = frame->pc;
+		base = frame->base;
+		A = value;
+		NEXT();
+	}
+ReturnVoid:
+	if(frame == frames.get()) {
+		runtime.exit(0);
+	}
+	--frame;
+	pc = frame->pc;
+	base = frame->base;
+	NEXT();
+PrintInt:
+	runtime.print_int(A);
+	NEXT();
+PrintString:
+	runtime.print_string(A);
+	NEXT();
+ReadInt:
+	A = runtime.read_int();
+	NEXT();
+ReadString:
+	A = runtime.read_string();
+	NEXT();
+Error:
+	runtime.error();
+Concat: {
+		Integer parts[] = {B, C};
+		A = runtime.concat(parts, 2);
+		NEXT();
+	}
+ConcatN:
+	A = runtime.concat(&B, pc->c);
+	NEXT();
+NewObject: {
+		const std::vector<Integer>& initial = objects[pc->b];
+		Integer* object = runtime.allocate(initial.size() * sizeof(Integer));
+		std::copy(initial.begin(), initial.end(), object);
+		A = reinterpret_cast<Integer>(object);
+		NEXT();
+	}
+NewArray:
+	A = runtime.new_array(B, pc->c ? reinterpret_cast<Integer>(&runtime.empty_string) : 0);
+	NEXT();
+Length: {
+		const Integer* array = reinterpret_cast<const Integer*>(B);
+		CHECK_NULL(array);
+		A = array[0];
+		NEXT();
+	}
+//a negative index is out of the bounds too
+LoadElement: {
+		const Integer* array = reinterpret_cast<const Integer*>(B);
+		CHECK_NULL(array);
+		if((uint64_t) C >= (uint64_t) array[0]) {
+			runtime.error();
+		}
+		A = array[C + 1];
+		NEXT();
+	}
+StoreElement: {
+		Integer* array = reinterpret_cast<Integer*>(A);
+		CHECK_NULL(array);
+		if((uint64_t) B >= (uint64_t) array[0]) {
+			runtime.error();
+		}
+		array[B + 1] = C;
+		NEXT();
+	}
+LoadField: {
+		const Integer* object = reinterpret_cast<const Integer*>(B);
+		CHECK_NULL(object);
+		A = object[pc->c];
+		NEXT();
+	}
+StoreField: {
+		Integer* object = reinterpret_cast<Integer*>(A);
+		CHECK_NULL(object);
+		object[pc->b] = C;
+		NEXT();
+	}
+
+#undef DISPATCH
+#undef NEXT
+#undef A
+#undef B
+#undef C
+#undef INT_OP
+#undef COMPARE
+#undef JUMP_IF
+#undef CHECK_NULL
+}
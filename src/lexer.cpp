@@ -8,6 +8,7 @@
 
 Token::Token(Type type, std::string&& data, size_t pos) : type(type), data(std::move(data)), pos(pos) {}
 Token::Token(Type type, const std::string& data, size_t pos) : type(type), data(std::move(data)), pos(pos) {}
+Token::Token(ProgramTree::Symbol name, size_t pos) : type(Type::NAME), data(name.name()), symbol(name), pos(pos) {}
 
 LexerException::LexerException(size_t pos) : pos(pos) {}
 
@@ -255,7 +256,7 @@ std::vector<Token> tokenize(const std::string& input) {
 		if(is_num) {
 			result.push_back(Token(Token::Type::LITERAL_NUMBER, std::move(id), pos));
 		} else {
-			result.push_back(Token(Token::Type::NAME, std::move(id), pos));
+			result.push_back(Token(ProgramTree::Symbol(id), pos));
 		}
 		pos += off;
 	}
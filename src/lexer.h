@@ -1,6 +1,8 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include "symbols.h"
+
 #include <string>
 #include <vector>
 #include <map>
@@ -21,6 +23,7 @@ struct Token {
 
 	const Type type;
 	std::string data;
+	ProgramTree::Symbol symbol; //of a name, interned once by the lexer
 	const size_t pos;
 
 	Token() = delete;
@@ -28,6 +31,7 @@ struct Token {
 	Token(Token&&) = default;
 	Token(Type type, std::string&& data, size_t pos);
 	Token(Type type, const std::string& data, size_t pos);
+	Token(ProgramTree::Symbol name, size_t pos);
 };
 
 struct LexerException : public std::exception {
@@ -0,0 +1,397 @@
+#include "linker.h"
+#include "elf.h"
+
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <sys/mman.h>
+
+using namespace Elf;
+
+namespace {
+	const uint64_t BASE_ADDRESS = 0x400000;
+	const uint64_t PAGE = 0x1000;
+	const std::string ENTRY = "_start";
+
+	//the headers and read-only data, code, then data and .bss, each segment starts on its own page
+	enum Segment {RODATA, TEXT, DATA, SEGMENTS};
+	const uint32_t SEGMENT_FLAGS[SEGMENTS] = {PF_R, PF_R | PF_X, PF_R | PF_W};
+	const size_t PROGRAM_HEADERS = SEGMENTS + 1;
+
+	//output sections, .bss comes last in the data segment
+	enum OutputSection {NO_OUTPUT, RODATA_OUTPUT, TEXT_OUTPUT, DATA_OUTPUT, BSS_OUTPUT, SYMTAB_OUTPUT, STRTAB_OUTPUT, SHSTRTAB_OUTPUT, OUTPUT_SECTIONS};
+	const char* const OUTPUT_NAMES[OUTPUT_SECTIONS] = {"", ".rodata", ".text", ".data", ".bss", ".symtab", ".strtab", ".shstrtab"};
+
+	struct InputRelocation {
+		uint64_t offset;
+		uint32_t type;
+		size_t symbol;
+		int64_t addend;
+	};
+
+	struct InputSection {
+		std::string name;
+		uint32_t type;
+		uint64_t flags;
+		uint64_t alignment;
+		std::string bytes; //empty unless the section is loaded and has contents
+		size_t size;
+		std::vector<InputRelocation> relocations;
+		bool loaded;
+		Segment segment;
+		uint64_t offset; //in the segment, to be set by the layout
+	};
+
+	struct InputSymbol {
+		std::string name;
+		uint8_t info;
+		uint16_t section;
+		uint64_t value;
+	};
+
+	struct InputObject {
+		std::vector<InputSection> sections;
+		std::vector<InputSymbol> symbols;
+	};
+
+	uint64_t align(uint64_t value, uint64_t alignment) {
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	std::string read_string(const std::string& file, size_t table, size_t table_size, size_t offset) {
+		if(offset >= table_size || table + table_size > file.size()) {
+			throw std::runtime_error("Invalid ELF string table.");
+		}
+		size_t end = file.find('\0', table + offset);
+		if(end >= table + table_size) {
+			throw std::runtime_error("Invalid ELF string table.");
+		}
+		return file.substr(table + offset, end - table - offset);
+	}
+
+	InputObject read_object(const std::string& file) {
+		//64-bit little endian relocatable for x86_64
+		if(read(file, 0, 4) != 0x464c457f || read(file, 4, 2) != 0x0102 || read(file, 16, 2) != ET_REL || read(file, 18, 2) != EM_X86_64) {
+			throw std::runtime_error("Not an x86_64 ELF relocatable object.");
+		}
+		size_t headers = read(file, 40, 8);
+		size_t count = read(file, 60, 2);
+		size_t names = read(file, 62, 2);
+		auto header = [&](size_t section, size_t field, size_t size) {
+			return read(file, headers + section * SECTION_HEADER_SIZE + field, size);
+		};
+		if(names >= count) {
+			throw std::runtime_error("Invalid ELF section names.");
+		}
+
+		InputObject result;
+		result.sections.resize(count);
+		for(size_t i = 0; i < count; ++i) {
+			InputSection& s = result.sections[i];
+			s.name = read_string(file, header(names, 24, 8), header(names, 32, 8), header(i, 0, 4));
+			s.type = header(i, 4, 4);
+			s.flags = header(i, 8, 8);
+			s.size = header(i, 32, 8);
+			s.alignment = std::max<uint64_t>(header(i, 48, 8), 1);
+			s.loaded = (s.flags & SHF_ALLOC) && (s.type == SHT_PROGBITS || s.type == SHT_NOBITS);
+			s.segment = s.flags & SHF_EXECINSTR ? TEXT : s.type == SHT_NOBITS || (s.flags & SHF_WRITE) ? DATA : RODATA;
+			s.offset = 0;
+			if(s.loaded && s.type == SHT_PROGBITS) {
+				size_t offset = header(i, 24, 8);
+				if(offset > file.size() || file.size() - offset < s.size) {
+					throw std::runtime_error("Truncated ELF file.");
+				}
+				s.bytes = file.substr(offset, s.size);
+			}
+		}
+		for(size_t i = 0; i < count; ++i) {
+			size_t offset = header(i, 24, 8);
+			size_t entries = header(i, 32, 8) / (result.sections[i].type == SHT_SYMTAB ? SYMBOL_SIZE : RELOCATION_SIZE);
+			if(result.sections[i].type == SHT_SYMTAB) {
+				size_t strings = header(i, 40, 4);
+				if(strings >= count) {
+					throw std::runtime_error("Invalid ELF symbol names.");
+				}
+				for(size_t j = 0; j < entries; ++j) {
+					size_t symbol = offset + j * SYMBOL_SIZE;
+					result.symbols.push_back({read_string(file, header(strings, 24, 8), header(strings, 32, 8), read(file, symbol, 4)), (uint8_t) read(file, symbol + 4, 1), (uint16_t) read(file, symbol + 6, 2), read(file, symbol + 8, 8)});
+				}
+			} else if(result.sections[i].type == SHT_RELA) {
+				size_t target = header(i, 44, 4);
+				if(target >= count) {
+					throw std::runtime_error("Invalid ELF relocation section.");
+				}
+				for(size_t j = 0; j < entries; ++j) {
+					size_t relocation = offset + j * RELOCATION_SIZE;
+					uint64_t info = read(file, relocation + 8, 8);
+					result.sections[target].relocations.push_back({read(file, relocation, 8), (uint32_t) info, info >> 32, (int64_t) read(file, relocation + 16, 8)});
+				}
+			}
+		}
+		return result;
+	}
+
+	class Linker {
+		std::vector<InputObject> objects;
+		std::map<std::string, std::pair<size_t, size_t>> globals; //the object and the symbol defining each global symbol
+		uint64_t segment_offsets[SEGMENTS]; //from the beginning of the image, page aligned
+		size_t segment_sizes[SEGMENTS];
+		size_t data_file_size; //of the data segment without .bss
+		uint64_t base; //to be set by relocate
+		std::vector<uint8_t> segment_bytes[SEGMENTS]; //to be set by relocate
+
+		//hot code before the other text sections, initialized data before .bss
+		bool in_first_pass(const InputSection& s) {
+			return s.segment == TEXT ? s.name == ".text" : s.segment != DATA || s.type == SHT_PROGBITS;
+		}
+
+		void layout() {
+			size_t end = 0;
+			for(int seg = RODATA; seg < SEGMENTS; ++seg) {
+				segment_offsets[seg] = align(end, PAGE);
+				size_t size = seg == RODATA ? HEADER_SIZE + PROGRAM_HEADERS * PROGRAM_HEADER_SIZE : 0;
+				for(bool first : {true, false}) {
+					for(InputObject& o : objects) {
+						for(InputSection& s : o.sections) {
+							if(s.loaded && s.segment == seg && in_first_pass(s) == first) {
+								size = align(size, s.alignment);
+								s.offset = size;
+								size += s.size;
+							}
+						}
+					}
+					if(seg == DATA && first) {
+						data_file_size = size;
+					}
+				}
+				segment_sizes[seg] = size;
+				end = segment_offsets[seg] + size;
+			}
+		}
+
+		uint64_t address(size_t object, size_t index) const {
+			const InputObject& o = objects[object];
+			if(index >= o.symbols.size()) {
+				throw std::runtime_error("Invalid ELF symbol index.");
+			}
+			const InputSymbol& s = o.symbols[index];
+			if(s.section == SHN_UNDEF) {
+				auto global = globals.find(s.name);
+				if(global == globals.end()) {
+					throw std::runtime_error("Undefined symbol " + s.name + ".");
+				}
+				return address(global->second.first, global->second.second);
+			}
+			if(s.section == SHN_ABS) {
+				return s.value;
+			}
+			if(s.section >= o.sections.size() || !o.sections[s.section].loaded) {
+				throw std::runtime_error("Symbol " + s.name + " isn't in a loaded section.");
+			}
+			const InputSection& section = o.sections[s.section];
+			return base + segment_offsets[section.segment] + section.offset + s.value;
+		}
+
+		void apply(const InputSection& s, const InputRelocation& r, uint64_t symbol) {
+			bool pc_relative = r.type == R_X86_64_PC32 || r.type == R_X86_64_PLT32;
+			size_t size = r.type == R_X86_64_64 ? 8 : 4;
+			if(r.type != R_X86_64_64 && r.type != R_X86_64_32 && r.type != R_X86_64_32S && !pc_relative) {
+				throw std::runtime_error("Unsupported relocation type " + std::to_string(r.type) + ".");
+			}
+			if(s.type == SHT_NOBITS || r.offset > s.size || s.size - r.offset < size) {
+				throw std::runtime_error("Relocation outside of its section.");
+			}
+			uint64_t place = base + segment_offsets[s.segment] + s.offset + r.offset;
+			int64_t value = symbol + r.addend - (pc_relative ? place : 0);
+			if((r.type == R_X86_64_32 && (uint64_t) value > UINT32_MAX) || (size == 4 && r.type != R_X86_64_32 && (value < INT32_MIN || value > INT32_MAX))) {
+				throw std::runtime_error("Relocation overflow.");
+			}
+			for(size_t i = 0; i < size; ++i) {
+				segment_bytes[s.segment][s.offset + r.offset + i] = (value >> (8 * i)) & 0xff;
+			}
+		}
+
+		OutputSection output_section(const InputSection& s) const {
+			return s.segment == RODATA ? RODATA_OUTPUT : s.segment == TEXT ? TEXT_OUTPUT : s.type == SHT_NOBITS ? BSS_OUTPUT : DATA_OUTPUT;
+		}
+
+	public:
+		//the contents of the segments loaded at base
+		void relocate(uint64_t new_base) {
+			base = new_base;
+			for(int seg = RODATA; seg < SEGMENTS; ++seg) {
+				segment_bytes[seg].assign(seg == DATA ? data_file_size : segment_sizes[seg], 0);
+			}
+			for(const InputObject& o : objects) {
+				for(const InputSection& s : o.sections) {
+					if(s.loaded) {
+						std::copy(s.bytes.begin(), s.bytes.end(), segment_bytes[s.segment].begin() + s.offset);
+					}
+				}
+			}
+			for(size_t i = 0; i < objects.size(); ++i) {
+				for(const InputSection& s : objects[i].sections) {
+					if(s.loaded) {
+						for(const InputRelocation& r : s.relocations) {
+							apply(s, r, address(i, r.symbol));
+						}
+					}
+				}
+			}
+		}
+
+		size_t image_size() const {
+			return align(segment_offsets[DATA] + segment_sizes[DATA], PAGE);
+		}
+
+		//the image goes to writable memory of image_size bytes, which then gets the permissions of the segments
+		void load(uint8_t* memory) {
+			relocate((uint64_t) memory);
+			for(int seg = RODATA; seg < SEGMENTS; ++seg) {
+				std::copy(segment_bytes[seg].begin(), segment_bytes[seg].end(), memory + segment_offsets[seg]);
+				int protection = PROT_READ | (SEGMENT_FLAGS[seg] & PF_W ? PROT_WRITE : 0) | (SEGMENT_FLAGS[seg] & PF_X ? PROT_EXEC : 0);
+				if(segment_sizes[seg] && mprotect(memory + segment_offsets[seg], align(segment_sizes[seg], PAGE), protection)) {
+					throw std::runtime_error("Can't set the permissions of the program's memory.");
+				}
+			}
+		}
+
+		uint64_t entry() const {
+			auto start = globals.find(ENTRY);
+			if(start == globals.end()) {
+				throw std::runtime_error("Undefined symbol " + ENTRY + ".");
+			}
+			return address(start->second.first, start->second.second);
+		}
+
+		void write(std::ostream& output) {
+			relocate(BASE_ADDRESS);
+			Buffer file;
+			for(int seg = RODATA; seg < SEGMENTS; ++seg) {
+				file.bytes.resize(segment_offsets[seg]);
+				file.append(segment_bytes[seg]);
+			}
+
+			//the symbols of the objects except for sections and file names, locals first
+			StringTable strings;
+			Buffer symbols;
+			write_symbol(symbols, 0, 0, SHN_UNDEF, 0);
+			size_t locals = 1;
+			for(size_t i = 0; i < objects.size(); ++i) {
+				for(size_t j = 1; j < objects[i].symbols.size(); ++j) {
+					const InputSymbol& s = objects[i].symbols[j];
+					uint8_t type = s.info & 0xf;
+					if(s.info >> 4 != STB_LOCAL || s.name.empty() || type == STT_SECTION || type == STT_FILE || s.section == SHN_UNDEF) {
+						continue;
+					}
+					if(s.section == SHN_ABS) {
+						write_symbol(symbols, strings.add(s.name), s.info, SHN_ABS, s.value);
+					} else if(s.section < objects[i].sections.size() && objects[i].sections[s.section].loaded) {
+						write_symbol(symbols, strings.add(s.name), s.info, output_section(objects[i].sections[s.section]), address(i, j));
+					} else {
+						continue;
+					}
+					++locals;
+				}
+			}
+			for(const auto& global : globals) {
+				const InputSymbol& s = objects[global.second.first].symbols[global.second.second];
+				uint16_t section = s.section == SHN_ABS ? SHN_ABS : (uint16_t) output_section(objects[global.second.first].sections[s.section]);
+				write_symbol(symbols, strings.add(s.name), s.info, section, address(global.second.first, global.second.second));
+			}
+
+			size_t headers_size = HEADER_SIZE + PROGRAM_HEADERS * PROGRAM_HEADER_SIZE;
+			uint64_t bss_offset = segment_offsets[DATA] + data_file_size;
+			std::vector<SectionHeader> headers = {
+				{0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
+				{0, SHT_PROGBITS, SHF_ALLOC, BASE_ADDRESS + headers_size, headers_size, segment_sizes[RODATA] - headers_size, 0, 0, 8, 0},
+				{0, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, BASE_ADDRESS + segment_offsets[TEXT], segment_offsets[TEXT], segment_sizes[TEXT], 0, 0, 16, 0},
+				{0, SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, BASE_ADDRESS + segment_offsets[DATA], segment_offsets[DATA], data_file_size, 0, 0, 8, 0},
+				{0, SHT_NOBITS, SHF_ALLOC | SHF_WRITE, BASE_ADDRESS + bss_offset, bss_offset, segment_sizes[DATA] - data_file_size, 0, 0, 8, 0},
+				{0, SHT_SYMTAB, 0, 0, 0, symbols.size(), STRTAB_OUTPUT, (uint32_t) locals, 8, SYMBOL_SIZE},
+				{0, SHT_STRTAB, 0, 0, 0, strings.bytes.size(), 0, 0, 1, 0},
+				{0, SHT_STRTAB, 0, 0, 0, 0, 0, 0, 1, 0}
+			};
+			StringTable names;
+			for(size_t i = 1; i < OUTPUT_SECTIONS; ++i) {
+				headers[i].name = names.add(OUTPUT_NAMES[i]);
+			}
+			headers[SHSTRTAB_OUTPUT].size = names.bytes.size();
+			file.align(8);
+			headers[SYMTAB_OUTPUT].offset = file.size();
+			file.append(symbols.bytes);
+			headers[STRTAB_OUTPUT].offset = file.size();
+			file.append(strings.bytes);
+			headers[SHSTRTAB_OUTPUT].offset = file.size();
+			file.append(names.bytes);
+			file.align(8);
+			size_t section_headers = file.size();
+			for(const SectionHeader& h : headers) {
+				write_section_header(file, h);
+			}
+
+			write_header(file, ET_EXEC, entry(), PROGRAM_HEADERS, section_headers, headers.size());
+			for(int seg = RODATA; seg < SEGMENTS; ++seg) {
+				size_t header = HEADER_SIZE + seg * PROGRAM_HEADER_SIZE;
+				file.patch(header, PT_LOAD, 4);
+				file.patch(header + 4, SEGMENT_FLAGS[seg], 4);
+				file.patch(header + 8, segment_offsets[seg], 8);
+				file.patch(header + 16, BASE_ADDRESS + segment_offsets[seg], 8);
+				file.patch(header + 24, BASE_ADDRESS + segment_offsets[seg], 8);
+				file.patch(header + 32, segment_bytes[seg].size(), 8);
+				file.patch(header + 40, segment_sizes[seg], 8);
+				file.patch(header + 48, PAGE, 8);
+			}
+			//the stack isn't executable
+			size_t stack = HEADER_SIZE + SEGMENTS * PROGRAM_HEADER_SIZE;
+			file.patch(stack, PT_GNU_STACK, 4);
+			file.patch(stack + 4, PF_R | PF_W, 4);
+			file.patch(stack + 48, 16, 8);
+			file.write(output);
+		}
+
+		Linker(const std::vector<std::string>& files) : data_file_size(0), base(0) {
+			for(const std::string& file : files) {
+				objects.push_back(read_object(file));
+			}
+			for(size_t i = 0; i < objects.size(); ++i) {
+				for(size_t j = 1; j < objects[i].symbols.size(); ++j) {
+					const InputSymbol& s = objects[i].symbols[j];
+					uint8_t bind = s.info >> 4;
+					if(s.section == SHN_UNDEF || (bind != STB_GLOBAL && bind != STB_WEAK)) {
+						continue;
+					}
+					auto previous = globals.find(s.name);
+					if(previous == globals.end()) {
+						globals[s.name] = {i, j};
+					} else if(bind == STB_GLOBAL) {
+						if(objects[previous->second.first].symbols[previous->second.second].info >> 4 == STB_GLOBAL) {
+							throw std::runtime_error("Symbol " + s.name + " is defined more than once.");
+						}
+						previous->second = {i, j};
+					}
+				}
+			}
+			layout();
+		}
+	};
+}
+
+void link(const std::vector<std::string>& objects, std::ostream& output) {
+	Linker linker(objects);
+	linker.write(output);
+}
+
+void run(const std::vector<std::string>& objects) {
+	Linker linker(objects);
+	//absolute addresses in the code are 32-bit, so the program has to live in the lowest 2GB
+	void* memory = mmap(nullptr, linker.image_size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_32BIT, -1, 0);
+	if(memory == MAP_FAILED) {
+		throw std::runtime_error("Can't allocate memory for the program.");
+	}
+	linker.load((uint8_t*) memory);
+	uint64_t entry = linker.entry();
+	//_start runs on the current stack, aligned like at the start of a process
+	asm volatile("and $-16, %%rsp\n\tjmp *%0" : : "r"(entry) : "memory");
+	__builtin_unreachable();
+}
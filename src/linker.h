@@ -0,0 +1,14 @@
+#ifndef LINKER_H
+#define LINKER_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+//links x86_64 ELF relocatable objects into a static executable entered at _start, throws on undefined or repeated symbols
+void link(const std::vector<std::string>& objects, std::ostream& output);
+
+//links the objects like link, but into memory of this process, and jumps to _start, the program's exit ends the process
+[[noreturn]] void run(const std::vector<std::string>& objects);
+
+#endif
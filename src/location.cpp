@@ -1,5 +1,7 @@
 #include "location.h"
 
+#include <algorithm>
+
 std::map<size_t, size_t> LocationTranslator::get_line_breaks(const std::string& str) {
 	std::map<size_t, size_t> lb;
 	lb[0] = 0;
@@ -13,8 +15,15 @@ std::map<size_t, size_t> LocationTranslator::get_line_breaks(const std::string&
 }
 
 std::string LocationTranslator::operator()(size_t pos) const {
+	std::string file;
+	size_t start = 0;
+	if(!files.empty()) {
+		auto f = --files.upper_bound(std::min(pos, filesize));
+		file = f->second + ", ";
+		start = f->first;
+	}
 	if(pos >= filesize) {
-		return "endfile";
+		return file + "endfile";
 	}
 	auto v = line_breaks.upper_bound(pos);
 	size_t k;
@@ -24,7 +33,9 @@ std::string LocationTranslator::operator()(size_t pos) const {
 		k = (--v)->first;
 	}
 	v = line_breaks.find(k);
-	return "line " + std::to_string(v->second) + ", column " + std::to_string(pos - v->first);
+	//lines are counted from the beginning of the file, which follows the line break ending the previous one
+	size_t first_line = start ? line_breaks.at(start - 1) : 0;
+	return file + "line " + std::to_string(v->second - first_line) + ", column " + std::to_string(pos - std::max(v->first, start));
 }
 
-LocationTranslator::LocationTranslator(const std::string& str): line_breaks(get_line_breaks(str)), filesize(str.size()) {}
+LocationTranslator::LocationTranslator(const std::string& str, const std::map<size_t, std::string>& files): line_breaks(get_line_breaks(str)), filesize(str.size()), files(files) {}
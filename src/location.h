@@ -7,6 +7,7 @@
 class LocationTranslator {
 	const std::map<size_t, size_t> line_breaks;
 	const size_t filesize;
+	const std::map<size_t, std::string> files; //names of the files concatenated in the source by their offsets, empty for a single file
 
 	static std::map<size_t, size_t> get_line_breaks(const std::string& str);
 
@@ -15,7 +16,7 @@ public:
 	std::string operator()(size_t pos) const;
 
 	LocationTranslator() = delete;
-	LocationTranslator(const std::string& str);
+	LocationTranslator(const std::string& str, const std::map<size_t, std::string>& files = {});
 };
 
 #endif
@@ -0,0 +1,250 @@
+#include "loop_unroller.h"
+#include "helper_visitors.h"
+#include "profile.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <set>
+
+using namespace ProgramTree;
+using namespace TypeChecker;
+
+namespace {
+	//maximal size of the unrolled body, in tree nodes
+	const size_t UNROLLED_SIZE_LIMIT = 120;
+
+	//loops with a known trip count are replaced by copies of their body up to this size
+	const size_t FULL_UNROLL_SIZE_LIMIT = 200;
+
+	struct BodyInfo : public RecursiveVisitor {
+		size_t size;
+		bool has_loop;
+		std::set<std::string> written; //variables assigned, incremented, decremented or declared
+
+		virtual void visit_child(std::unique_ptr<Expression>& child) {
+			++size;
+			RecursiveVisitor::visit_child(child);
+		}
+
+		virtual void visit_child(std::unique_ptr<Statement>& child) {
+			++size;
+			RecursiveVisitor::visit_child(child);
+		}
+
+		void write(const std::unique_ptr<Expression>& var) {
+			Variable* v = get_node<Variable>(*var);
+			if(v) {
+				written.insert(v->name);
+			}
+		}
+
+		virtual void apply(Assignment& arg) {
+			write(arg.var);
+			RecursiveVisitor::apply(arg);
+		}
+
+		virtual void apply(Incrementation& arg) {
+			write(arg.var);
+			RecursiveVisitor::apply(arg);
+		}
+
+		virtual void apply(Decrementation& arg) {
+			write(arg.var);
+			RecursiveVisitor::apply(arg);
+		}
+
+		virtual void apply(Definition& arg) {
+			for(const auto& def : arg.defs) {
+				written.insert(def.first);
+			}
+			RecursiveVisitor::apply(arg);
+		}
+
+		virtual void apply(While& arg) {
+			has_loop = true;
+			RecursiveVisitor::apply(arg);
+		}
+
+		virtual void apply(For& arg) {
+			has_loop = true;
+			RecursiveVisitor::apply(arg);
+		}
+
+		BodyInfo() : size(1), has_loop(false) {}
+	};
+
+	const literal_type<LiteralType::Integer>::type* get_integer(const Expression& e) {
+		const literal_type<LiteralType::Integer>::type* result = nullptr;
+		LiteralGetter<LiteralType::Integer> lg(result);
+		e.visit(&lg);
+		return result;
+	}
+
+	//the value of the index before the loop, if it's set by the preceding statement
+	const literal_type<LiteralType::Integer>::type* get_start(Statement& prev, const std::string& index) {
+		Assignment* as = get_node<Assignment>(prev);
+		if(as) {
+			Variable* var = get_node<Variable>(*as->var);
+			return var && var->name == index ? get_integer(*as->value) : nullptr;
+		}
+		Definition* def = get_node<Definition>(prev);
+		if(def) {
+			for(const auto& d : def->defs) {
+				if(d.first == index && d.second) {
+					return get_integer(*d.second);
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	//variable the loop bound depends on, the bound itself has to be a literal, an int variable or the length of an array variable
+	bool get_bound_variable(Expression& e, const Variable*& result) {
+		result = get_node<Variable>(e);
+		if(result) {
+			return result->type == INT_TYPE;
+		}
+		ClassMember* member = get_node<ClassMember>(e);
+		if(member) {
+			result = get_node<Variable>(*member->object);
+			return result && member->member == LENGTH_ATTR_NAME && is_array(result->type);
+		}
+		return get_integer(e);
+	}
+
+	//loops the profile says never ran or ran fewer iterations per entry than the factor aren't worth the code
+	bool worth_unrolling(const std::shared_ptr<ProfileCounters>& profile, size_t factor) {
+		if(!profile || profile->counts.empty()) {
+			return true;
+		}
+		return profile->counts[0] && profile->counts[1] >= profile->counts[0] * factor;
+	}
+
+	class LoopUnroller : public RecursiveVisitor {
+		const size_t factor;
+		const Statement* current;
+		Statement* previous;
+
+		size_t limit_factor(size_t body_size) {
+			return std::min(factor, UNROLLED_SIZE_LIMIT / body_size);
+		}
+
+	public:
+		virtual void apply(Block& arg) {
+			for(size_t i = 0; i < arg.statements.size(); ++i) {
+				current = arg.statements[i].get();
+				previous = i ? arg.statements[i - 1].get() : nullptr;
+				visit_child(arg.statements[i]);
+			}
+		}
+
+		//while(i < bound) {...; i++;}, where the body doesn't write to i and the bound
+		virtual void apply(While& arg) {
+			Statement* prev = current == &arg ? previous : nullptr;
+			RecursiveVisitor::apply(arg);
+			if(factor < 2 || arg.vector_loop) {
+				return;
+			}
+			auto lt = get_node<BinaryOperator<BinOpType::LessThan>>(*arg.condition);
+			auto le = get_node<BinaryOperator<BinOpType::LessEqual>>(*arg.condition);
+			if(!lt && !le) {
+				return;
+			}
+			Expression& bound = lt ? *lt->right : *le->right;
+			Variable* index = get_node<Variable>(lt ? *lt->left : *le->left);
+			const Variable* bound_var;
+			if(!index || index->type != INT_TYPE || !get_bound_variable(bound, bound_var)) {
+				return;
+			}
+			Block* body = get_node<Block>(*arg.action);
+			if(!body || body->statements.empty()) {
+				return;
+			}
+			Incrementation* inc = get_node<Incrementation>(*body->statements.back());
+			Variable* inc_var = inc ? get_node<Variable>(*inc->var) : nullptr;
+			if(!inc_var || inc_var->name != index->name) {
+				return;
+			}
+			BodyInfo bi;
+			for(size_t i = 0; i + 1 < body->statements.size(); ++i) {
+				body->statements[i]->visit(&bi);
+			}
+			if(bi.has_loop || bi.written.count(index->name) || (bound_var && bi.written.count(bound_var->name))) {
+				return;
+			}
+			auto u = std::make_shared<LoopUnrolling>();
+			u->index = index;
+			u->bound = &bound;
+			u->inclusive = le;
+			u->loop = true;
+			u->remainder = true;
+			u->factor = limit_factor(bi.size + 2);
+			const literal_type<LiteralType::Integer>::type* start = prev ? get_start(*prev, index->name) : nullptr;
+			const literal_type<LiteralType::Integer>::type* end = get_integer(bound);
+			if(start && end) {
+				if(*start > *end || (*start == *end && !u->inclusive)) {
+					return;
+				}
+				uint64_t trips = (uint64_t) *end - (uint64_t) *start + (u->inclusive ? 1 : 0);
+				if(trips && trips <= FULL_UNROLL_SIZE_LIMIT / (bi.size + 2)) {
+					u->factor = trips;
+					u->loop = false;
+					u->remainder = false;
+				} else {
+					for(size_t f = u->factor; f >= 2; --f) {
+						if(trips % f == 0) {
+							u->factor = f;
+							u->remainder = false;
+							break;
+						}
+					}
+				}
+			}
+			if(u->loop && (u->factor < 2 || !worth_unrolling(arg.profile, u->factor))) {
+				return;
+			}
+			arg.unrolling = u;
+		}
+
+		virtual void apply(For& arg) {
+			RecursiveVisitor::apply(arg);
+			if(factor < 2 || arg.vector_loop) {
+				return;
+			}
+			BodyInfo bi;
+			arg.action->visit(&bi);
+			if(bi.has_loop) {
+				return;
+			}
+			auto u = std::make_shared<LoopUnrolling>();
+			u->factor = limit_factor(bi.size + 1);
+			u->loop = true;
+			u->remainder = true;
+			u->index = nullptr;
+			u->bound = nullptr;
+			u->inclusive = false;
+			if(u->factor >= 2 && worth_unrolling(arg.profile, u->factor)) {
+				arg.unrolling = u;
+			}
+		}
+
+		LoopUnroller() = delete;
+		LoopUnroller(size_t factor) : factor(factor), current(nullptr), previous(nullptr) {}
+	};
+}
+
+namespace Optimizer {
+	void unroll_loops(const TypeInfo& info, size_t factor) {
+		LoopUnroller u(factor);
+		for(const auto& fun : info.functions) {
+			fun.second->data->body->visit(&u);
+		}
+		for(const auto& cl : info.classes) {
+			for(const auto& fun : cl.second->functions) {
+				if(fun->class_info == cl.second.get()) {
+					fun->data->body->visit(&u);
+				}
+			}
+		}
+	}
+}
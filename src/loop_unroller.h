@@ -0,0 +1,26 @@
+#ifndef LOOP_UNROLLER_H
+#define LOOP_UNROLLER_H
+
+#include "program_tree.h"
+#include "type_info_builder.h"
+
+namespace ProgramTree {
+	//the body of the loop is emitted 'factor' times per iteration of the unrolled loop, the original loop then runs the remaining iterations
+	struct LoopUnrolling {
+		size_t factor;
+		bool loop; //false if the loop is known to run exactly 'factor' times, the copies of the body then replace it
+		bool remainder; //false if the trip count is known to be a multiple of 'factor'
+		const Variable* index; //while(index < bound) or while(index <= bound), null in a for loop
+		const Expression* bound;
+		bool inclusive;
+	};
+}
+
+namespace Optimizer {
+	const size_t DEFAULT_UNROLL_FACTOR = 4;
+
+	//factor 1 disables the unrolling
+	void unroll_loops(const TypeChecker::TypeInfo& info, size_t factor);
+}
+
+#endif
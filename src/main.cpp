@@ -2,96 +2,791 @@
 #include "type_checker.h"
 #include "lexer.h"
 #include "backend.h"
+#include "assembler.h"
+#include "linker.h"
+#include "constant_propagation.h"
+#include "compile_time_evaluation.h"
+#include "escape_analysis.h"
+#include "vectorizer.h"
+#include "loop_unroller.h"
+#include "profile.h"
+#include "bytecode.h"
+#include "modules.h"
+#include "cache.h"
+#include "parallel.h"
 #include "location.h"
+#include "time_report.h"
+#include "helper_visitors.h"
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <exception>
+#include <memory>
 #include <errno.h>
 #include <cstring>
+#include <cstdlib>
+#include <map>
+#include <vector>
+#include <thread>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <spawn.h>
+#include <unistd.h>
 
-int main(int argc, char** argv) {
-	if(argc != 2) {
-		std::cout<<"USAGE: latc_x86_64 path_to_file.lat\n";
-		return 1;
+namespace {
+	const std::string UNROLL_OPTION = "--unroll=";
+	const std::string PROFILE_GENERATE_OPTION = "--profile-generate";
+	const std::string PROFILE_USE_OPTION = "--profile-use=";
+	const std::string EMIT_ASM_OPTION = "--emit=asm";
+	const std::string RUN_OPTION = "--run";
+	const std::string SHARDS_OPTION = "--shards=";
+	const std::string BACKEND_OPTION = "--backend=";
+	const std::string INTERPRET_OPTION = "--interpret";
+	const std::string CACHE_OPTION = "--cache=";
+	const std::string CACHE_STATISTICS_OPTION = "--cache-stats=";
+	const std::string JOBS_OPTION = "-j";
+	const std::string BATCH_OPTION = "--batch";
+	const std::string TIME_REPORT_OPTION = "--time-report";
+	const std::string JSON_REPORT = "json";
+	const std::string X86_64_BACKEND = "x86_64";
+	const std::string LLVM_BACKEND = "llvm";
+	const std::string RUNTIME = "lib/runtime.o";
+
+	struct Options {
+		std::vector<std::string> filenames; //the executable is named after the first one
+		size_t unroll_factor;
+		bool profile_generate;
+		std::string profile_use;
+		bool emit_asm;
+		bool run;
+		size_t shards; //0 lets the backend decide
+		std::string backend;
+		bool interpret;
+		std::string cache; //directory of the executables compiled before, empty if none
+		std::string cache_statistics; //the directory whose statistics are printed instead of compiling
+		size_t threads; //checking the types and generating the code of the functions, or compiling the programs of a batch
+		bool batch; //every file is a program of its own
+		std::string batch_list; //more programs of the batch, one per line, with their modules separated by spaces
+		bool time_report; //of every phase, after the messages
+		bool time_report_json;
+
+		Options() : unroll_factor(Optimizer::DEFAULT_UNROLL_FACTOR), profile_generate(false), emit_asm(false), run(false), shards(0), backend(X86_64_BACKEND), interpret(false), threads(1), batch(false), time_report(false), time_report_json(false) {}
+	};
+
+	bool parse_number(const std::string& s, size_t& result) {
+		if(s.empty() || s.find_first_not_of("0123456789") != std::string::npos || s.size() > 9) {
+			return false;
+		}
+		result = std::stoul(s);
+		return true;
 	}
-	std::stringstream s;
-	std::string si;
-	try {
-		std::string filename(argv[1]);
+
+	//every line ends with a line break
+	std::string read_source(const std::string& filename) {
 		if(filename.size() < 5 || filename.substr(filename.size() - 4) != ".lat") {
 			throw std::runtime_error("Expected .lat file!");
 		}
 		std::ifstream input;
 		input.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
 		input.open(filename);
-
 		input.exceptions(std::ifstream::badbit);
+		std::stringstream s;
+		std::string line;
+		while(std::getline(input, line)) {
+			s << line << '\n';
+		}
+		return s.str();
+	}
+
+	std::string read_file(const std::string& filename) {
+		std::ifstream input;
+		input.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+		input.open(filename, std::ios_base::binary);
+		std::ostringstream result;
+		result << input.rdbuf();
+		return result.str();
+	}
+
+	//the tool runs without a shell and writes each object to its standard output in memory, so nothing but the sources is left on the disk, all the sources are compiled at once
+	std::vector<std::string> compile_in_memory(const std::string& tool, const std::vector<std::string>& options, const std::vector<std::string>& sources) {
+		std::vector<int> objects;
+		std::vector<pid_t> pids;
+		bool success = true;
+		for(const std::string& source : sources) {
+			int object = memfd_create("object", 0);
+			if(object < 0) {
+				success = false;
+				break;
+			}
+			objects.push_back(object);
+			std::vector<std::string> args = options;
+			args.insert(args.begin(), tool);
+			args.push_back(source);
+			std::vector<char*> argv;
+			for(std::string& arg : args) {
+				argv.push_back(&arg[0]);
+			}
+			argv.push_back(nullptr);
+			posix_spawn_file_actions_t actions;
+			posix_spawn_file_actions_init(&actions);
+			posix_spawn_file_actions_adddup2(&actions, object, STDOUT_FILENO);
+			pid_t pid;
+			bool spawned = !posix_spawnp(&pid, argv[0], &actions, nullptr, argv.data(), environ);
+			posix_spawn_file_actions_destroy(&actions);
+			if(!spawned) {
+				success = false;
+				break;
+			}
+			pids.push_back(pid);
+		}
+		//every started process is waited for, even after a failure
+		for(pid_t pid : pids) {
+			int status;
+			success = waitpid(pid, &status, 0) == pid && WIFEXITED(status) && !WEXITSTATUS(status) && success;
+		}
+		std::vector<std::string> result(objects.size());
+		for(size_t i = 0; i < objects.size(); ++i) {
+			char buffer[1 << 16];
+			ssize_t size = 0;
+			while(success && (size = pread(objects[i], buffer, sizeof(buffer), result[i].size())) > 0) {
+				result[i].append(buffer, size);
+			}
+			success = success && size >= 0;
+			close(objects[i]);
+		}
+		if(!success) {
+			throw std::runtime_error(tool + " execution error.");
+		}
+		return result;
+	}
+
+	std::string assemble(const std::string& code, size_t& instructions) {
+		AssemblingBuffer buffer;
+		std::ostream input(&buffer);
+		input.write(code.data(), code.size());
+		std::ostringstream assembled;
+		buffer.write(assembled);
+		instructions = buffer.instructions();
+		return assembled.str();
+	}
+
+	//each shard is assembled in its own thread, the first error is rethrown, the instructions of all the shards are summed
+	std::vector<std::string> assemble(const std::vector<std::string>& shards, size_t& instructions) {
+		std::vector<std::string> result(shards.size());
+		std::vector<size_t> counts(shards.size());
+		std::vector<std::exception_ptr> errors(shards.size());
+		std::vector<std::thread> threads;
+		for(size_t i = 0; i < shards.size(); ++i) {
+			threads.emplace_back([&shards, &result, &counts, &errors, i]() {
+				try {
+					result[i] = assemble(shards[i], counts[i]);
+				} catch(...) {
+					errors[i] = std::current_exception();
+				}
+			});
+		}
+		for(std::thread& thread : threads) {
+			thread.join();
+		}
+		for(const std::exception_ptr& error : errors) {
+			if(error) {
+				std::rethrow_exception(error);
+			}
+		}
+		instructions = 0;
+		for(size_t count : counts) {
+			instructions += count;
+		}
+		return result;
+	}
+
+	//statements and expressions of the function bodies and the fields, for the time report
+	class NodeCounter : public ProgramTree::RecursiveVisitor {
+	public:
+		size_t nodes;
+
+		virtual void visit_child(std::unique_ptr<ProgramTree::Expression>& child) {
+			++nodes;
+			RecursiveVisitor::visit_child(child);
+		}
+
+		virtual void visit_child(std::unique_ptr<ProgramTree::Statement>& child) {
+			++nodes;
+			RecursiveVisitor::visit_child(child);
+		}
+
+		void count(ProgramTree::Function& function) {
+			++nodes;
+			function.body->visit(this);
+		}
+
+		NodeCounter() : nodes(0) {}
+	};
+
+	void count_program(const ProgramTree::Program& program, TimeReport& report) {
+		NodeCounter counter;
+		size_t functions = program.functions.size();
+		for(const auto& fun : program.functions) {
+			counter.count(*fun);
+		}
+		for(const auto& cl : program.classes) {
+			functions += cl->functions.size();
+			for(const auto& fun : cl->functions) {
+				counter.count(*fun);
+			}
+			for(const auto& variable : cl->variables) {
+				++counter.nodes;
+				variable->visit(&counter);
+			}
+		}
+		report.count("classes", program.classes.size());
+		report.count("functions", functions);
+		report.count("ast_nodes", counter.nodes);
+	}
+
+	//a rebuilt compiler or another unroll factor may give different code for the same source
+	std::string compiler_identity(const Options& options) {
+		std::string result = "latc_x86_64";
+		struct stat compiler;
+		if(!stat("/proc/self/exe", &compiler)) {
+			result += ' ' + std::to_string(compiler.st_size) + ' ' + std::to_string(compiler.st_mtim.tv_sec) + '.' + std::to_string(compiler.st_mtim.tv_nsec);
+		}
+		return result + " unroll " + std::to_string(options.unroll_factor) + '\n';
+	}
+
+	//everything the executable is made of: the compiler and its options, the profile, the runtime and the sources, but not their names
+	//the runtime shared by a batch, or the one on the disk
+	std::string runtime_object(const std::string* runtime) {
+		return runtime ? *runtime : read_file(RUNTIME);
+	}
 
-		while (std::getline(input, si)) {
-		  s << si << '\n';
+	uint64_t cache_key(const Options& options, const std::vector<Modules::Module>& modules, const std::string* runtime) {
+		//the number of threads doesn't change the output
+		std::string key = compiler_identity(options) + "backend " + options.backend + "\nshards " + std::to_string(options.shards) + '\n';
+		//the instrumented program writes its profile next to the source
+		if(options.profile_generate) {
+			char* path = realpath(options.filenames[0].data(), nullptr);
+			if(path) {
+				key += "profile-generate " + std::string(path) + '\n';
+				free(path);
+			}
 		}
-		si = s.str();
+		//an unreadable profile fails the compilation, which stores nothing
+		if(!options.profile_use.empty()) {
+			try {
+				std::string profile = read_file(options.profile_use);
+				key += "profile-use " + std::to_string(profile.size()) + '\n' + profile;
+			} catch(const std::ios_base::failure&) {
+			}
+		}
+		std::string object = runtime_object(runtime);
+		key += "runtime " + std::to_string(object.size()) + '\n' + object;
+		for(const Modules::Module& module : modules) {
+			key += "module " + std::to_string(module.source.size()) + '\n' + module.source;
+		}
+		return Optimizer::source_checksum(key);
+	}
 
-		input.close();
+	//read once, it can't be read without being changed for a moment
+	mode_t file_mask() {
+		static const mode_t mask = []() {
+			mode_t mask = umask(0);
+			umask(mask);
+			return mask;
+		}();
+		return mask;
+	}
 
-		filename.resize(filename.size() - 2);
-		filename[filename.size() - 1] = 's';
+	void make_executable(const std::string& filename) {
+		if(chmod(filename.data(), 0777 & ~file_mask())) {
+			throw std::runtime_error("Can't make " + filename + " executable.");
+		}
+	}
 
-		auto t = tokenize(si);
-		auto p = parse(t);
-		auto f = TypeChecker::check_types(p);
+	//the object is valid if the first line of the interface kept with it has the expected key
+	bool read_cached_object(const std::string& filename, const std::string& key, std::string& object) {
+		try {
+			std::string interface = read_file(filename + ".interface");
+			if(interface.compare(0, key.size(), key) != 0) {
+				return false;
+			}
+			object = read_file(filename + ".o");
+			return true;
+		} catch(const std::ios_base::failure&) {
+			return false;
+		}
+	}
 
+	void write_file(const std::string& filename, const std::string& content) {
 		std::ofstream output;
 		output.exceptions(std::ofstream::failbit | std::ofstream::badbit);
-		output.open(filename, std::ios_base::trunc);
+		output.open(filename, std::ios_base::trunc | std::ios_base::binary);
+		output << content;
+		output.close();
+	}
 
-		emit_code(f, output);
+	//each module's object and interface are kept next to its source, it's compiled again only if its source, the interfaces of the modules it depends on or the compiler change
+	std::vector<std::string> compile_modules(const TypeChecker::TypeInfo& info, const std::vector<Modules::Module>& modules, const std::string& sources, const Optimizer::EscapeSummary& escapes, const Options& options, TimeReport& report) {
+		std::vector<std::string> interfaces;
+		for(const Modules::Module& module : modules) {
+			interfaces.push_back(Modules::interface(info, module, sources, escapes));
+		}
+		std::string compiler = compiler_identity(options);
+		std::vector<std::string> objects(modules.size());
+		std::vector<std::string> keys;
+		std::vector<size_t> stale;
+		std::vector<std::string> codes;
+		for(size_t i = 0; i < modules.size(); ++i) {
+			std::string key = compiler + modules[i].source + interfaces[i];
+			for(size_t dependency : Modules::dependencies(info, modules, i)) {
+				key += modules[dependency].filename + '\n' + interfaces[dependency];
+			}
+			std::ostringstream line;
+			line << "key " << std::hex << Optimizer::source_checksum(key) << '\n';
+			keys.push_back(line.str());
+			if(read_cached_object(modules[i].filename, keys[i], objects[i])) {
+				continue;
+			}
+			stale.push_back(i);
+			std::ostringstream code;
+			emit_module_code(info, modules[i].functions, modules[i].classes, code, options.threads);
+			codes.push_back(code.str());
+		}
+		size_t instructions;
+		std::vector<std::string> assembled = assemble(codes, instructions);
+		report.count("compiled_modules", stale.size());
+		report.count("instructions", instructions);
+		//the old key is dropped before the object is replaced, so that an interrupted write leaves no valid key
+		for(size_t i = 0; i < stale.size(); ++i) {
+			const Modules::Module& module = modules[stale[i]];
+			objects[stale[i]] = std::move(assembled[i]);
+			write_file(module.filename + ".interface", "");
+			write_file(module.filename + ".o", objects[stale[i]]);
+			write_file(module.filename + ".interface", keys[stale[i]] + interfaces[stale[i]]);
+		}
+		return objects;
+	}
 
-		output.close();
+	bool valid_options(const Options& options) {
+		//profiles, assembly and its shards belong to the x86_64 backend
+		bool llvm_conflict = options.backend == LLVM_BACKEND && (options.profile_generate || !options.profile_use.empty() || options.emit_asm || options.shards);
+		//the interpreter doesn't produce any code
+		bool interpret_conflict = options.interpret && (options.profile_generate || !options.profile_use.empty() || options.emit_asm || options.run || options.shards || options.backend != X86_64_BACKEND);
+		//modules are compiled to objects of their own, a profile and the assembly belong to a single source
+		bool modules_conflict = options.filenames.size() > 1 && (options.profile_generate || !options.profile_use.empty() || options.emit_asm || options.shards || options.backend != X86_64_BACKEND);
+		//the cache keeps executables only, the assembly wouldn't be written on a hit
+		bool cache_conflict = !options.cache.empty() && (options.interpret || options.emit_asm);
+		return !options.filenames.empty() && !cache_conflict && !(options.profile_generate && !options.profile_use.empty()) && !llvm_conflict && !interpret_conflict && !modules_conflict;
+	}
 
-		if(system(("nasm -f elf64 " + filename).data())) {
-			throw std::runtime_error("nasm execution error.");
+	bool parse_options(int argc, char** argv, Options& options) {
+		for(int i = 1; i < argc; ++i) {
+			std::string arg(argv[i]);
+			if(arg.compare(0, UNROLL_OPTION.size(), UNROLL_OPTION) == 0) {
+				if(!parse_number(arg.substr(UNROLL_OPTION.size()), options.unroll_factor) || !options.unroll_factor) {
+					return false;
+				}
+			} else if(arg == PROFILE_GENERATE_OPTION) {
+				options.profile_generate = true;
+			} else if(arg.compare(0, PROFILE_USE_OPTION.size(), PROFILE_USE_OPTION) == 0) {
+				options.profile_use = arg.substr(PROFILE_USE_OPTION.size());
+				if(options.profile_use.empty()) {
+					return false;
+				}
+			} else if(arg == EMIT_ASM_OPTION) {
+				options.emit_asm = true;
+			} else if(arg == RUN_OPTION) {
+				options.run = true;
+			} else if(arg.compare(0, SHARDS_OPTION.size(), SHARDS_OPTION) == 0) {
+				if(!parse_number(arg.substr(SHARDS_OPTION.size()), options.shards) || !options.shards) {
+					return false;
+				}
+			} else if(arg.compare(0, BACKEND_OPTION.size(), BACKEND_OPTION) == 0) {
+				options.backend = arg.substr(BACKEND_OPTION.size());
+				if(options.backend != X86_64_BACKEND && options.backend != LLVM_BACKEND) {
+					return false;
+				}
+			} else if(arg == INTERPRET_OPTION) {
+				options.interpret = true;
+			} else if(arg == BATCH_OPTION) {
+				options.batch = true;
+			} else if(arg.compare(0, BATCH_OPTION.size() + 1, BATCH_OPTION + '=') == 0) {
+				options.batch = true;
+				options.batch_list = arg.substr(BATCH_OPTION.size() + 1);
+				if(options.batch_list.empty()) {
+					return false;
+				}
+			} else if(arg == TIME_REPORT_OPTION) {
+				options.time_report = true;
+			} else if(arg == TIME_REPORT_OPTION + '=' + JSON_REPORT) {
+				options.time_report = true;
+				options.time_report_json = true;
+			} else if(arg.compare(0, JOBS_OPTION.size(), JOBS_OPTION) == 0) {
+				if(!parse_number(arg.substr(JOBS_OPTION.size()), options.threads) || !options.threads) {
+					return false;
+				}
+			} else if(arg.compare(0, CACHE_OPTION.size(), CACHE_OPTION) == 0) {
+				options.cache = arg.substr(CACHE_OPTION.size());
+				if(options.cache.empty()) {
+					return false;
+				}
+			} else if(arg.compare(0, CACHE_STATISTICS_OPTION.size(), CACHE_STATISTICS_OPTION) == 0) {
+				options.cache_statistics = arg.substr(CACHE_STATISTICS_OPTION.size());
+				if(options.cache_statistics.empty() || argc != 2) {
+					return false;
+				}
+				return true;
+			} else {
+				options.filenames.push_back(arg);
+			}
+		}
+		//the programs of a batch are checked one by one, none of them may replace the compiler, their times can't be told apart
+		if(options.batch) {
+			return (!options.filenames.empty() || !options.batch_list.empty()) && !options.run && !options.interpret && !options.time_report;
 		}
+		return valid_options(options);
+	}
+
+	//the memory is left for the system to reclaim at once when the process ends
+	template<typename T>
+	void abandon(T&& object) {
+		new T(std::move(object));
+	}
+
+	//compiles a program made of the given modules, the messages go to the given streams, returns the exit code
+	int compile(const Options& options, const std::string* runtime, std::ostream& out, std::ostream& diagnostics) {
+		std::string si;
+		//errors of a program made of many modules name the file
+		std::map<size_t, std::string> files;
+		TimeReport report;
+		//printed after the messages, or before the compiler is replaced by the program
+		auto print_report = [&options, &report, &diagnostics]() {
+			if(options.time_report) {
+				report.print(diagnostics, options.time_report_json);
+			}
+		};
+		try {
+			report.start("read");
+			std::vector<Modules::Module> modules;
+			for(const std::string& name : options.filenames) {
+				std::string source = read_source(name);
+				modules.push_back({name.substr(0, name.size() - 4), source, si.size(), {}, {}, {}});
+				if(options.filenames.size() > 1) {
+					files[si.size()] = name;
+				}
+				si += source;
+			}
+			if(si.size() > ProgramTree::MAX_SOURCE_SIZE) {
+				throw std::runtime_error("The sources are too big.");
+			}
+			std::string filename = modules[0].filename;
+			report.count("modules", modules.size());
+			report.count("bytes", si.size());
+
+			//a hit skips the whole compilation
+			std::unique_ptr<CompilationCache> cache;
+			uint64_t key = 0;
+			if(!options.cache.empty()) {
+				report.start("cache");
+				cache.reset(new CompilationCache(options.cache));
+				key = cache_key(options, modules, runtime);
+				std::string cached = cache->find(key);
+				if(!cached.empty() && options.run) {
+					print_report();
+					std::cout.flush();
+					std::cerr.flush();
+					char* args[] = {&cached[0], nullptr};
+					execv(args[0], args);
+					throw std::runtime_error("Can't run " + cached + ".");
+				}
+				if(!cached.empty()) {
+					write_file(filename, read_file(cached));
+					make_executable(filename);
+					diagnostics << "OK\n";
+					print_report();
+					return 0;
+				}
+			}
+
+			//the nodes of the tree are freed all at once with their arena
+			Arena::Scope arena(std::make_shared<Arena>());
+			report.start("tokenize");
+			auto tokens = Modules::tokenize_modules(modules);
+			size_t token_count = 0;
+			for(const auto& module_tokens : tokens) {
+				token_count += module_tokens.size();
+			}
+			report.count("tokens", token_count);
+			report.start("parse");
+			auto p = Modules::parse_modules(modules, tokens);
+			count_program(p, report);
+			report.start("build_program_info");
+			auto f = TypeChecker::build_program_info(p);
+			report.start("check_types");
+			TypeChecker::check_types(f, options.threads);
 
-		filename.resize(filename.size() - 2);
+			//only the cheap optimization runs before the interpretation, the program starts right away
+			if(options.interpret) {
+				report.start("propagate_constants");
+				Optimizer::propagate_constants(f);
+				report.start("compile_bytecode");
+				Bytecode::Program program = Bytecode::compile(f);
+				report.count("instructions", program.code.size());
+				print_report();
+				std::cout.flush();
+				std::cerr.flush();
+				Bytecode::interpret(program);
+			}
 
-		if(system(("ld -o " + filename + " " + filename + ".o lib/runtime.o").data())) {
-			throw std::runtime_error("ld execution error.");
+			report.start("instrumentation");
+			Optimizer::Instrumentation instrumentation;
+			instrumentation.checksum = Optimizer::source_checksum(si);
+			instrumentation.counters = Optimizer::assign_counters(f);
+			if(!options.profile_use.empty()) {
+				instrumentation.filename = options.profile_use;
+				Optimizer::read_profile(f, instrumentation);
+			} else if(options.profile_generate) {
+				//the program may run in another directory
+				char* path = realpath(options.filenames[0].data(), nullptr);
+				if(!path) {
+					throw std::runtime_error("Can't resolve the path of the program.");
+				}
+				instrumentation.filename = path;
+				free(path);
+				instrumentation.filename.resize(instrumentation.filename.size() - 4);
+				instrumentation.filename += ".profile";
+			}
+
+			report.start("propagate_constants");
+			Optimizer::propagate_constants(f);
+			report.start("evaluate_pure_calls");
+			Optimizer::evaluate_pure_calls(f);
+			report.start("propagate_constants");
+			Optimizer::propagate_constants(f);
+			report.start("optimize_allocations");
+			Optimizer::EscapeSummary escapes = Optimizer::optimize_allocations(f);
+			//instrumented builds keep the loops as they are written so that the counts match them, LLVM has loop optimizations of its own
+			if(!options.profile_generate && options.backend == X86_64_BACKEND) {
+				report.start("vectorize_loops");
+				Optimizer::vectorize_loops(f);
+				report.start("unroll_loops");
+				Optimizer::unroll_loops(f, options.unroll_factor);
+			}
+
+			std::ofstream output;
+			output.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+			//big programs are split into shards assembled in parallel, the first one is the program.s or the one assembled while it's generated
+			const Optimizer::Instrumentation* instrumented = options.profile_generate ? &instrumentation : nullptr;
+			size_t shards = options.shards ? options.shards : count_shards(f);
+			//the assembly is kept for reading and assembled by nasm, otherwise it's assembled in memory, the LLVM IR is always kept and compiled by clang
+			std::vector<std::string> objects;
+			if(modules.size() > 1) {
+				report.start("compile_modules");
+				objects = compile_modules(f, modules, si, escapes, options, report);
+			} else if(options.backend == LLVM_BACKEND) {
+				report.start("emit_llvm_ir");
+				output.open(filename + ".ll", std::ios_base::trunc);
+				emit_llvm_ir(f, output);
+				output.close();
+
+				report.start("clang");
+				objects = compile_in_memory("clang", {"-O2", "-c", "-fno-pic", "-o", "-"}, {filename + ".ll"});
+			} else if(options.emit_asm) {
+				report.start("emit_code");
+				std::vector<std::string> sources;
+				std::vector<std::unique_ptr<std::ofstream>> files;
+				std::vector<std::ostream*> outputs;
+				for(size_t i = 0; i < shards; ++i) {
+					sources.push_back(filename + (i ? "." + std::to_string(i) : "") + ".s");
+					files.emplace_back(new std::ofstream);
+					files.back()->exceptions(std::ofstream::failbit | std::ofstream::badbit);
+					files.back()->open(sources.back(), std::ios_base::trunc);
+					outputs.push_back(files.back().get());
+				}
+				emit_code(f, outputs, instrumented, options.threads);
+				for(auto& file : files) {
+					file->close();
+				}
+
+				report.start("nasm");
+				objects = compile_in_memory("nasm", {"-f", "elf64", "-o", "/dev/stdout"}, sources);
+			} else if(shards == 1) {
+				//the code is assembled while it's generated
+				report.start("emit_code");
+				AssemblingBuffer buffer;
+				std::ostream code(&buffer);
+				emit_code(f, code, instrumented, options.threads);
+				std::ostringstream assembled;
+				buffer.write(assembled);
+				objects.push_back(assembled.str());
+				report.count("instructions", buffer.instructions());
+			} else {
+				report.start("emit_code");
+				std::vector<std::ostringstream> codes(shards);
+				std::vector<std::ostream*> outputs;
+				for(std::ostringstream& code : codes) {
+					outputs.push_back(&code);
+				}
+				emit_code(f, outputs, instrumented, options.threads);
+				std::vector<std::string> sources;
+				for(std::ostringstream& code : codes) {
+					sources.push_back(code.str());
+				}
+				report.start("assemble");
+				size_t instructions;
+				objects = assemble(sources, instructions);
+				report.count("shards", shards);
+				report.count("instructions", instructions);
+			}
+			report.start("link");
+			objects.push_back(runtime_object(runtime));
+
+			//a cached executable is linked once, for the cache and for the output
+			std::string executable;
+			if(cache) {
+				std::ostringstream linked;
+				link(objects, linked);
+				executable = linked.str();
+				cache->store(key, executable);
+			}
+
+			//the program replaces the compiler, which has nothing more to say
+			if(options.run) {
+				print_report();
+				std::cout.flush();
+				std::cerr.flush();
+				run(objects);
+			}
+
+			if(cache) {
+				write_file(filename, executable);
+			} else {
+				output.open(filename, std::ios_base::trunc | std::ios_base::binary);
+				link(objects, output);
+				output.close();
+			}
+			make_executable(filename);
+
+			//the process ends right after a single compilation, the programs of a batch are destroyed one by one to keep the memory low
+			if(!options.batch) {
+				abandon(std::move(f));
+				abandon(std::move(p));
+			}
+
+			diagnostics << "OK\n";
+			print_report();
+			return 0;
+		} catch (const LexerException& e) {
+			LocationTranslator lt(si, files);
+			diagnostics << "ERROR\n" << "Unrecognized token at " << lt(e.pos) << '\n';
+			return 1;
+		} catch (const ParserException& e) {
+			LocationTranslator lt(si, files);
+			diagnostics << "ERROR\n";
+			e(diagnostics, lt);
+			return 1;
+		} catch (const TypeChecker::TypeCheckerException& e) {
+			diagnostics << "ERROR\n" << "Type checker error, details:\n";
+			LocationTranslator lt(si, files);
+			for(const TypeChecker::TypeCheckerError& err : e.errors) {
+				err(diagnostics, lt);
+			}
+			return 1;
+		} catch (const std::ios_base::failure&) {
+			out << "ERROR\nIO Error!\n" << std::strerror(errno) << '\n';
+			return 1;
+		} catch (const std::exception& e) {
+			diagnostics << "ERROR\nDetails:\n" << e.what() << '\n';
+			return 1;
+		} catch (...) {
+			diagnostics << "ERROR\nSomething went horribly wrong.\n";
+			return 1;
 		}
+	}
 
-		if(system(("rm " + filename + ".o").data())) {
-			throw std::runtime_error("cleanup error.");
+	//every program gets one thread of the pool, the runtime is read once for all of them, the messages are reported in the order of the programs
+	int compile_batch(const Options& options) {
+		std::vector<std::vector<std::string>> programs;
+		for(const std::string& filename : options.filenames) {
+			programs.push_back({filename});
+		}
+		if(!options.batch_list.empty()) {
+			try {
+				std::istringstream list(read_file(options.batch_list));
+				std::string line;
+				while(std::getline(list, line)) {
+					std::istringstream modules(line);
+					std::vector<std::string> program;
+					std::string module;
+					while(modules >> module) {
+						program.push_back(module);
+					}
+					if(!program.empty()) {
+						programs.push_back(std::move(program));
+					}
+				}
+			} catch(const std::ios_base::failure&) {
+				std::cerr << "ERROR\nCan't read the list " << options.batch_list << ".\n";
+				return 1;
+			}
+		}
+		std::string runtime;
+		try {
+			runtime = read_file(RUNTIME);
+		} catch(const std::ios_base::failure&) {
+			std::cerr << "ERROR\nCan't read " << RUNTIME << ".\n";
+			return 1;
 		}
+		std::vector<std::ostringstream> reports(programs.size());
+		std::vector<int> results(programs.size());
+		parallel_for(programs.size(), options.threads, [&](size_t i) {
+			Options program = options;
+			program.filenames = programs[i];
+			program.threads = 1;
+			if(!valid_options(program)) {
+				reports[i] << "ERROR\nThe options don't apply to this program.\n";
+				results[i] = 1;
+				return;
+			}
+			results[i] = compile(program, &runtime, reports[i], reports[i]);
+		});
+		int result = 0;
+		for(size_t i = 0; i < programs.size(); ++i) {
+			for(size_t j = 0; j < programs[i].size(); ++j) {
+				std::cerr << (j ? " " : "") << programs[i][j];
+			}
+			std::cerr << ":\n" << reports[i].str();
+			result = std::max(result, results[i]);
+		}
+		return result;
+	}
+}
 
-		std::cerr << "OK\n";
-		return 0;
-	} catch (const LexerException& e) {
-		LocationTranslator lt(si);
-		std::cerr << "ERROR\n" << "Unrecognized token at " << lt(e.pos) << '\n';
-		return 1;
-	} catch (const ParserException& e) {
-		LocationTranslator lt(si);
-		std::cerr << "ERROR\n";
-		e(std::cerr, lt);
+int main(int argc, char** argv) {
+	Options options;
+	if(!parse_options(argc, argv, options)) {
+		std::cout<<"USAGE: latc_x86_64 [--unroll=factor] [--profile-generate | --profile-use=file] [--emit=asm] [--run] [--shards=count] [--backend=x86_64|llvm] [--interpret] [--cache=directory] [-jthreads] [--time-report[=json]] path_to_file.lat [more_modules.lat...]\n";
+		std::cout<<"       latc_x86_64 --batch[=list] [options] [path_to_file.lat...]\n";
+		std::cout<<"       latc_x86_64 --cache-stats=directory\n";
 		return 1;
-	} catch (const TypeChecker::TypeCheckerException& e) {
-		std::cerr << "ERROR\n" << "Type checker error, details:\n";
-		LocationTranslator lt(si);
-		for(const TypeChecker::TypeCheckerError& err : e.errors) {
-			err(std::cerr, lt);
+	}
+	//files created by the threads of a batch can't wait for the mask to be read back
+	file_mask();
+	if(!options.cache_statistics.empty()) {
+		try {
+			CompilationCache::Statistics statistics = CompilationCache(options.cache_statistics).statistics();
+			std::cout << "hits " << statistics.hits << "\nmisses " << statistics.misses << "\nentries " << statistics.entries << "\nbytes " << statistics.bytes << '\n';
+			return 0;
+		} catch (const std::exception& e) {
+			std::cerr << "ERROR\nDetails:\n" << e.what() << '\n';
+			return 1;
 		}
-		return 1;
-	} catch (const std::ios_base::failure&) {
-		std::cout << "ERROR\nIO Error!\n" << std::strerror(errno) << '\n';
-		return 1;
-	} catch (const std::exception& e) {
-		std::cerr << "ERROR\nDetails:\n" << e.what() << '\n';
-		return 1;
-	} catch (...) {
-		std::cerr << "ERROR\nSomething went horribly wrong.\n";
-		return 1;
 	}
+	if(options.batch) {
+		return compile_batch(options);
+	}
+	return compile(options, nullptr, std::cout, std::cerr);
 }
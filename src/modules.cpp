@@ -0,0 +1,141 @@
+#include "modules.h"
+#include "lexer.h"
+#include "parser.h"
+#include "profile.h"
+
+#include <map>
+#include <sstream>
+
+using namespace ProgramTree;
+using namespace TypeChecker;
+
+namespace {
+	void print_signature(std::ostream& output, const FunctionInfo& fun, const Optimizer::EscapeSummary& escapes) {
+		output << fun.return_type << ' ' << fun.data->name << '(';
+		for(size_t i = 0; i < fun.args.size(); ++i) {
+			output << (i ? "," : "") << fun.args[i].first;
+		}
+		output << ')' << (fun.side_effects ? " effects" : " pure") << " escapes ";
+		for(bool escaping : escapes.at(fun.data.get())) {
+			output << escaping;
+		}
+	}
+
+	//the direct dependencies of every module: the ones defining the functions and classes it names, and the ones extending its classes, whose methods its virtual calls may end up in
+	std::vector<std::set<size_t>> direct_dependencies(const TypeInfo& info, const std::vector<Modules::Module>& modules) {
+		std::map<std::string, size_t> definitions;
+		for(size_t i = 0; i < modules.size(); ++i) {
+			for(const std::string& fun : modules[i].functions) {
+				definitions[fun] = i;
+			}
+			for(const std::string& cl : modules[i].classes) {
+				definitions[cl] = i;
+			}
+		}
+		std::vector<std::set<size_t>> result(modules.size());
+		for(size_t i = 0; i < modules.size(); ++i) {
+			for(const std::string& name : modules[i].names) {
+				auto definition = definitions.find(name);
+				if(definition != definitions.end() && definition->second != i) {
+					result[i].insert(definition->second);
+				}
+			}
+			for(const std::string& cl : modules[i].classes) {
+				const std::string& superclass = info.classes.at(cl)->data->superclass;
+				auto definition = definitions.find(superclass);
+				if(!superclass.empty() && definition != definitions.end() && definition->second != i) {
+					result[definition->second].insert(i);
+				}
+			}
+		}
+		return result;
+	}
+}
+
+namespace Modules {
+	std::vector<std::vector<Token>> tokenize_modules(std::vector<Module>& modules) {
+		std::vector<std::vector<Token>> result;
+		for(Module& module : modules) {
+			result.emplace_back();
+			try {
+				for(Token& token : tokenize(module.source)) {
+					result.back().emplace_back(token.type, std::move(token.data), token.pos + module.offset);
+					result.back().back().symbol = token.symbol;
+				}
+			} catch(const LexerException& e) {
+				throw LexerException(e.pos + module.offset);
+			}
+			for(const Token& token : result.back()) {
+				if(token.type == Token::Type::NAME) {
+					module.names.insert(token.data);
+				}
+			}
+		}
+		return result;
+	}
+
+	Program parse_modules(std::vector<Module>& modules, std::vector<std::vector<Token>>& tokens) {
+		std::vector<std::shared_ptr<Class>> classes;
+		std::vector<std::shared_ptr<Function>> functions;
+		for(size_t i = 0; i < modules.size(); ++i) {
+			Program program = parse(tokens[i]);
+			for(auto& cl : program.classes) {
+				modules[i].classes.insert(cl->name);
+				classes.push_back(std::move(cl));
+			}
+			for(auto& fun : program.functions) {
+				modules[i].functions.insert(fun->name);
+				functions.push_back(std::move(fun));
+			}
+		}
+		return Program(std::move(classes), std::move(functions));
+	}
+
+	std::string interface(const TypeInfo& info, const Module& module, const std::string& sources, const Optimizer::EscapeSummary& escapes) {
+		std::ostringstream result;
+		for(const std::string& name : module.classes) {
+			const ClassInfo& cl = *info.classes.at(name);
+			result << "class " << name;
+			if(!cl.data->superclass.empty()) {
+				result << " extends " << cl.data->superclass;
+			}
+			result << '\n';
+			for(const auto& variable : cl.variables) {
+				result << "field " << variable.first << ' ' << variable.second << '\n';
+			}
+			for(size_t i = 0; i < cl.functions.size(); ++i) {
+				result << "method " << i << ' ' << cl.functions[i]->class_info->data->name << ' ';
+				print_signature(result, *cl.functions[i], escapes);
+				result << '\n';
+			}
+		}
+		for(const std::string& name : module.functions) {
+			const FunctionInfo& fun = *info.functions.at(name);
+			result << "function ";
+			print_signature(result, fun, escapes);
+			//calls with constant arguments are evaluated in the callers
+			if(!fun.side_effects && fun.return_type != VOID_TYPE) {
+				size_t begin = fun.data->dec_begin;
+				result << " source " << std::hex << Optimizer::source_checksum(sources.substr(begin, fun.data->body->end - begin)) << std::dec;
+			}
+			result << '\n';
+		}
+		return result.str();
+	}
+
+	std::set<size_t> dependencies(const TypeInfo& info, const std::vector<Module>& modules, size_t module) {
+		std::vector<std::set<size_t>> direct = direct_dependencies(info, modules);
+		std::set<size_t> result;
+		std::vector<size_t> stack = {module};
+		while(!stack.empty()) {
+			size_t current = stack.back();
+			stack.pop_back();
+			for(size_t dependency : direct[current]) {
+				if(dependency != module && result.insert(dependency).second) {
+					stack.push_back(dependency);
+				}
+			}
+		}
+		return result;
+	}
+}
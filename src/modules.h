@@ -0,0 +1,37 @@
+#ifndef MODULES_H
+#define MODULES_H
+
+#include "program_tree.h"
+#include "type_info_builder.h"
+#include "escape_analysis.h"
+#include "lexer.h"
+
+#include <set>
+#include <string>
+#include <vector>
+
+namespace Modules {
+	//a source file of a program made of many, compiled to an object of its own
+	struct Module {
+		std::string filename; //without the extension
+		std::string source;
+		size_t offset; //of the source in the concatenation of all the sources, the positions in the tree point there
+		std::set<std::string> names; //identifiers used in the source, to be set by the tokenizer
+		std::set<std::string> functions; //global functions defined in the source, to be set by the parser
+		std::set<std::string> classes; //to be set by the parser
+	};
+
+	//tokenizes every module on its own, the positions of the tokens point into the concatenated sources
+	std::vector<std::vector<Token>> tokenize_modules(std::vector<Module>& modules);
+
+	//parses every module on its own and merges them into one program
+	ProgramTree::Program parse_modules(std::vector<Module>& modules, std::vector<std::vector<Token>>& tokens);
+
+	//what the code of other modules may depend on: class layouts, vtable slots, function signatures, what the optimizer knows about the functions and the source of those it may evaluate at compile time
+	std::string interface(const TypeChecker::TypeInfo& info, const Module& module, const std::string& sources, const Optimizer::EscapeSummary& escapes);
+
+	//the modules whose interfaces the code of the given one may depend on, directly or not, itself excluded
+	std::set<size_t> dependencies(const TypeChecker::TypeInfo& info, const std::vector<Module>& modules, size_t module);
+}
+
+#endif
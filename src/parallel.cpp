@@ -0,0 +1,45 @@
+#include "parallel.h"
+#include "arena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include <vector>
+
+void parallel_for(size_t count, size_t threads, const std::function<void(size_t)>& task) {
+	if(threads <= 1 || count <= 1) {
+		for(size_t i = 0; i < count; ++i) {
+			task(i);
+		}
+		return;
+	}
+	std::atomic<size_t> next(0);
+	std::vector<std::exception_ptr> errors(count);
+	//the tasks may allocate nodes of the caller's program
+	std::shared_ptr<Arena> arena = Arena::current();
+	auto work = [&]() {
+		Arena::Scope scope(arena);
+		for(size_t i = next++; i < count; i = next++) {
+			try {
+				task(i);
+			} catch(...) {
+				errors[i] = std::current_exception();
+			}
+		}
+	};
+	//the calling thread is one of the workers
+	std::vector<std::thread> workers;
+	for(size_t i = 1; i < std::min(threads, count); ++i) {
+		workers.emplace_back(work);
+	}
+	work();
+	for(std::thread& worker : workers) {
+		worker.join();
+	}
+	for(const std::exception_ptr& error : errors) {
+		if(error) {
+			std::rethrow_exception(error);
+		}
+	}
+}
@@ -0,0 +1,10 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <cstddef>
+#include <functional>
+
+//runs the task for every index on the given number of threads, each takes the next index as soon as it's done with the previous one, so a few long tasks don't hold back the rest, the exception of the lowest failed index is rethrown
+void parallel_for(size_t count, size_t threads, const std::function<void(size_t)>& task);
+
+#endif
@@ -126,9 +126,9 @@ namespace {
 			push_env("variable definition");
 			size_t begin;
 			std::string type(parse_type_string(&begin));
-			std::vector<std::pair<std::string, std::unique_ptr<Expression>>> defs;
+			std::vector<std::pair<Symbol, std::unique_ptr<Expression>>> defs;
 			while(expect(Token::Type::NAME), true) {
-				std::string name = pos->data;
+				Symbol name = pos->symbol;
 				update_env(name);
 				next_token();
 				std::unique_ptr<Expression> value = nullptr;
@@ -137,7 +137,7 @@ namespace {
 					value = parse_expression();
 				}
 				update_env();
-				defs.push_back(std::make_pair(std::move(name), std::move(value)));
+				defs.push_back(std::make_pair(name, std::move(value)));
 				if(pos->type == Token::Type::SEMICOLON) {
 					++pos;
 					break;
@@ -178,14 +178,14 @@ namespace {
 				std::string var_type = pos->data;
 				++pos;
 				expect(Token::Type::NAME);
-				std::string var_name = pos->data;
+				Symbol var_name = pos->symbol;
 				++pos;
 				expect(Token::Type::COLON);
 				++pos;
 				std::unique_ptr<Expression> array = parse_expression();
 				expect(Token::Type::BRACKET_CLOSE);
 				++pos;
-				result = make_node<For>(begin, std::move(var_type), std::move(var_name), std::move(array), parse_statement());
+				result = make_node<For>(begin, std::move(var_type), var_name, std::move(array), parse_statement());
 			} else if(pos->type == Token::Type::KEYWORD_IF) {
 				++pos;
 				expect(Token::Type::BRACKET_OPEN);
@@ -340,8 +340,8 @@ namespace {
 			}},
 			{Token::Type::NAME, [](Parser& p){
 				size_t begin = p.pos->pos;
-				std::string name((p.pos)++->data);
-				return p.make_node<Variable>(begin, std::move(name));
+				Symbol name = (p.pos)++->symbol;
+				return p.make_node<Variable>(begin, name);
 			}},
 			{Token::Type::KEYWORD_NULL, [](Parser& p){
 				size_t begin = (p.pos++)->pos;
@@ -0,0 +1,161 @@
+#include "profile.h"
+#include "helper_visitors.h"
+
+#include <fstream>
+#include <functional>
+
+using namespace ProgramTree;
+using namespace TypeChecker;
+
+namespace {
+	void add_receivers(const InheritanceTreeNode& node, std::vector<const ClassInfo*>& receivers) {
+		receivers.push_back(node.class_info);
+		for(const auto& child : node.children) {
+			add_receivers(*child, receivers);
+		}
+	}
+
+	class CounterNumbering : public RecursiveVisitor {
+		const TypeInfo& info;
+
+		std::shared_ptr<ProfileCounters> make_counters(size_t count) {
+			auto result = std::make_shared<ProfileCounters>();
+			result->first = counters;
+			counters += count;
+			return result;
+		}
+
+	public:
+		size_t counters;
+
+		virtual void apply(If& arg) {
+			arg.profile = make_counters(2);
+			RecursiveVisitor::apply(arg);
+		}
+
+		virtual void apply(While& arg) {
+			arg.profile = make_counters(2);
+			RecursiveVisitor::apply(arg);
+		}
+
+		virtual void apply(For& arg) {
+			arg.profile = make_counters(2);
+			RecursiveVisitor::apply(arg);
+		}
+
+		virtual void apply(VirtualFunctionCall& arg) {
+			std::vector<const ClassInfo*> receivers;
+			add_receivers(*info.classes.at(arg.object->type)->inheritance_tree_node, receivers);
+			arg.profile = make_counters(receivers.size());
+			arg.profile->receivers = std::move(receivers);
+			RecursiveVisitor::apply(arg);
+		}
+
+		CounterNumbering() = delete;
+		CounterNumbering(const TypeInfo& info) : info(info), counters(0) {}
+	};
+
+	class CounterReader : public RecursiveVisitor {
+		const std::vector<uint64_t>& counts;
+
+		void read(ProfileCounters& counters, size_t count) {
+			counters.counts.assign(counts.begin() + counters.first, counts.begin() + counters.first + count);
+		}
+
+	public:
+		virtual void apply(If& arg) {
+			read(*arg.profile, 2);
+			RecursiveVisitor::apply(arg);
+		}
+
+		virtual void apply(While& arg) {
+			read(*arg.profile, 2);
+			RecursiveVisitor::apply(arg);
+		}
+
+		virtual void apply(For& arg) {
+			read(*arg.profile, 2);
+			RecursiveVisitor::apply(arg);
+		}
+
+		virtual void apply(VirtualFunctionCall& arg) {
+			read(*arg.profile, arg.profile->receivers.size());
+			RecursiveVisitor::apply(arg);
+		}
+
+		CounterReader() = delete;
+		CounterReader(const std::vector<uint64_t>& counts) : counts(counts) {}
+	};
+
+	void for_each_body(const TypeInfo& info, const std::function<void(Block&)>& action) {
+		for(const auto& fun : info.functions) {
+			action(*fun.second->data->body);
+		}
+		for(const auto& cl : info.classes) {
+			for(const auto& fun : cl.second->functions) {
+				if(fun->class_info == cl.second.get()) {
+					action(*fun->data->body);
+				}
+			}
+		}
+	}
+
+	//false at the end of the input
+	bool read_word(std::istream& input, uint64_t& result) {
+		unsigned char bytes[8];
+		if(!input.read((char*) bytes, 8)) {
+			return false;
+		}
+		result = 0;
+		for(size_t i = 8; i > 0; --i) {
+			result = (result << 8) | bytes[i - 1];
+		}
+		return true;
+	}
+}
+
+namespace Optimizer {
+	//FNV-1a
+	uint64_t source_checksum(const std::string& source) {
+		uint64_t result = 14695981039346656037ull;
+		for(char c : source) {
+			result = (result ^ (unsigned char) c) * 1099511628211ull;
+		}
+		return result;
+	}
+
+	size_t assign_counters(const TypeInfo& info) {
+		CounterNumbering n(info);
+		for_each_body(info, [&](Block& body) {
+			body.visit(&n);
+		});
+		return n.counters;
+	}
+
+	void read_profile(const TypeInfo& info, const Instrumentation& expected) {
+		std::ifstream input(expected.filename, std::ios_base::binary);
+		if(!input) {
+			throw std::runtime_error("Can't read the profile " + expected.filename + ".");
+		}
+		uint64_t checksum, counters;
+		if(!read_word(input, checksum) || !read_word(input, counters)) {
+			throw std::runtime_error("Profile " + expected.filename + " is malformed, its header is truncated.");
+		}
+		if(checksum != expected.checksum || counters != expected.counters) {
+			throw std::runtime_error("Profile " + expected.filename + " was generated for a different program.");
+		}
+		std::vector<uint64_t> counts(expected.counters);
+		for(size_t i = 0; i < counts.size(); ++i) {
+			if(!read_word(input, counts[i])) {
+				throw std::runtime_error("Profile " + expected.filename + " is malformed, it has " + std::to_string(i) + " of its " + std::to_string(counts.size()) + " counters.");
+			}
+		}
+		if(input.peek() != std::char_traits<char>::eof()) {
+			throw std::runtime_error("Profile " + expected.filename + " is malformed, there is data after its " + std::to_string(counts.size()) + " counters.");
+		}
+		CounterReader r(counts);
+		for_each_body(info, [&](Block& body) {
+			body.visit(&r);
+		});
+	}
+}
@@ -0,0 +1,36 @@
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "program_tree.h"
+#include "type_info_builder.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace ProgramTree {
+	//counters of an if (then and else taken), a loop (entries and iterations) or a virtual call (one per possible receiver)
+	struct ProfileCounters {
+		size_t first; //position of the first counter in the profile
+		std::vector<const TypeChecker::ClassInfo*> receivers;
+		std::vector<uint64_t> counts; //empty unless a profile has been read
+	};
+}
+
+namespace Optimizer {
+	//an instrumented program adds its counters to the file at exit, after the checksum of the source and the number of counters
+	struct Instrumentation {
+		std::string filename;
+		uint64_t checksum;
+		size_t counters;
+	};
+
+	uint64_t source_checksum(const std::string& source);
+
+	//numbers the counters, has to run right after the type checker so that the instrumented build and the build using its profile agree, returns the number of counters
+	size_t assign_counters(const TypeChecker::TypeInfo& info);
+
+	//throws if the profile doesn't belong to the program
+	void read_profile(const TypeChecker::TypeInfo& info, const Instrumentation& expected);
+}
+
+#endif
@@ -10,6 +10,24 @@ bool ProgramTree::is_array(const std::string& type) {
 
 using namespace ProgramTree;
 
+namespace {
+	void* allocate_node(size_t size) {
+		const std::shared_ptr<Arena>& arena = Arena::current();
+		if(!arena) {
+			throw std::logic_error("A node of the program tree allocated outside of an arena.");
+		}
+		return arena->allocate(size);
+	}
+}
+
+void* Expression::operator new(size_t size) {
+	return allocate_node(size);
+}
+
+void* Statement::operator new(size_t size) {
+	return allocate_node(size);
+}
+
 Expression::Expression(size_t begin, size_t end) : begin(begin), end(end) {}
 
 Statement::Statement(size_t begin, size_t end) : begin(begin), end(end) {}
@@ -18,7 +36,7 @@ Null::Null(size_t begin, size_t end) : Expression(begin, end) {}
 
 Empty::Empty(size_t begin, size_t end) : Statement(begin, end) {}
 
-Variable::Variable(size_t begin, size_t end, std::string&& name) : Expression(begin, end), name(std::move(name)) {}
+Variable::Variable(size_t begin, size_t end, Symbol name) : Expression(begin, end), name(name) {}
 
 CallOperator::CallOperator(size_t begin, size_t end, std::unique_ptr<Expression>&& fun, std::vector<std::unique_ptr<Expression>>&& args) : Expression(begin, end), fun(std::move(fun)), args(std::move(args)) {}
 
@@ -30,11 +48,11 @@ SubscriptOperator::SubscriptOperator(size_t begin, size_t end, std::unique_ptr<E
 
 ClassMember::ClassMember(size_t begin, size_t end, std::unique_ptr<Expression>&& object, std::string&& member) : Expression(begin, end), object(std::move(object)), member(std::move(member)) {}
 
-Cast::Cast(size_t begin, size_t end, std::unique_ptr<Expression>&& expr, std::string&& target) : Expression(begin, end), expr(std::move(expr)), target(std::move(target)) {}
+Cast::Cast(size_t begin, size_t end, std::unique_ptr<Expression>&& expr, Type target) : Expression(begin, end), expr(std::move(expr)), target(target) {}
 
-NewObject::NewObject(size_t begin, size_t end, std::string&& new_type) : Expression(begin, end), new_type(std::move(new_type)) {}
+NewObject::NewObject(size_t begin, size_t end, Type new_type) : Expression(begin, end), new_type(new_type), on_stack(false) {}
 
-NewArray::NewArray(size_t begin, size_t end, std::string&& new_type, std::unique_ptr<Expression>&& size) : Expression(begin, end), new_type(std::move(new_type)), size(std::move(size)) {}
+NewArray::NewArray(size_t begin, size_t end, Type new_type, std::unique_ptr<Expression>&& size) : Expression(begin, end), new_type(new_type), size(std::move(size)), on_stack(false) {}
 
 Assignment::Assignment(size_t begin, size_t end, std::unique_ptr<Expression>&& var, std::unique_ptr<Expression>&& value) : Statement(begin, end), var(std::move(var)), value(std::move(value)) {}
 
@@ -50,17 +68,17 @@ If::If(size_t begin, size_t end, std::unique_ptr<Expression>&& condition, std::u
 
 While::While(size_t begin, size_t end, std::unique_ptr<Expression>&& condition, std::unique_ptr<Statement>&& action) : Statement(begin, end), condition(std::move(condition)), action(std::move(action)) {}
 
-For::For(size_t begin, size_t end, std::string&& var_type, std::string&& var_name, std::unique_ptr<Expression>&& array, std::unique_ptr<Statement>&& action) : Statement(begin, end), var_type(std::move(var_type)), var_name(std::move(var_name)), array(std::move(array)), action(std::move(action)) {}
+For::For(size_t begin, size_t end, Type var_type, Symbol var_name, std::unique_ptr<Expression>&& array, std::unique_ptr<Statement>&& action) : Statement(begin, end), var_type(var_type), var_name(var_name), array(std::move(array)), action(std::move(action)) {}
 
 Block::Block(size_t begin, size_t end, std::vector<std::unique_ptr<Statement>>&& statements) : Statement(begin, end), statements(std::move(statements)) {}
 
-Definition::Definition(size_t begin, size_t end, std::string&& type, std::vector<std::pair<std::string, std::unique_ptr<Expression>>>&& defs) : Statement(begin, end), type(std::move(type)), defs(std::move(defs)) {}
+Definition::Definition(size_t begin, size_t end, Type type, std::vector<std::pair<Symbol, std::unique_ptr<Expression>>>&& defs) : Statement(begin, end), type(type), defs(std::move(defs)) {}
 
 Function::Function(size_t dec_begin, size_t dec_end, std::string&& name, std::string&& return_type, std::vector<std::pair<std::string, std::string>>&& arguments, std::unique_ptr<Block>&& body) : dec_begin(dec_begin), dec_end(dec_end), name(std::move(name)),  return_type(std::move(return_type)), arguments(std::move(arguments)), body(std::move(body)) {}
 
 Class::Class(size_t dec_begin, size_t dec_end, std::string&& name, std::string&& superclass, std::vector<std::shared_ptr<Function>>&& functions, std::vector<std::unique_ptr<Definition>>&& variables) : dec_begin(dec_begin), dec_end(dec_end), name(std::move(name)), superclass(std::move(superclass)), functions(std::move(functions)), variables(std::move(variables)) {}
 
-Program::Program(std::vector<std::shared_ptr<Class>>&& classes, std::vector<std::shared_ptr<Function>>&& functions) : classes(std::move(classes)), functions(std::move(functions)) {}
+Program::Program(std::vector<std::shared_ptr<Class>>&& classes, std::vector<std::shared_ptr<Function>>&& functions) : arena(Arena::current()), classes(std::move(classes)), functions(std::move(functions)) {}
 
 void Variable::visit(Visitor* visitor) {
 	visitor->apply(*this);
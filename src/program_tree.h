@@ -2,6 +2,9 @@
 #define PRORGAM_TREE_H
 
 #include "lexer.h"
+#include "arena.h"
+#include "types.h"
+#include "symbols.h"
 
 #include <cstdint>
 #include <memory>
@@ -16,6 +19,9 @@ namespace ProgramTree {
 	using Integer = int64_t;
 	static_assert(sizeof(Integer) == sizeof(size_t), "ProgramTree::Integer must have the size of a pointer.");
 
+	//positions in the tree are 32-bit
+	const size_t MAX_SOURCE_SIZE = UINT32_MAX;
+
 	enum class BinOpType {
 		Addition, Division, Multiplication, Substraction, Alternative, Conjunction, Modulo, LessThan, LessEqual, GreaterThan, GreaterEqual, Equal, NotEqual
 	};
@@ -58,6 +64,10 @@ namespace ProgramTree {
 	struct Block;
 	struct Empty;
 	struct Definition;
+	struct VectorLoop;
+	struct LoopUnrolling;
+	struct ConstantArray;
+	struct ProfileCounters;
 
 	class Visitor {
 	public:
@@ -172,12 +182,16 @@ namespace ProgramTree {
 	};
 
 	struct Expression {
-		const size_t begin;
-		const size_t end;
-		std::string type; //to be set by the type checker
+		const uint32_t begin;
+		const uint32_t end;
+		Type type; //to be set by the type checker, unknown if the expression is invalid
 		virtual void visit(ConstVisitor* visitor) const = 0;
 		virtual void visit(Visitor* visitor) = 0;
 
+		//in the current arena of the thread, freed with it
+		static void* operator new(size_t size);
+		static void operator delete(void*) {}
+
 		virtual ~Expression() = default;
 		Expression(Expression&&) = delete;
 		Expression(const Expression&) = delete;
@@ -247,6 +261,7 @@ namespace ProgramTree {
 	struct StaticFunctionCall : public Expression {
 		std::string fun;
 		std::vector<std::unique_ptr<Expression>> args;
+		std::shared_ptr<const ConstantArray> constant; //to be set by the compile-time evaluation, may be null
 		StaticFunctionCall() = delete;
 		~StaticFunctionCall() = default;
 		StaticFunctionCall(size_t begin, size_t end, std::string&& fun, std::vector<std::unique_ptr<Expression>>&& args);
@@ -259,6 +274,7 @@ namespace ProgramTree {
 		std::unique_ptr<Expression> object;
 		std::string fun;
 		std::vector<std::unique_ptr<Expression>> args;
+		std::shared_ptr<ProfileCounters> profile; //to be set by the profiler, may be null
 		VirtualFunctionCall() = delete;
 		~VirtualFunctionCall() = default;
 		VirtualFunctionCall(size_t begin, size_t end, std::unique_ptr<Expression>&& object, std::string&& fun, std::vector<std::unique_ptr<Expression>>&& args);
@@ -279,21 +295,23 @@ namespace ProgramTree {
 	};
 
 	struct NewObject : public Expression {
-		std::string new_type;
+		Type new_type;
+		bool on_stack; //to be set by the escape analysis
 		NewObject() = delete;
 		~NewObject() = default;
-		NewObject(size_t begin, size_t end, std::string&& type);
+		NewObject(size_t begin, size_t end, Type type);
 		NewObject(const NewObject&) = delete;
 		virtual void visit(ConstVisitor* visitor) const override;
 		virtual void visit(Visitor* visitor) override;
 	};
 
 	struct NewArray : public Expression {
-		std::string new_type;
+		Type new_type; //of the elements
 		std::unique_ptr<Expression> size;
+		bool on_stack; //to be set by the escape analysis
 		NewArray() = delete;
 		~NewArray() = default;
-		NewArray(size_t begin, size_t end, std::string&& type, std::unique_ptr<Expression>&& size);
+		NewArray(size_t begin, size_t end, Type type, std::unique_ptr<Expression>&& size);
 		NewArray(const NewArray&) = delete;
 		virtual void visit(ConstVisitor* visitor) const override;
 		virtual void visit(Visitor* visitor) override;
@@ -314,13 +332,13 @@ namespace ProgramTree {
 	};
 
 	struct Variable : public Expression {
-		std::string name;
+		Symbol name;
 
 		Variable() = delete;
 		Variable(const Variable&) = delete;
 		Variable(Variable&&) = default;
 		~Variable() = default;
-		Variable(size_t begin, size_t end, std::string&& name);
+		Variable(size_t begin, size_t end, Symbol name);
 
 		virtual void visit(ConstVisitor* visitor) const override;
 		virtual void visit(Visitor* visitor) override;
@@ -339,24 +357,28 @@ namespace ProgramTree {
 
 	struct Cast : public Expression {
 		std::unique_ptr<Expression> expr;
-		std::string target;
+		Type target;
 
 		Cast() = delete;
 		Cast(const Cast&) = delete;
 		Cast(Cast&&) = default;
 		~Cast() = default;
-		Cast(size_t begin, size_t end, std::unique_ptr<Expression>&& expr, std::string&& target);
+		Cast(size_t begin, size_t end, std::unique_ptr<Expression>&& expr, Type target);
 
 		virtual void visit(ConstVisitor* visitor) const override;
 		virtual void visit(Visitor* visitor) override;
 	};
 
 	struct Statement {
-		const size_t begin;
-		const size_t end;
+		const uint32_t begin;
+		const uint32_t end;
 		virtual void visit(ConstVisitor* visitor) const = 0;
 		virtual void visit(Visitor* visitor) = 0;
 
+		//in the current arena of the thread, freed with it
+		static void* operator new(size_t size);
+		static void operator delete(void*) {}
+
 		virtual ~Statement() = default;
 		Statement(Statement&&) = delete;
 		Statement(const Statement&) = delete;
@@ -427,6 +449,7 @@ namespace ProgramTree {
 		std::unique_ptr<Expression> condition;
 		std::unique_ptr<Statement> case_then;
 		std::unique_ptr<Statement> case_else; //may be empty
+		std::shared_ptr<ProfileCounters> profile; //to be set by the profiler, may be null
 		If(size_t begin, size_t end, std::unique_ptr<Expression>&& condition, std::unique_ptr<Statement>&& case_then, std::unique_ptr<Statement>&& case_else);
 		virtual void visit(ConstVisitor* visitor) const override;
 		virtual void visit(Visitor* visitor) override;
@@ -438,6 +461,9 @@ namespace ProgramTree {
 	struct While : public Statement {
 		std::unique_ptr<Expression> condition;
 		std::unique_ptr<Statement> action;
+		std::shared_ptr<const VectorLoop> vector_loop; //to be set by the vectorizer, may be null
+		std::shared_ptr<const LoopUnrolling> unrolling; //to be set by the loop unroller, may be null
+		std::shared_ptr<ProfileCounters> profile; //to be set by the profiler, may be null
 		While(size_t begin, size_t end, std::unique_ptr<Expression>&& condition, std::unique_ptr<Statement>&& action);
 		virtual void visit(ConstVisitor* visitor) const override;
 		virtual void visit(Visitor* visitor) override;
@@ -447,11 +473,14 @@ namespace ProgramTree {
 	};
 
 	struct For : public Statement {
-		std::string var_type;
-		std::string var_name;
+		Type var_type;
+		Symbol var_name;
 		std::unique_ptr<Expression> array;
 		std::unique_ptr<Statement> action;
-		For(size_t begin, size_t end, std::string&& var_type, std::string&& var_name, std::unique_ptr<Expression>&& array, std::unique_ptr<Statement>&& action);
+		std::shared_ptr<const VectorLoop> vector_loop; //to be set by the vectorizer, may be null
+		std::shared_ptr<const LoopUnrolling> unrolling; //to be set by the loop unroller, may be null
+		std::shared_ptr<ProfileCounters> profile; //to be set by the profiler, may be null
+		For(size_t begin, size_t end, Type var_type, Symbol var_name, std::unique_ptr<Expression>&& array, std::unique_ptr<Statement>&& action);
 		virtual void visit(ConstVisitor* visitor) const override;
 		virtual void visit(Visitor* visitor) override;
 		For(const For&) = delete;
@@ -480,13 +509,13 @@ namespace ProgramTree {
 	};
 
 	struct Definition : public Statement {
-		std::string type;
-		std::vector<std::pair<std::string, std::unique_ptr<Expression>>> defs; //may be null
+		Type type;
+		std::vector<std::pair<Symbol, std::unique_ptr<Expression>>> defs; //may be null
 		Definition() = delete;
 		Definition(const Definition&) = delete;
 		Definition(Definition&&) = default;
 		~Definition() = default;
-		Definition(size_t begin, size_t end, std::string&& type, std::vector<std::pair<std::string, std::unique_ptr<Expression>>>&& defs);
+		Definition(size_t begin, size_t end, Type type, std::vector<std::pair<Symbol, std::unique_ptr<Expression>>>&& defs);
 
 		virtual void visit(ConstVisitor* visitor) const override;
 		virtual void visit(Visitor* visitor) override;
@@ -519,6 +548,7 @@ namespace ProgramTree {
 	};
 
 	struct Program {
+		std::shared_ptr<Arena> arena; //of the nodes, the current one of the thread that made the program
 		std::vector<std::shared_ptr<Class>> classes;
 		std::vector<std::shared_ptr<Function>> functions;
 		Program() = delete;
@@ -531,12 +561,18 @@ namespace ProgramTree {
 	const std::string INT_NAME = "int";
 	const std::string STR_NAME = "string";
 	const std::string BOOL_NAME = "boolean";
+	const std::string NULL_NAME = "null"; //the type of null
 	const std::set<std::string> DEFAULT_TYPES = {VOID_NAME, INT_NAME, STR_NAME, BOOL_NAME};
 	const std::map<std::string, std::pair<std::string, std::vector<std::string>>> BUILTIN_FUNCTIONS = {{"printInt", {"void", {"int"}}}, {"printString", {"void", {"string"}}}, {"error", {"void", {}}}, {"readInt", {"int", {}}}, {"readString", {"string", {}}}};
 	const std::string CONCAT_FUN_NAME = "_concat";
+	const std::string CONCAT_N_FUN_NAME = "_concat_n";
 	const std::string THIS_NAME = "self";
 	const std::string LENGTH_ATTR_NAME = "length";
 
 	bool is_array(const std::string& type);
+
+	inline bool is_array(Type type) {
+		return type.is_array();
+	}
 }
 #endif
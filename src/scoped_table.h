@@ -0,0 +1,118 @@
+#ifndef SCOPED_TABLE_H
+#define SCOPED_TABLE_H
+
+#include "symbols.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+//variables visible in nested blocks, a flat open-addressing table from names to their innermost declarations and a log of the declarations that leaving a block undoes
+template<typename Value>
+class ScopedTable {
+	static const size_t NONE = static_cast<size_t>(-1);
+
+	struct Declaration {
+		ProgramTree::Symbol name;
+		Value value;
+		size_t depth; //of the block
+		size_t shadowed; //the previous declaration of the name, or NONE
+	};
+
+	//names are never removed until clear(), only their declarations are undone
+	struct Slot {
+		ProgramTree::Symbol name;
+		size_t declaration;
+	};
+
+	std::vector<Slot> slots; //a power of two of them, at most half used
+	size_t used;
+	std::vector<Declaration> declarations; //in the order of declaring
+	std::vector<size_t> blocks; //numbers of the declarations at the entries of the open blocks
+
+	//of the name, or the empty one it would take
+	size_t position(ProgramTree::Symbol name) const {
+		size_t mask = slots.size() - 1;
+		size_t i = hash(name) & mask;
+		while(slots[i].name != name && !slots[i].name.empty()) {
+			i = (i + 1) & mask;
+		}
+		return i;
+	}
+
+	size_t& slot(ProgramTree::Symbol name) {
+		if(2 * (used + 1) > slots.size()) {
+			grow();
+		}
+		Slot& s = slots[position(name)];
+		if(s.name.empty()) {
+			++used;
+			s.name = name;
+		}
+		return s.declaration;
+	}
+
+	size_t find_declaration(ProgramTree::Symbol name) const {
+		return slots.empty() ? NONE : slots[position(name)].declaration;
+	}
+
+	void grow() {
+		std::vector<Slot> old(std::max<size_t>(16, 2 * slots.size()), Slot{ProgramTree::Symbol(), NONE});
+		old.swap(slots);
+		used = 0;
+		for(const Slot& s : old) {
+			if(!s.name.empty()) {
+				slot(s.name) = s.declaration;
+			}
+		}
+	}
+
+	static size_t hash(ProgramTree::Symbol name) {
+		return static_cast<size_t>(name.id()) * 0x9E3779B1u;
+	}
+
+public:
+	//of the innermost declaration, null if there's none
+	const Value* find(ProgramTree::Symbol name) const {
+		size_t d = find_declaration(name);
+		return d == NONE ? nullptr : &declarations[d].value;
+	}
+
+	//whether the innermost declaration is in the current block
+	bool declared_in_block(ProgramTree::Symbol name) const {
+		size_t d = find_declaration(name);
+		return d != NONE && declarations[d].depth == blocks.size();
+	}
+
+	//shadows the declarations of the name in the outer blocks
+	void declare(ProgramTree::Symbol name, const Value& value) {
+		size_t& s = slot(name);
+		declarations.push_back({name, value, blocks.size(), s});
+		s = declarations.size() - 1;
+	}
+
+	void enter() {
+		blocks.push_back(declarations.size());
+	}
+
+	//undoes the declarations of the current block
+	void leave() {
+		while(declarations.size() > blocks.back()) {
+			slots[position(declarations.back().name)].declaration = declarations.back().shadowed;
+			declarations.pop_back();
+		}
+		blocks.pop_back();
+	}
+
+	//of all the blocks and names
+	void clear() {
+		slots.assign(slots.size(), Slot{ProgramTree::Symbol(), NONE});
+		used = 0;
+		declarations.clear();
+		blocks.clear();
+	}
+
+	ScopedTable() : used(0) {}
+};
+
+#endif
@@ -0,0 +1,37 @@
+#include "symbols.h"
+
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+
+using namespace ProgramTree;
+
+namespace {
+	//symbols are never removed, so the handles stay valid for the whole process
+	class SymbolTable {
+		std::mutex mutex;
+		std::unordered_map<std::string, std::unique_ptr<SymbolData>> symbols;
+
+	public:
+		const SymbolData* intern(const std::string& name) {
+			std::lock_guard<std::mutex> lock(mutex);
+			std::unique_ptr<SymbolData>& data = symbols[name];
+			if(!data) {
+				data.reset(new SymbolData{name, static_cast<SymbolId>(symbols.size())});
+			}
+			return data.get();
+		}
+	};
+
+	SymbolTable& table() {
+		static SymbolTable result;
+		return result;
+	}
+}
+
+Symbol::Symbol(const std::string& name) : data(name.empty() ? nullptr : table().intern(name)) {}
+
+std::ostream& ProgramTree::operator<<(std::ostream& output, Symbol symbol) {
+	return output << symbol.name();
+}
@@ -0,0 +1,70 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+namespace ProgramTree {
+	using SymbolId = uint32_t;
+
+	struct SymbolData {
+		std::string name;
+		SymbolId id; //dense, in the order of interning
+	};
+
+	//handle of an identifier interned in a table shared by the whole process, equal names have equal handles, the default one is the empty name
+	class Symbol {
+		const SymbolData* data;
+
+	public:
+		Symbol(const std::string& name);
+		Symbol() : data(nullptr) {}
+
+		SymbolId id() const { //0 for the empty name
+			return data ? data->id : 0;
+		}
+		const std::string& name() const {
+			static const std::string none;
+			return data ? data->name : none;
+		}
+		bool empty() const {
+			return !data;
+		}
+
+		//for the code that looks names up or prints them
+		operator const std::string&() const {
+			return name();
+		}
+
+		friend bool operator==(Symbol a, Symbol b) {
+			return a.data == b.data;
+		}
+
+		friend bool operator!=(Symbol a, Symbol b) {
+			return a.data != b.data;
+		}
+
+		//without interning the string
+		friend bool operator==(Symbol a, const std::string& b) {
+			return a.name() == b;
+		}
+
+		friend bool operator!=(Symbol a, const std::string& b) {
+			return a.name() != b;
+		}
+
+		friend bool operator==(const std::string& a, Symbol b) {
+			return a == b.name();
+		}
+
+		friend bool operator!=(const std::string& a, Symbol b) {
+			return a != b.name();
+		}
+	};
+
+	//the name
+	std::ostream& operator<<(std::ostream& output, Symbol symbol);
+}
+
+#endif
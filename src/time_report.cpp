@@ -0,0 +1,105 @@
+#include "time_report.h"
+
+#include <iomanip>
+#include <sys/resource.h>
+#include <time.h>
+
+namespace {
+	double wall_time() {
+		timespec t;
+		clock_gettime(CLOCK_MONOTONIC, &t);
+		return t.tv_sec * 1e3 + t.tv_nsec / 1e6;
+	}
+
+	double milliseconds(const timeval& t) {
+		return t.tv_sec * 1e3 + t.tv_usec / 1e3;
+	}
+
+	//of all the threads
+	double cpu_time() {
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		return milliseconds(usage.ru_utime) + milliseconds(usage.ru_stime);
+	}
+
+	long peak_rss() {
+		rusage usage;
+		getrusage(RUSAGE_SELF, &usage);
+		return usage.ru_maxrss;
+	}
+
+	//names are plain identifiers, so nothing needs escaping
+	void print_json(std::ostream& output, const std::string& name, double wall, double cpu, long peak_rss_growth, const std::vector<std::pair<std::string, size_t>>& counts) {
+		output << "{\"name\":\"" << name << "\",\"wall_ms\":" << wall << ",\"cpu_ms\":" << cpu << ",\"peak_rss_growth_kb\":" << peak_rss_growth;
+		for(const auto& c : counts) {
+			output << ",\"" << c.first << "\":" << c.second;
+		}
+		output << '}';
+	}
+}
+
+void TimeReport::finish() {
+	if(!running) {
+		return;
+	}
+	running = false;
+	Phase& phase = phases.back();
+	phase.wall = wall_time() - wall_start;
+	phase.cpu = cpu_time() - cpu_start;
+	phase.peak_rss_growth = peak_rss() - peak_rss_start;
+}
+
+void TimeReport::start(const std::string& phase) {
+	finish();
+	phases.push_back({phase, 0, 0, 0, {}});
+	running = true;
+	wall_start = wall_time();
+	cpu_start = cpu_time();
+	peak_rss_start = peak_rss();
+}
+
+void TimeReport::count(const std::string& item, size_t value) {
+	if(!phases.empty()) {
+		phases.back().counts.emplace_back(item, value);
+	}
+}
+
+void TimeReport::print(std::ostream& output, bool json) {
+	finish();
+	double wall = 0;
+	double cpu = 0;
+	long peak_rss_growth = 0;
+	for(const Phase& phase : phases) {
+		wall += phase.wall;
+		cpu += phase.cpu;
+		peak_rss_growth += phase.peak_rss_growth;
+	}
+	std::ios_base::fmtflags flags = output.flags();
+	output << std::fixed << std::setprecision(3);
+	if(json) {
+		output << "{\"phases\":[";
+		for(size_t i = 0; i < phases.size(); ++i) {
+			output << (i ? "," : "");
+			print_json(output, phases[i].name, phases[i].wall, phases[i].cpu, phases[i].peak_rss_growth, phases[i].counts);
+		}
+		output << "],\"total\":";
+		print_json(output, "total", wall, cpu, peak_rss_growth, {});
+		output << ",\"peak_rss_kb\":" << peak_rss() << "}\n";
+	} else {
+		output << std::left << std::setw(24) << "phase" << std::right << std::setw(12) << "wall ms" << std::setw(12) << "cpu ms" << std::setw(14) << "peak rss +KB" << "  counts\n";
+		auto line = [&](const std::string& name, double wall, double cpu, long peak_rss_growth, const std::vector<std::pair<std::string, size_t>>& counts) {
+			output << std::left << std::setw(24) << name << std::right << std::setw(12) << wall << std::setw(12) << cpu << std::setw(14) << peak_rss_growth;
+			for(size_t i = 0; i < counts.size(); ++i) {
+				output << (i ? " " : "  ") << counts[i].first << '=' << counts[i].second;
+			}
+			output << '\n';
+		};
+		for(const Phase& phase : phases) {
+			line(phase.name, phase.wall, phase.cpu, phase.peak_rss_growth, phase.counts);
+		}
+		line("total", wall, cpu, peak_rss_growth, {{"peak_rss_kb", peak_rss()}});
+	}
+	output.flags(flags);
+}
+
+TimeReport::TimeReport() : running(false), wall_start(0), cpu_start(0), peak_rss_start(0) {}
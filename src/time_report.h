@@ -0,0 +1,40 @@
+#ifndef TIME_REPORT_H
+#define TIME_REPORT_H
+
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+//wall and CPU time, growth of the peak resident set and counts of what was processed, for every phase of a compilation, the times are of the whole process
+class TimeReport {
+	struct Phase {
+		std::string name;
+		double wall; //in milliseconds
+		double cpu;
+		long peak_rss_growth; //in kilobytes
+		std::vector<std::pair<std::string, size_t>> counts;
+	};
+
+	std::vector<Phase> phases;
+	bool running;
+	double wall_start;
+	double cpu_start;
+	long peak_rss_start;
+
+	void finish();
+
+public:
+	//the previous phase ends where the next one starts
+	void start(const std::string& phase);
+
+	//of the current phase, or of the last one if it has ended
+	void count(const std::string& item, size_t value);
+
+	//ends the current phase, JSON is a single line
+	void print(std::ostream& output, bool json);
+
+	TimeReport();
+};
+
+#endif
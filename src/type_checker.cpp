@@ -1,96 +1,80 @@
 #include "type_checker.h"
 #include "helper_visitors.h"
+#include "parallel.h"
+#include "scoped_table.h"
 
+#include <list>
 #include <map>
 #include <string>
 #include <set>
-#include <stack>
+#include <vector>
 
 using namespace ProgramTree;
 using namespace TypeChecker;
 
 namespace {
-	bool does_cast_implicitly(const TypeInfo& info, const std::string& from, const std::string& to) {
+	bool does_cast_implicitly(const TypeInfo& info, Type from, Type to) {
 		//implicit cast is available up the inheritance tree or from null to a classname
 		if(from == to) {
 			return true;
 		}
-		if(is_array(from) && is_array(to)) {
-			return does_cast_implicitly(info, from.substr(0, from.size() - 2), to.substr(0, to.size() - 2));
+		if(from.is_array() && to.is_array()) {
+			return does_cast_implicitly(info, from.element(), to.element());
 		}
-		if(from == Token::TYPE_NAMES.at(Token::Type::KEYWORD_NULL) && info.classes.find(to) != info.classes.end()) {
-			return true;
+		if(to.kind() != TypeKind::Class) {
+			return false;
 		}
-		auto r = info.classes.find(from);
-		if(r == info.classes.end()) {
+		auto t = info.class_types.find(to.id());
+		if(t == info.class_types.end()) {
 			return false;
 		}
-		InheritanceTreeNode* node = r->second->inheritance_tree_node;
-		while(node) {
-			if(node->class_info->data->name == to) {
-				return true;
-			}
-			node = node->parent;
+		if(from == NULL_TYPE) {
+			return true;
 		}
-		return false;
+		//two comparisons of the numbers of the inheritance tree instead of walking up from the subclass
+		auto f = info.class_types.find(from.id());
+		return f != info.class_types.end() && f->second->inheritance_tree_node->is_subclass_of(*t->second->inheritance_tree_node);
 	}
 
-	bool does_explicit_cast(const TypeInfo& info, const std::string& from, const std::string& to) {
+	bool does_explicit_cast(const TypeInfo& info, Type from, Type to) {
 		//explicit cast is available in both directions along the inheritance tree
 		return does_cast_implicitly(info, from, to) || does_cast_implicitly(info, to, from);
 	}
 
-	template<typename T, typename U>
-	std::string build_function_arg_string(const std::vector<T>& args, U getter) {
-		std::string expr_type = "(";
-		if(!args.empty()) {
-			expr_type += getter(args[0]);
-		}
-		for(size_t i = 1; i < args.size(); ++i) {
-			expr_type += ',';
-			expr_type += getter(args[i]);
+	//a primitive or a class, arrays of them are valid element types
+	bool is_known_type(const TypeInfo& info, Type type) {
+		switch(type.kind()) {
+			case TypeKind::Void:
+			case TypeKind::Int:
+			case TypeKind::String:
+			case TypeKind::Bool:
+				return true;
+			case TypeKind::Class:
+				return info.classes.find(type.name()) != info.classes.end();
+			default:
+				return false;
 		}
-		expr_type += ')';
-		return expr_type;
-	}
-
-	std::string build_function_arg_string(const std::vector<std::pair<std::string, std::string>>& args)  {
-		return build_function_arg_string(args, [](const std::pair<std::string, std::string>& a){
-			return a.first;
-		});
 	}
 
-		std::string build_function_arg_string(const std::vector<std::string>& args)  {
-		return build_function_arg_string(args, [](const std::string& a){
-			return a;
-		});
+	std::string build_function_arg_string(const std::vector<Type>& args)  {
+		std::string result = "(";
+		for(size_t i = 0; i < args.size(); ++i) {
+			result += (i ? "," : "") + args[i].name();
+		}
+		return result + ')';
 	}
 
-	std::vector<std::string> get_args_from_function_string(const std::string& fun)  {
-		std::vector<std::string> ret;
-		size_t bracket = 1;
-		size_t begin = fun.find('(') + 1;
-		for(size_t i = begin + 1; i < fun.size(); ++i) {
-			if(fun[i] == '(') {
-				++bracket;
-			} else if(fun[i] == ')') {
-				if(!--bracket) {
-					ret.push_back(fun.substr(begin, i - begin));
-					break;
-				}
-			} else if(fun[i] == ',') {
-				if(bracket == 1) {
-					ret.push_back(fun.substr(begin, i - begin));
-					begin = i + 1;
-				}
-			}
+	Type function_type(Type return_type, const std::vector<std::pair<Type, std::string>>& args) {
+		std::vector<Type> types;
+		for(const auto& a : args) {
+			types.push_back(a.first);
 		}
-		return ret;
+		return Type::function(return_type, types);
 	}
 
-	template<typename T>
-	std::string build_function_type_string(const std::string& return_type, const std::vector<T> &args) {
-		return std::string("@function<") + return_type + build_function_arg_string(args) + '>';
+	Type function_type(const std::string& return_type, const std::vector<std::string>& args) {
+		std::vector<Type> types(args.begin(), args.end());
+		return Type::function(return_type, types);
 	}
 
 	struct FunctionSourceSetter : public DefaultVisitor {
@@ -104,7 +88,7 @@ namespace {
 		}
 
 		virtual void apply(Variable& arg) {
-			target = std::make_unique<StaticFunctionCall>(arg.begin, arg.end, std::move(arg.name), std::move(args));
+			target = std::make_unique<StaticFunctionCall>(arg.begin, arg.end, std::string(arg.name), std::move(args));
 		}
 
 		virtual void apply(ClassMember& arg) {
@@ -147,7 +131,7 @@ namespace {
 		//statement is expected to set 'does_return' and 'optimized_statement'
 		//expression is expected to set 'arg.type', 'optimized_expression', 'side_effects', 'variable_access'
 		template<ProgramTree::LiteralType OT, ProgramTree::LiteralType RT, ProgramTree::BinOpType BOT, typename A>
-		void apply_binary(ProgramTree::BinaryOperator<BOT>& arg, const std::string& operand_type, const std::string& result_type, A operation, const std::string& operation_name) {
+		void apply_binary(ProgramTree::BinaryOperator<BOT>& arg, Type operand_type, Type result_type, A operation, const std::string& operation_name) {
 			arg.left->visit(this);
 			if(optimized_expression) {
 				std::swap(arg.left, optimized_expression);
@@ -161,19 +145,19 @@ namespace {
 			if(arg.right->type.empty()) {
 				valid_type = false;
 			} else if(!does_cast_implicitly(info, arg.right->type, operand_type)) {
-				push_error(arg.begin, arg.end, "type " + arg.right->type + " cannot be casted to " + operand_type + " in the right operand of " + operation_name + " expression.");
+				push_error(arg.begin, arg.end, "type " + arg.right->type.name() + " cannot be casted to " + operand_type.name() + " in the right operand of " + operation_name + " expression.");
 				valid_type = false;
 			}
 			if(arg.left->type.empty()) {
 				valid_type = false;
 			} else if(!does_cast_implicitly(info, arg.left->type, operand_type)) {
-				push_error(arg.begin, arg.end, "type " + arg.left->type + " cannot be casted to " + operand_type + " in the left operand of " + operation_name + " expression.");
+				push_error(arg.begin, arg.end, "type " + arg.left->type.name() + " cannot be casted to " + operand_type.name() + " in the left operand of " + operation_name + " expression.");
 				valid_type = false;
 			}
 			if(valid_type) {
 				arg.type = result_type;
 			} else {
-				arg.type = "";
+				arg.type = Type();
 			}
 			const typename ProgramTree::literal_type<OT>::type* l_val = nullptr;
 			ProgramTree::LiteralGetter<OT> lg(l_val);
@@ -192,7 +176,7 @@ namespace {
 		}
 
 		template<ProgramTree::LiteralType LT>
-		void optimize_addition(std::unique_ptr<ProgramTree::Expression>& l, std::unique_ptr<ProgramTree::Expression>& r, const std::string& result_type) {
+		void optimize_addition(std::unique_ptr<ProgramTree::Expression>& l, std::unique_ptr<ProgramTree::Expression>& r, Type result_type) {
 			const typename ProgramTree::literal_type<LT>::type* l_val = nullptr;
 			ProgramTree::LiteralGetter<LT> lg(l_val);
 			l->visit(&lg);
@@ -207,6 +191,18 @@ namespace {
 			}
 		}
 
+		//a chain of concatenations becomes a single call, every literal stays a part of its own since strings are compared by address
+		void add_concat_part(std::vector<std::unique_ptr<Expression>>& parts, std::unique_ptr<Expression>&& part) {
+			StaticFunctionCall* call = get_node<StaticFunctionCall>(*part);
+			if(call && (call->fun == CONCAT_FUN_NAME || call->fun == CONCAT_N_FUN_NAME)) {
+				for(auto& a : call->args) {
+					add_concat_part(parts, std::move(a));
+				}
+				return;
+			}
+			parts.push_back(std::move(part));
+		}
+
 		virtual void apply(BinaryOperator<BinOpType::Addition>& arg) {
 			//IMPORTANT change string addition to a function call
 			arg.left->visit(this);
@@ -220,32 +216,31 @@ namespace {
 			}
 
 			if(arg.left->type.empty() || arg.right->type.empty()) {
-				arg.type = "";
-			} else if(does_cast_implicitly(info, arg.right->type, STR_NAME) && does_cast_implicitly(info, arg.left->type, STR_NAME)) {
-				optimize_addition<LiteralType::String>(arg.left, arg.right, STR_NAME);
+				arg.type = Type();
+			} else if(does_cast_implicitly(info, arg.right->type, STR_TYPE) && does_cast_implicitly(info, arg.left->type, STR_TYPE)) {
 				std::vector<std::unique_ptr<Expression>> args;
-				args.push_back(std::move(arg.left));
-				args.push_back(std::move(arg.right));
-				optimized_expression = std::make_unique<StaticFunctionCall>(arg.begin, arg.end, CONCAT_FUN_NAME.substr(), std::move(args));
-				arg.type = STR_NAME;
-				optimized_expression->type = STR_NAME;
-			} else if(does_cast_implicitly(info, arg.left->type, INT_NAME) && does_cast_implicitly(info, arg.right->type, INT_NAME)) {
-				optimize_addition<LiteralType::Integer>(arg.left, arg.right, INT_NAME);
-				arg.type = INT_NAME;
+				add_concat_part(args, std::move(arg.left));
+				add_concat_part(args, std::move(arg.right));
+				optimized_expression = std::make_unique<StaticFunctionCall>(arg.begin, arg.end, (args.size() == 2 ? CONCAT_FUN_NAME : CONCAT_N_FUN_NAME).substr(), std::move(args));
+				arg.type = STR_TYPE;
+				optimized_expression->type = STR_TYPE;
+			} else if(does_cast_implicitly(info, arg.left->type, INT_TYPE) && does_cast_implicitly(info, arg.right->type, INT_TYPE)) {
+				optimize_addition<LiteralType::Integer>(arg.left, arg.right, INT_TYPE);
+				arg.type = INT_TYPE;
 			} else {
-				push_error(arg.begin, arg.end, "the plus operator got arguments of " + arg.left->type + " and " + arg.right->type + " instead of string + string or int + int");
-				arg.type = "";
+				push_error(arg.begin, arg.end, "the plus operator got arguments of " + arg.left->type.name() + " and " + arg.right->type.name() + " instead of string + string or int + int");
+				arg.type = Type();
 			}
 			side_effects = side_effects | left_side_effects;
 			variable_access = false;
 		}
 
 		virtual void apply(BinaryOperator<BinOpType::Multiplication>& arg) {
-			apply_binary<LiteralType::Integer, LiteralType::Integer>(arg, INT_NAME, INT_NAME, [](literal_type<LiteralType::Integer>::type a, literal_type<LiteralType::Integer>::type b) -> literal_type<LiteralType::Integer>::type {return a * b;}, "a multiplication");
+			apply_binary<LiteralType::Integer, LiteralType::Integer>(arg, INT_TYPE, INT_TYPE, [](literal_type<LiteralType::Integer>::type a, literal_type<LiteralType::Integer>::type b) -> literal_type<LiteralType::Integer>::type {return a * b;}, "a multiplication");
 		}
 
 		virtual void apply(BinaryOperator<BinOpType::Division>& arg) {
-			apply_binary<LiteralType::Integer, LiteralType::Integer>(arg, INT_NAME, INT_NAME, [this, &arg](literal_type<LiteralType::Integer>::type a, literal_type<LiteralType::Integer>::type b) -> literal_type<LiteralType::Integer>::type {
+			apply_binary<LiteralType::Integer, LiteralType::Integer>(arg, INT_TYPE, INT_TYPE, [this, &arg](literal_type<LiteralType::Integer>::type a, literal_type<LiteralType::Integer>::type b) -> literal_type<LiteralType::Integer>::type {
 				if(b == 0) {
 					push_error(arg.begin, arg.end, "division by zero");
 					return 0;
@@ -255,19 +250,19 @@ namespace {
 		}
 
 		virtual void apply(BinaryOperator<BinOpType::Substraction>& arg) {
-			apply_binary<LiteralType::Integer, LiteralType::Integer>(arg, INT_NAME, INT_NAME, [](literal_type<LiteralType::Integer>::type a, literal_type<LiteralType::Integer>::type b) -> literal_type<LiteralType::Integer>::type {return a - b;}, "a substraction");
+			apply_binary<LiteralType::Integer, LiteralType::Integer>(arg, INT_TYPE, INT_TYPE, [](literal_type<LiteralType::Integer>::type a, literal_type<LiteralType::Integer>::type b) -> literal_type<LiteralType::Integer>::type {return a - b;}, "a substraction");
 		}
 
 		virtual void apply(BinaryOperator<BinOpType::Alternative>& arg) {
-			apply_binary<LiteralType::Bool, LiteralType::Bool>(arg, BOOL_NAME, BOOL_NAME, [](literal_type<LiteralType::Bool>::type a, literal_type<LiteralType::Bool>::type b) -> literal_type<LiteralType::Bool>::type {return a || b;}, "an alternative");
+			apply_binary<LiteralType::Bool, LiteralType::Bool>(arg, BOOL_TYPE, BOOL_TYPE, [](literal_type<LiteralType::Bool>::type a, literal_type<LiteralType::Bool>::type b) -> literal_type<LiteralType::Bool>::type {return a || b;}, "an alternative");
 		}
 
 		virtual void apply(BinaryOperator<BinOpType::Conjunction>& arg) {
-			apply_binary<LiteralType::Bool, LiteralType::Bool>(arg, BOOL_NAME, BOOL_NAME, [](literal_type<LiteralType::Bool>::type a, literal_type<LiteralType::Bool>::type b) -> literal_type<LiteralType::Bool>::type {return a && b;}, "a conjunction");
+			apply_binary<LiteralType::Bool, LiteralType::Bool>(arg, BOOL_TYPE, BOOL_TYPE, [](literal_type<LiteralType::Bool>::type a, literal_type<LiteralType::Bool>::type b) -> literal_type<LiteralType::Bool>::type {return a && b;}, "a conjunction");
 		}
 
 		virtual void apply(BinaryOperator<BinOpType::Modulo>& arg) {
-			apply_binary<LiteralType::Integer, LiteralType::Integer>(arg, INT_NAME, INT_NAME, [this, &arg](literal_type<LiteralType::Integer>::type a, literal_type<LiteralType::Integer>::type b) -> literal_type<LiteralType::Integer>::type {
+			apply_binary<LiteralType::Integer, LiteralType::Integer>(arg, INT_TYPE, INT_TYPE, [this, &arg](literal_type<LiteralType::Integer>::type a, literal_type<LiteralType::Integer>::type b) -> literal_type<LiteralType::Integer>::type {
 				if(b == 0) {
 					push_error(arg.begin, arg.end, "modulo by zero");
 					return 0;
@@ -277,19 +272,19 @@ namespace {
 		}
 
 		virtual void apply(BinaryOperator<BinOpType::LessThan>& arg) {
-			apply_binary<LiteralType::Integer, LiteralType::Bool>(arg, INT_NAME, BOOL_NAME, [](literal_type<LiteralType::Integer>::type a, literal_type<LiteralType::Integer>::type b) -> literal_type<LiteralType::Integer>::type {return a < b;}, "a lt comparison");
+			apply_binary<LiteralType::Integer, LiteralType::Bool>(arg, INT_TYPE, BOOL_TYPE, [](literal_type<LiteralType::Integer>::type a, literal_type<LiteralType::Integer>::type b) -> literal_type<LiteralType::Integer>::type {return a < b;}, "a lt comparison");
 		}
 
 		virtual void apply(BinaryOperator<BinOpType::LessEqual>& arg) {
-			apply_binary<LiteralType::Integer, LiteralType::Bool>(arg, INT_NAME, BOOL_NAME, [](literal_type<LiteralType::Integer>::type a, literal_type<LiteralType::Integer>::type b) -> literal_type<LiteralType::Integer>::type {return a <= b;}, "a le comparison");
+			apply_binary<LiteralType::Integer, LiteralType::Bool>(arg, INT_TYPE, BOOL_TYPE, [](literal_type<LiteralType::Integer>::type a, literal_type<LiteralType::Integer>::type b) -> literal_type<LiteralType::Integer>::type {return a <= b;}, "a le comparison");
 		}
 
 		virtual void apply(BinaryOperator<BinOpType::GreaterThan>& arg) {
-			apply_binary<LiteralType::Integer, LiteralType::Bool>(arg, INT_NAME, BOOL_NAME, [](literal_type<LiteralType::Integer>::type a, literal_type<LiteralType::Integer>::type b) -> literal_type<LiteralType::Integer>::type {return a > b;}, "a gt comparison");
+			apply_binary<LiteralType::Integer, LiteralType::Bool>(arg, INT_TYPE, BOOL_TYPE, [](literal_type<LiteralType::Integer>::type a, literal_type<LiteralType::Integer>::type b) -> literal_type<LiteralType::Integer>::type {return a > b;}, "a gt comparison");
 		}
 
 		virtual void apply(BinaryOperator<BinOpType::GreaterEqual>& arg) {
-			apply_binary<LiteralType::Integer, LiteralType::Bool>(arg, INT_NAME, BOOL_NAME, [](literal_type<LiteralType::Integer>::type a, literal_type<LiteralType::Integer>::type b) -> literal_type<LiteralType::Integer>::type {return a >= b;}, "a ge comparison");
+			apply_binary<LiteralType::Integer, LiteralType::Bool>(arg, INT_TYPE, BOOL_TYPE, [](literal_type<LiteralType::Integer>::type a, literal_type<LiteralType::Integer>::type b) -> literal_type<LiteralType::Integer>::type {return a >= b;}, "a ge comparison");
 		}
 
 		template<ProgramTree::LiteralType LT>
@@ -304,12 +299,12 @@ namespace {
 				ProgramTree::literal_type<ProgramTree::LiteralType::Bool>::type result = (*l_val == *r_val);
 				result = negation ? !result : result;
 				optimized_expression = std::make_unique<ProgramTree::Literal<ProgramTree::LiteralType::Bool>>(l->begin, r->end, std::move(result));
-				optimized_expression->type = ProgramTree::BOOL_NAME;
+				optimized_expression->type = ProgramTree::BOOL_TYPE;
 			}
 		}
 
-		std::string apply_equality(std::unique_ptr<ProgramTree::Expression>& l, std::unique_ptr<ProgramTree::Expression>& r, bool negation) {
-			std::string result;
+		Type apply_equality(std::unique_ptr<ProgramTree::Expression>& l, std::unique_ptr<ProgramTree::Expression>& r, bool negation) {
+			Type result;
 			l->visit(this);
 			if(optimized_expression) {
 				std::swap(l, optimized_expression);
@@ -320,12 +315,12 @@ namespace {
 				std::swap(r, optimized_expression);
 			}
 			if(l->type.empty() || r->type.empty()) {
-				result = "";
+				result = Type();
 			} else if (does_cast_implicitly(info, l->type, r->type) || does_cast_implicitly(info, r->type, l->type)) {
-				result = BOOL_NAME;
+				result = BOOL_TYPE;
 			} else {
-				push_error(l->begin, r->end, "type " + l->type + " and " + r->type + " cannot be compared.");
-				result = "";
+				push_error(l->begin, r->end, "type " + l->type.name() + " and " + r->type.name() + " cannot be compared.");
+				result = Type();
 			}
 			optimized_expression = nullptr;
 			try_optimize_equality<LiteralType::Bool>(l, r, negation);
@@ -337,7 +332,7 @@ namespace {
 		}
 
 		template<ProgramTree::LiteralType LT, ProgramTree::UnOpType UOT, typename A>
-		void apply_unary(ProgramTree::UnaryOperator<UOT>& arg, A operation, const std::string& type_name, const std::string& operation_name) {
+		void apply_unary(ProgramTree::UnaryOperator<UOT>& arg, A operation, Type type_name, const std::string& operation_name) {
 			arg.expr->visit(this);
 			if(optimized_expression) {
 				std::swap(arg.expr, optimized_expression);
@@ -346,9 +341,9 @@ namespace {
 				arg.type = type_name;
 			} else {
 				if(!arg.expr->type.empty()) {
-					push_error(arg.begin, arg.end, "type " + arg.expr->type + " cannot be casted to " + type_name + " in " + operation_name + " expression.");
+					push_error(arg.begin, arg.end, "type " + arg.expr->type.name() + " cannot be casted to " + type_name.name() + " in " + operation_name + " expression.");
 				}
-				arg.type = "";
+				arg.type = Type();
 			}
 			const typename ProgramTree::literal_type<LT>::type* val = nullptr;
 			ProgramTree::LiteralGetter<LT> lg(val);
@@ -371,32 +366,32 @@ namespace {
 		}
 
 		virtual void apply(UnaryOperator<UnOpType::IntNegation>& arg) {
-			apply_unary<LiteralType::Integer>(arg, [](literal_type<LiteralType::Integer>::type i){return -i;}, INT_NAME, "an int negation");
+			apply_unary<LiteralType::Integer>(arg, [](literal_type<LiteralType::Integer>::type i){return -i;}, INT_TYPE, "an int negation");
 		}
 
 		virtual void apply(UnaryOperator<UnOpType::BoolNegation>& arg) {
-			apply_unary<LiteralType::Bool>(arg, [](literal_type<LiteralType::Bool>::type b){return !b;}, BOOL_NAME, "a bool negation");
+			apply_unary<LiteralType::Bool>(arg, [](literal_type<LiteralType::Bool>::type b){return !b;}, BOOL_TYPE, "a bool negation");
 		}
 
 		virtual void apply(Literal<LiteralType::Bool>& arg) {
 			side_effects = false;
 			variable_access = false;
 			optimized_expression = nullptr;
-			arg.type = BOOL_NAME;
+			arg.type = BOOL_TYPE;
 		}
 
 		virtual void apply(Literal<LiteralType::Integer>& arg) {
 			side_effects = false;
 			variable_access = false;
 			optimized_expression = nullptr;
-			arg.type = INT_NAME;
+			arg.type = INT_TYPE;
 		}
 
 		virtual void apply(Literal<LiteralType::String>& arg) {
 			side_effects = false;
 			variable_access = false;
 			optimized_expression = nullptr;
-			arg.type = STR_NAME;
+			arg.type = STR_TYPE;
 		}
 
 		virtual void apply(Variable& arg) {
@@ -409,12 +404,12 @@ namespace {
 			 */
 			side_effects = false;
 			optimized_expression = nullptr;
-			if(variables.find(arg.name) != variables.end()) {
-				arg.type = variables.at(arg.name).top();
+			if(const Type* type = variables.find(arg.name)) {
+				arg.type = *type;
 				variable_access = true;
 			} else if (class_name && info.classes.at(*class_name)->function_name_to_id.find(arg.name) != info.classes.at(*class_name)->function_name_to_id.end()) {
 				const auto& f = info.classes.at(*class_name)->functions[info.classes.at(*class_name)->function_name_to_id.at(arg.name)];
-				arg.type = build_function_type_string(f->return_type, f->args);
+				arg.type = function_type(f->return_type, f->args);
 				variable_access = false;
 				std::unique_ptr<Variable> opt_var = std::make_unique<Variable>(arg.begin, arg.begin, std::string(THIS_NAME));
 				opt_var->type = *class_name;
@@ -432,15 +427,15 @@ namespace {
 				variable_access = true;
 			} else if (info.functions.find(arg.name) != info.functions.end()) {
 				const auto& f = info.functions.at(arg.name);
-				arg.type = build_function_type_string(f->return_type, f->args);
+				arg.type = function_type(f->return_type, f->args);
 				variable_access = false;
 			} else if (BUILTIN_FUNCTIONS.find(arg.name) != BUILTIN_FUNCTIONS.end()) {
 				const auto& f = BUILTIN_FUNCTIONS.at(arg.name);
-				arg.type = build_function_type_string(f.first, f.second);
+				arg.type = function_type(f.first, f.second);
 				variable_access = false;
 			} else {
-				push_error(arg.begin, arg.end, "use of undeclared variable/function " + arg.name + '.');
-				arg.type = "";
+				push_error(arg.begin, arg.end, "use of undeclared variable/function " + arg.name.name() + '.');
+				arg.type = Type();
 				variable_access = false;
 			}
 		}
@@ -448,7 +443,7 @@ namespace {
 		virtual void apply(Null& arg) {
 			side_effects = false;
 			optimized_expression = nullptr;
-			arg.type = Token::TYPE_NAMES.at(Token::Type::KEYWORD_NULL);
+			arg.type = NULL_TYPE;
 			variable_access = true;
 		}
 
@@ -463,7 +458,7 @@ namespace {
 		}
 
 		virtual void apply(CallOperator& arg) {
-			std::vector<std::string> actual_args;
+			std::vector<Type> actual_args;
 			bool valid = true;
 			for(auto& a : arg.args) {
 				a->visit(this);
@@ -483,11 +478,11 @@ namespace {
 				valid = false;
 			}
 			if(!valid) {
-				arg.type = "";
+				arg.type = Type();
 			} else {
-				if(arg.fun->type[0] == '@') {
+				if(arg.fun->type.is_function()) {
 					bool valid = true;
-					std::vector<std::string> declared_args = get_args_from_function_string(arg.fun->type);
+					const std::vector<Type>& declared_args = arg.fun->type.arguments();
 					if(declared_args.size() != actual_args.size()) {
 						valid = false;
 					} else {
@@ -498,14 +493,14 @@ namespace {
 						}
 					}
 					if(!valid) {
-						push_error(arg.begin, arg.end, "type " + arg.fun->type + " cannot be called with arguments: " + build_function_arg_string(actual_args));
-						arg.type = "";
+						push_error(arg.begin, arg.end, "type " + arg.fun->type.name() + " cannot be called with arguments: " + build_function_arg_string(actual_args));
+						arg.type = Type();
 					} else {
-						arg.type = arg.fun->type.substr(arg.fun->type.find('<') + 1, arg.fun->type.find('(') - arg.fun->type.find('<') - 1);
+						arg.type = arg.fun->type.return_type();
 					}
 				} else {
-					push_error(arg.begin, arg.end, "type " + arg.fun->type + " does not support the call operator.");
-					arg.type = "";
+					push_error(arg.begin, arg.end, "type " + arg.fun->type.name() + " does not support the call operator.");
+					arg.type = Type();
 				}
 			}
 			variable_access = false;
@@ -513,7 +508,13 @@ namespace {
 			optimized_expression = nullptr;
 			FunctionSourceSetter fss(optimized_expression, arg.args);
 			arg.fun->visit(&fss);
-			optimized_expression->type = std::move(arg.type);
+			optimized_expression->type = arg.type;
+			StaticFunctionCall* call = get_node<StaticFunctionCall>(*optimized_expression);
+			if(call && info.functions.find(call->fun) != info.functions.end()) {
+				function->called_functions.insert(call->fun);
+			} else {
+				function->side_effects = true;
+			}
 		}
 
 		virtual void apply(SubscriptOperator& arg) {
@@ -522,21 +523,21 @@ namespace {
 				std::swap(arg.index, optimized_expression);
 			}
 			bool index_side_effects = side_effects;
-			if(!arg.index->type.empty() && !does_cast_implicitly(info, arg.index->type, INT_NAME)) {
-				push_error(arg.begin, arg.end, " cannot cast from type " + arg.index->type + " to " + INT_NAME + " as the index argument in the array subscript operator.");
+			if(!arg.index->type.empty() && !does_cast_implicitly(info, arg.index->type, INT_TYPE)) {
+				push_error(arg.begin, arg.end, " cannot cast from type " + arg.index->type.name() + " to " + INT_NAME + " as the index argument in the array subscript operator.");
 			}
 			arg.arr->visit(this);
 			if(optimized_expression) {
-				std::swap(arg.index, optimized_expression);
+				std::swap(arg.arr, optimized_expression);
 			}
 			optimized_expression = nullptr;
 			side_effects = index_side_effects || side_effects;
 			if(arg.arr->type.empty()){
-				arg.type = "";
-			} else if(!is_array(arg.arr->type)) {
-				push_error(arg.begin, arg.end, " type " + arg.arr->type + " does not support index subscript operator.");
+				arg.type = Type();
+			} else if(!arg.arr->type.is_array()) {
+				push_error(arg.begin, arg.end, " type " + arg.arr->type.name() + " does not support index subscript operator.");
 			} else {
-				arg.type = arg.arr->type.substr(0, arg.arr->type.size() - 2);
+				arg.type = arg.arr->type.element();
 			}
 		}
 
@@ -547,19 +548,19 @@ namespace {
 				optimized_expression = nullptr;
 			}
 			if(!arg.object->type.empty()) {
-				if(is_array(arg.object->type)) {
+				if(arg.object->type.is_array()) {
 					if(arg.member == LENGTH_ATTR_NAME) {
-						arg.type = INT_NAME;
+						arg.type = INT_TYPE;
 					} else {
-						arg.type = "";
+						arg.type = Type();
 						push_error(arg.begin, arg.end, "member access operator applied to an array requests member " + arg.member + " but only " + LENGTH_ATTR_NAME + " is available.");
 					}
 					variable_access = false;
 				} else {
-					const auto ci = info.classes.find(arg.object->type);
+					const auto ci = info.classes.find(arg.object->type.name());
 					if(ci == info.classes.end()) {
-						push_error(arg.begin, arg.end, "member access operator applied to a non-class non-array type " + arg.object->type);
-						arg.type = "";
+						push_error(arg.begin, arg.end, "member access operator applied to a non-class non-array type " + arg.object->type.name());
+						arg.type = Type();
 						variable_access = true;
 						return;
 					}
@@ -567,18 +568,18 @@ namespace {
 					auto as_var = c.variable_name_to_id.find(arg.member);
 					auto as_fun = c.function_name_to_id.find(arg.member);
 					if(as_var != c.variable_name_to_id.end() && as_fun != c.function_name_to_id.end()) {
-						push_error(arg.begin, arg.end, "ambiguous member access: " + arg.member + " of the class " + arg.object->type + " can be both a variable and a function.");
-						arg.type = "";
+						push_error(arg.begin, arg.end, "ambiguous member access: " + arg.member + " of the class " + arg.object->type.name() + " can be both a variable and a function.");
+						arg.type = Type();
 						variable_access = true;
 					} else if(as_var == c.variable_name_to_id.end() && as_fun == c.function_name_to_id.end()) {
-						push_error(arg.begin, arg.end, "member " + arg.member + " of the class " + arg.object->type + " not found.");
-						arg.type = "";
+						push_error(arg.begin, arg.end, "member " + arg.member + " of the class " + arg.object->type.name() + " not found.");
+						arg.type = Type();
 						variable_access = true;
 					} else if(as_var != c.variable_name_to_id.end()) {
 						arg.type = c.variables[as_var->second].first;
 						variable_access = true;
 					} else {
-						arg.type = build_function_type_string(c.functions[as_fun->second]->return_type, c.functions[as_fun->second]->args);
+						arg.type = function_type(c.functions[as_fun->second]->return_type, c.functions[as_fun->second]->args);
 						variable_access = false;
 					}
 				}
@@ -591,8 +592,8 @@ namespace {
 				std::swap(arg.expr, optimized_expression);
 			}
 			if(!does_explicit_cast(info, arg.expr->type, arg.target)) {
-				arg.type = "";
-				push_error(arg.begin, arg.end, " cannot explicitly cast from " + arg.expr->type + " to " + arg.target + '.');
+				arg.type = Type();
+				push_error(arg.begin, arg.end, " cannot explicitly cast from " + arg.expr->type.name() + " to " + arg.target.name() + '.');
 			} else {
 				arg.type = arg.target;
 			}
@@ -602,9 +603,9 @@ namespace {
 			optimized_expression = nullptr;
 			side_effects = false;
 			variable_access = false;
-			if(info.classes.find(arg.new_type) == info.classes.end()) {
-				arg.type = "";
-				push_error(arg.begin, arg.end, " cannot construct a new object of unknown class " + arg.new_type + '.');
+			if(arg.new_type.kind() != TypeKind::Class || info.classes.find(arg.new_type.name()) == info.classes.end()) {
+				arg.type = Type();
+				push_error(arg.begin, arg.end, " cannot construct a new object of unknown class " + arg.new_type.name() + '.');
 			} else {
 				arg.type = arg.new_type;
 			}
@@ -612,19 +613,19 @@ namespace {
 
 		virtual void apply(NewArray& arg) {
 			arg.size->visit(this);
-			if(!arg.size->type.empty() && !does_cast_implicitly(info, arg.size->type, INT_NAME)) {
-				push_error(arg.begin, arg.end, " cannot cast from type " + arg.size->type + " to " + INT_NAME + " as the size argument in the construction of an array.");
+			if(!arg.size->type.empty() && !does_cast_implicitly(info, arg.size->type, INT_TYPE)) {
+				push_error(arg.begin, arg.end, " cannot cast from type " + arg.size->type.name() + " to " + INT_NAME + " as the size argument in the construction of an array.");
 			}
 			if(optimized_expression) {
 				std::swap(arg.size, optimized_expression);
 			}
 			optimized_expression = nullptr;
 			variable_access = false;
-			if(info.classes.find(arg.new_type) == info.classes.end() && DEFAULT_TYPES.find(arg.new_type) == DEFAULT_TYPES.end()) {
-				arg.type = "";
-				push_error(arg.begin, arg.end, " cannot construct a new array of unknown type " + arg.new_type + '.');
+			if(!is_known_type(info, arg.new_type)) {
+				arg.type = Type();
+				push_error(arg.begin, arg.end, " cannot construct a new array of unknown type " + arg.new_type.name() + '.');
 			} else {
-				arg.type = arg.new_type + "[]";
+				arg.type = arg.new_type.array();
 			}
 		}
 
@@ -638,11 +639,12 @@ namespace {
 				std::swap(arg.var, optimized_expression);
 			}
 			if(!arg.value->type.empty() && !arg.var->type.empty() && !does_cast_implicitly(info, arg.value->type, arg.var->type)) {
-				push_error(arg.begin, arg.end, "cannot cast from " + arg.value->type + " to " + arg.var->type + " for assignment.");
+				push_error(arg.begin, arg.end, "cannot cast from " + arg.value->type.name() + " to " + arg.var->type.name() + " for assignment.");
 			}
 			if(!arg.var->type.empty() && !variable_access) {
 				push_error(arg.begin, arg.end, "assignment expects a variable.");
 			}
+			note_write(*arg.var);
 			does_return = false;
 			optimized_statement = nullptr;
 		}
@@ -653,12 +655,13 @@ namespace {
 			if(optimized_expression) {
 				std::swap(expr, optimized_expression);
 			}
-			if(!expr->type.empty() && !does_cast_implicitly(info, expr->type, INT_NAME)) {
-				push_error(expr->begin, expr->end, "cannot cast from " + expr->type + " to " + INT_NAME + " for incrementation/decrementation.");
+			if(!expr->type.empty() && !does_cast_implicitly(info, expr->type, INT_TYPE)) {
+				push_error(expr->begin, expr->end, "cannot cast from " + expr->type.name() + " to " + INT_NAME + " for incrementation/decrementation.");
 			}
 			if(!variable_access) {
 				push_error(expr->begin, expr->end, "incrementation/decrementation expects a variable.");
 			}
+			note_write(*expr);
 			optimized_statement = nullptr;
 		}
 
@@ -684,7 +687,7 @@ namespace {
 			optimized_statement = nullptr;
 			does_return = true;
 			if(!arg.val) {
-				if(*declared_return_type != VOID_NAME) {
+				if(declared_return_type != VOID_TYPE) {
 					push_error(arg.begin, arg.end, "argumentless return in a non-void function");
 				}
 				return;
@@ -693,8 +696,8 @@ namespace {
 			if(optimized_expression) {
 				std::swap(arg.val, optimized_expression);
 			}
-			if(!arg.val->type.empty() && !does_cast_implicitly(info, arg.val->type, *declared_return_type)) {
-				push_error(arg.begin, arg.end, "cannot cast from " + arg.val->type + " to " + (*declared_return_type) + " in the return statement.");
+			if(!arg.val->type.empty() && !does_cast_implicitly(info, arg.val->type, declared_return_type)) {
+				push_error(arg.begin, arg.end, "cannot cast from " + arg.val->type.name() + " to " + declared_return_type.name() + " in the return statement.");
 			}
 		}
 
@@ -704,8 +707,8 @@ namespace {
 			if(optimized_expression) {
 				std::swap(optimized_expression, arg.condition);
 			}
-			if(!arg.condition->type.empty() && !does_cast_implicitly(info, arg.condition->type, BOOL_NAME)) {
-				push_error(arg.begin, arg.end, "cannot cast from " + arg.condition->type + " to bool in the condition of if statement.");
+			if(!arg.condition->type.empty() && !does_cast_implicitly(info, arg.condition->type, BOOL_TYPE)) {
+				push_error(arg.begin, arg.end, "cannot cast from " + arg.condition->type.name() + " to bool in the condition of if statement.");
 			}
 			arg.case_then->visit(this);
 			if(optimized_statement) {
@@ -758,8 +761,8 @@ namespace {
 			if(optimized_expression) {
 				std::swap(optimized_expression, arg.condition);
 			}
-			if(!arg.condition->type.empty() && !does_cast_implicitly(info, arg.condition->type, BOOL_NAME)) {
-				push_error(arg.condition->begin, arg.condition->end, "cannot cast from " + arg.condition->type + " to boolean in the condition of while loop.");
+			if(!arg.condition->type.empty() && !does_cast_implicitly(info, arg.condition->type, BOOL_TYPE)) {
+				push_error(arg.condition->begin, arg.condition->end, "cannot cast from " + arg.condition->type.name() + " to boolean in the condition of while loop.");
 			}
 			arg.action->visit(this);
 			if(optimized_statement) {
@@ -800,28 +803,28 @@ namespace {
 				std::swap(optimized_expression, arg.array);
 			}
 			if(!arg.array->type.empty()) {
-				if(!is_array(arg.array->type)) {
+				if(!arg.array->type.is_array()) {
 					push_error(arg.array->begin, arg.array->end, "non-array type used as a for argument.");
-				} else if (!does_cast_implicitly(info, arg.array->type.substr(0, arg.array->type.size() - 2), arg.var_type)) {
-					push_error(arg.array->begin, arg.array->end, "type " + arg.array->type.substr(0, arg.array->type.size() - 2) + " does not implicitly cast to " + arg.var_type + " in for argument.");
+				} else if (!does_cast_implicitly(info, arg.array->type.element(), arg.var_type)) {
+					push_error(arg.array->begin, arg.array->end, "type " + arg.array->type.element().name() + " does not implicitly cast to " + arg.var_type.name() + " in for argument.");
 				}
 			}
-			if(info.classes.find(arg.var_type) == info.classes.end() && DEFAULT_TYPES.find(arg.var_type) == DEFAULT_TYPES.end()) {
-				push_error(arg.begin, arg.end, "Usage of undeclared type " + arg.var_type);
+			if(!is_known_type(info, arg.var_type)) {
+				push_error(arg.begin, arg.end, "Usage of undeclared type " + arg.var_type.name());
 			}
-			last_block_declarations.emplace(std::set<std::string>({arg.var_name}));
-			variables[arg.var_name].push(arg.var_type);
+			variables.enter();
+			variables.declare(arg.var_name, arg.var_type);
 			arg.action->visit(this);
 			if(optimized_statement) {
 				std::swap(optimized_statement, arg.action);
 			}
-			remove_last_variable_block();
+			variables.leave();
 			does_return = false;
 			optimized_statement = nullptr;
 		}
 
 		virtual void apply(Block& arg) {
-			last_block_declarations.emplace();
+			variables.enter();
 			bool valid_return = false;
 			for(auto& s : arg.statements) {
 				s->visit(this);
@@ -835,7 +838,7 @@ namespace {
 				}
 			}
 			does_return = valid_return;
-			remove_last_variable_block();
+			variables.leave();
 			optimized_statement = nullptr;
 		}
 
@@ -848,12 +851,9 @@ namespace {
 		virtual void apply(Definition& arg) {
 			does_return = false;
 			{
-				std::string type = arg.type;
-				if(is_array(arg.type)) {
-					type = type.substr(0, type.size() - 2);
-				}
-				if(info.classes.find(type) == info.classes.end() && DEFAULT_TYPES.find(type) == DEFAULT_TYPES.end()) {
-					push_error(arg.begin, arg.end, "Usage of undeclared type " + type);
+				Type type = arg.type.is_array() ? arg.type.element() : arg.type;
+				if(!is_known_type(info, type)) {
+					push_error(arg.begin, arg.end, "Usage of undeclared type " + type.name());
 				}
 			}
 			for(auto& def : arg.defs) {
@@ -863,14 +863,13 @@ namespace {
 						std::swap(optimized_expression, def.second);
 					}
 					if(!def.second->type.empty() && !does_cast_implicitly(info, def.second->type, arg.type)) {
-						push_error(arg.begin, arg.end, "cannot cast from " + def.second->type + " to " + arg.type + " in the definition of variable " + def.first);
+						push_error(arg.begin, arg.end, "cannot cast from " + def.second->type.name() + " to " + arg.type.name() + " in the definition of variable " + def.first.name());
 					}
 				}
-				if(last_block_declarations.top().count(def.first)) {
-					push_error(arg.begin, arg.end, "redeclaration of variable " + def.first);
+				if(variables.declared_in_block(def.first)) {
+					push_error(arg.begin, arg.end, "redeclaration of variable " + def.first.name());
 				} else {
-					variables[def.first].push(arg.type);
-					last_block_declarations.top().insert(def.first);
+					variables.declare(def.first, arg.type);
 				}
 			}
 			optimized_statement = nullptr;
@@ -878,16 +877,18 @@ namespace {
 
 		TypeCheckerVisitor() = delete;
 		TypeCheckerVisitor(const TypeInfo& info, std::list<TypeCheckerError>& errors) : info(info), errors(errors) {}
-		void check(const FunctionInfo& fun, const std::string* f_name, const std::string* cl_name = nullptr) {
-			declared_return_type = &(fun.return_type);
+		void check(FunctionInfo& fun, const std::string* f_name, const std::string* cl_name = nullptr) {
+			function = &fun;
+			function->called_functions.clear();
+			function->side_effects = false;
+			declared_return_type = fun.return_type;
 			fun_name = f_name;
 			class_name = cl_name;
 			does_return = false;
-			last_block_declarations.emplace();
 			variables.clear();
+			variables.enter();
 			for(const auto& a : fun.args) {
-				variables[a.second].push(a.first);
-				last_block_declarations.top().insert(a.second);
+				variables.declare(a.second, a.first);
 			}
 			bool valid_return = false;
 			for(auto& s : fun.data->body->statements) {
@@ -902,7 +903,7 @@ namespace {
 				}
 			}
 			if(!valid_return) {
-				if(fun.return_type == VOID_NAME) {
+				if(fun.return_type == VOID_TYPE) {
 					fun.data->body->statements.push_back(std::make_unique<Return>(fun.data->body->end, fun.data->body->end, nullptr));
 				} else {
 					push_error(fun.data->body->end, fun.data->body->end, "not all paths return a value in a non-void function.");
@@ -911,12 +912,12 @@ namespace {
 		}
 	private:
 		const TypeInfo& info;
-		std::map<std::string, std::stack<std::string>> variables;
+		ScopedTable<Type> variables;
 		std::list<TypeCheckerError>& errors;
-		const std::string* declared_return_type;
+		Type declared_return_type;
+		FunctionInfo* function;
 		std::unique_ptr<ProgramTree::Statement> optimized_statement;
 		std::unique_ptr<ProgramTree::Expression> optimized_expression;
-		std::stack<std::set<std::string>> last_block_declarations;
 		const std::string* fun_name;
 		bool does_return;
 		bool side_effects;
@@ -927,15 +928,11 @@ namespace {
 			errors.emplace_back(begin, end, "Function " + (*fun_name) + ": " + msg);
 		}
 
-		void remove_last_variable_block(){
-			for(const auto& var : last_block_declarations.top()) {
-				auto st = variables.find(var);
-				st->second.pop();
-				if(st->second.empty()) {
-					variables.erase(st);
-				}
+		//writes to local variables and array elements aren't side effects, writes to fields are
+		void note_write(Expression& target) {
+			if(get_node<ClassMember>(target)) {
+				function->side_effects = true;
 			}
-			last_block_declarations.pop();
 		}
 	};
 }
@@ -953,10 +950,34 @@ namespace TypeChecker {
 		TypeChecker() = delete;
 		TypeChecker(const TypeInfo& info) : info(info) {}
 
-		void check_types() {
-			TypeCheckerVisitor v(info, errors);
+		//a function checked on its own, with its own errors
+		struct FunctionCheck {
+			FunctionInfo* function;
+			const std::string* name;
+			const std::string* class_name;
+			std::list<TypeCheckerError> errors;
+		};
+
+		//the bodies are independent once the program info is built, their errors are merged in the order of a serial check
+		void check_types(size_t threads) {
+			std::vector<FunctionCheck> checks;
 			for(const auto& f : info.functions) {
-				v.check(*f.second, &f.first);
+				checks.push_back({f.second.get(), &f.first, nullptr, {}});
+			}
+			for(const auto& c : info.classes) {
+				for(const auto& f : c.second->function_name_to_id) {
+					if(c.second->functions[f.second]->class_info->data->name == c.second->data->name) {
+						checks.push_back({c.second->functions[f.second].get(), &f.first, &(c.first), {}});
+					}
+				}
+			}
+			parallel_for(checks.size(), threads, [&](size_t i) {
+				TypeCheckerVisitor v(info, checks[i].errors);
+				v.check(*checks[i].function, checks[i].name, checks[i].class_name);
+			});
+			auto check = checks.begin();
+			for(; check != checks.end() && !check->class_name; ++check) {
+				errors.splice(errors.end(), check->errors);
 			}
 			for(const auto& c : info.classes) {
 				if(c.second->inheritance_tree_node->parent) {
@@ -968,7 +989,7 @@ namespace TypeChecker {
 							continue;
 						}
 						if(!does_cast_implicitly(info, ifun->return_type, sfun->return_type)) {
-							push_error(ifun->data->dec_begin, ifun->data->dec_end, "Class " + c.second->data->name + ": overridden function " + fun.first + ": cannot implicitly cast type " + ifun->return_type + " to " + sfun->return_type + " as the return type.");
+							push_error(ifun->data->dec_begin, ifun->data->dec_end, "Class " + c.second->data->name + ": overridden function " + fun.first + ": cannot implicitly cast type " + ifun->return_type.name() + " to " + sfun->return_type.name() + " as the return type.");
 						}
 						if(sfun->args.size() != ifun->args.size()) {
 							push_error(ifun->data->dec_begin, ifun->data->dec_end, "Class " + c.second->data->name + ": overridden function " + fun.first + " has an incorrect argument count.");
@@ -976,30 +997,63 @@ namespace TypeChecker {
 						}
 						for(size_t i = 0; i < sfun->args.size(); ++i) {
 							if(!does_cast_implicitly(info, sfun->return_type, ifun->return_type)) {
-								push_error(ifun->data->dec_begin, ifun->data->dec_end, "Class " + c.second->data->name + ": overridden function " + fun.first + ": cannot implicitly cast type " + ifun->return_type + " to " + sfun->return_type + " as the type of argument " + std::to_string(i) + '.');
+								push_error(ifun->data->dec_begin, ifun->data->dec_end, "Class " + c.second->data->name + ": overridden function " + fun.first + ": cannot implicitly cast type " + ifun->return_type.name() + " to " + sfun->return_type.name() + " as the type of argument " + std::to_string(i) + '.');
 							}
 						}
 					}
 				}
-				for(const auto& f : c.second->function_name_to_id) {
-					if(c.second->functions[f.second]->class_info->data->name == c.second->data->name) {
-						v.check(*(c.second->functions[f.second]), &f.first, &(c.first));
+				for(; check != checks.end() && check->class_name == &(c.first); ++check) {
+					errors.splice(errors.end(), check->errors);
+				}
+			}
+			propagate_side_effects();
+		}
+
+		//a function has side effects if any of the functions it calls has them
+		void propagate_side_effects() {
+			std::vector<FunctionInfo*> functions;
+			for(const auto& f : info.functions) {
+				functions.push_back(f.second.get());
+			}
+			for(const auto& c : info.classes) {
+				for(const auto& f : c.second->functions) {
+					if(f->class_info == c.second.get()) {
+						functions.push_back(f.get());
+					}
+				}
+			}
+			bool changed = true;
+			while(changed) {
+				changed = false;
+				for(FunctionInfo* f : functions) {
+					if(f->side_effects) {
+						continue;
+					}
+					for(const auto& callee : f->called_functions) {
+						if(info.functions.at(callee)->side_effects) {
+							f->side_effects = true;
+							changed = true;
+							break;
+						}
 					}
 				}
 			}
 		}
 
-		friend TypeInfo check_types(ProgramTree::Program& prog);
+		friend void check_types(const TypeInfo& info, size_t threads);
 	};
 
-	TypeInfo check_types(ProgramTree::Program& prog) {
-		TypeInfo info = build_program_info(prog);
+	void check_types(const TypeInfo& info, size_t threads) {
 		TypeChecker c(info);
-		c.check_types();
-		if(c.errors.empty()) {
-			return info;
-		} else {
+		c.check_types(threads);
+		if(!c.errors.empty()) {
 			throw TypeCheckerException(std::move(c.errors));
 		}
 	}
+
+	TypeInfo check_types(ProgramTree::Program& prog, size_t threads) {
+		TypeInfo info = build_program_info(prog);
+		check_types(info, threads);
+		return info;
+	}
 }
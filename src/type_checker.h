@@ -4,7 +4,11 @@
 #include "type_info_builder.h"
 
 namespace TypeChecker {
-	TypeInfo check_types(ProgramTree::Program& prog);
+	//the function bodies are checked on the given number of threads, the result doesn't depend on it
+	TypeInfo check_types(ProgramTree::Program& prog, size_t threads = 1);
+
+	//the same for a program whose info has already been built
+	void check_types(const TypeInfo& info, size_t threads = 1);
 }
 
 #endif
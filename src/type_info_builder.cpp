@@ -1,14 +1,16 @@
 #include "type_info_builder.h"
 
+#include <utility>
+
 using namespace ProgramTree;
 
 TypeChecker::ClassInfo::ClassInfo(const std::shared_ptr<ProgramTree::Class>& data) : inheritance_tree_node(nullptr), data(data) {}
 
-TypeChecker::InheritanceTreeNode::InheritanceTreeNode(ClassInfo* class_info) : parent(nullptr), class_info(class_info) {}
+TypeChecker::InheritanceTreeNode::InheritanceTreeNode(ClassInfo* class_info) : parent(nullptr), class_info(class_info), preorder(0), postorder(0) {}
 
-TypeChecker::InheritanceTreeNode::InheritanceTreeNode(InheritanceTreeNode* parent, ClassInfo* class_info) : parent(parent), class_info(class_info) {}
+TypeChecker::InheritanceTreeNode::InheritanceTreeNode(InheritanceTreeNode* parent, ClassInfo* class_info) : parent(parent), class_info(class_info), preorder(0), postorder(0) {}
 
-TypeChecker::FunctionInfo::FunctionInfo(const std::shared_ptr<Function>& data, const std::string& return_type, std::vector<std::pair<std::string, std::string>>&& args) : data(data), return_type(return_type), args(std::move(args)) {}
+TypeChecker::FunctionInfo::FunctionInfo(const std::shared_ptr<Function>& data, Type return_type, std::vector<std::pair<Type, std::string>>&& args) : data(data), return_type(return_type), args(std::move(args)), side_effects(false) {}
 
 TypeChecker::VirtualFunctionInfo::VirtualFunctionInfo(FunctionInfo&& base, ClassInfo* class_info) : FunctionInfo(std::move(base)), class_info(class_info) {}
 
@@ -44,7 +46,8 @@ namespace TypeChecker {
 					add = false;
 				}
 				if(add) {
-					result.classes.emplace(std::make_pair(c->name, std::make_unique<ClassInfo>(c)));
+					auto r = result.classes.emplace(std::make_pair(c->name, std::make_unique<ClassInfo>(c)));
+					result.class_types.emplace(Type(c->name).id(), r.first->second.get());
 				}
 			}
 		}
@@ -92,22 +95,49 @@ namespace TypeChecker {
 			}
 		}
 
-		bool is_valid_type(const std::string& name, bool with_void) {
-			const std::string* type = &name;
-			std::string sname;
-			if(name.size() >= 2 && name[name.size() - 1] == ']' && name[name.size() - 2] == '[') {
-				sname = name.substr(0, name.size() - 2);
-				type = &sname;
+		//without recursion, the generated hierarchies can be deep
+		void number_inheritance_tree() {
+			size_t time = 0;
+			std::vector<std::pair<InheritanceTreeNode*, size_t>> stack; //nodes with the index of the next child to enter
+			for(std::shared_ptr<InheritanceTreeNode>& root : result.inheritance_tree) {
+				root->preorder = time++;
+				stack.emplace_back(root.get(), 0);
+				while(!stack.empty()) {
+					InheritanceTreeNode* node = stack.back().first;
+					size_t& next = stack.back().second;
+					if(next < node->children.size()) {
+						InheritanceTreeNode* child = node->children[next++].get();
+						child->preorder = time++;
+						stack.emplace_back(child, 0);
+					} else {
+						node->postorder = time++;
+						stack.pop_back();
+					}
+				}
+			}
+		}
+
+		bool is_valid_type(Type type, bool with_void) {
+			if(type.is_array()) {
+				type = type.element();
 			}
-			if((!with_void && *type == VOID_NAME)) {
-				return false;
+			switch(type.kind()) {
+				case TypeKind::Void:
+					return with_void;
+				case TypeKind::Int:
+				case TypeKind::String:
+				case TypeKind::Bool:
+					return true;
+				case TypeKind::Class:
+					return result.classes.find(type.name()) != result.classes.end();
+				default:
+					return false;
 			}
-			return !(DEFAULT_TYPES.find(*type) == DEFAULT_TYPES.end() && result.classes.find(*type) == result.classes.end());
 		}
 
 		std::pair<size_t, size_t> find_class_variable_declaration_location(const Class& cl, const std::string& variable_name) {
 			for(const std::unique_ptr<Definition>& var : cl.variables) {
-				for(const std::pair<std::string, std::unique_ptr<Expression>>& def : var->defs) {
+				for(const std::pair<Symbol, std::unique_ptr<Expression>>& def : var->defs) {
 					if(def.first == variable_name) {
 						return std::pair<size_t, size_t>(var->begin, var->end);
 					}
@@ -116,7 +146,7 @@ namespace TypeChecker {
 			throw std::runtime_error("Type checker internal error.");
 		}
 
-		void inherit_class_variables(InheritanceTreeNode& node, std::map<std::string, std::map<std::string, std::string>>& vars) {
+		void inherit_class_variables(InheritanceTreeNode& node, std::map<std::string, std::map<std::string, Type>>& vars) {
 			node.class_info->variables = node.parent->class_info->variables;
 			node.class_info->variable_name_to_id = node.parent->class_info->variable_name_to_id;
 			size_t counter = node.class_info->variables.size();
@@ -135,24 +165,24 @@ namespace TypeChecker {
 		}
 
 		void gather_class_variables() {
-			std::map<std::string, std::map<std::string, std::string>> vars;
+			std::map<std::string, std::map<std::string, Type>> vars;
 			for(const std::shared_ptr<Class>& c : prog.classes) {
 				vars[c->name];
 				for(const std::unique_ptr<Definition>& var : c->variables) {
 					bool t_add = true;
 					if (!is_valid_type(var->type, false)) {
-						push_error(var->begin, var->end, "Class " + c->name + " contains a variable of unknown type " + var->type + '.');
+						push_error(var->begin, var->end, "Class " + c->name + " contains a variable of unknown type " + var->type.name() + '.');
 						t_add = false;
 					}
-					std::map<std::string, std::string>& var_map = vars[c->name];
-					for(const std::pair<std::string, std::unique_ptr<Expression>>& v : var->defs) {
+					std::map<std::string, Type>& var_map = vars[c->name];
+					for(const std::pair<Symbol, std::unique_ptr<Expression>>& v : var->defs) {
 						bool v_add = true;
 						if(var_map.find(v.first) != var_map.end()) {
-							push_error(var->begin, var->end, "Class " + c->name + " contains a redeclaration of variable " + v.first + '.');
+							push_error(var->begin, var->end, "Class " + c->name + " contains a redeclaration of variable " + v.first.name() + '.');
 							v_add = false;
 						}
 						if(v.second) {
-							push_error(v.second->begin, v.second->end, "Class " + c->name + " contains a definition of variable " + v.first + ", expected just a declaration.");
+							push_error(v.second->begin, v.second->end, "Class " + c->name + " contains a definition of variable " + v.first.name() + ", expected just a declaration.");
 							v_add = false;
 						}
 						if(t_add && v_add) {
@@ -174,7 +204,7 @@ namespace TypeChecker {
 		}
 
 		FunctionInfo read_function_info(const std::shared_ptr<ProgramTree::Function> fun) {
-			std::vector<std::pair<std::string, std::string>> args;
+			std::vector<std::pair<Type, std::string>> args;
 			bool err = false;
 			if(!is_valid_type(fun->return_type, true)) {
 				err = true;
@@ -192,7 +222,7 @@ namespace TypeChecker {
 					err = true;
 					push_error(fun->dec_begin, fun->dec_end, "Function " + fun->name + " has an argument of unknown type " + arg.first + '.');
 				}
-				args.push_back(arg);
+				args.emplace_back(arg.first, arg.second);
 			}
 			if(!err) {
 				return FunctionInfo(fun, fun->return_type, std::move(args));
@@ -283,7 +313,9 @@ namespace TypeChecker {
 
 		InfoBuilder() = delete;
 
-		InfoBuilder(const ProgramTree::Program& prog) : prog(prog) {}
+		InfoBuilder(const ProgramTree::Program& prog) : prog(prog) {
+			result.arena = prog.arena;
+		}
 
 		friend TypeInfo build_program_info(const Program& prog);
 	};
@@ -292,6 +324,7 @@ namespace TypeChecker {
 		InfoBuilder b(prog);
 		b.gather_class_names();
 		b.build_inheritance_tree();
+		b.number_inheritance_tree();
 		b.gather_functions();
 		b.gather_class_variables();
 		b.gather_class_functions();
@@ -9,6 +9,7 @@
 #include <set>
 #include <sstream>
 #include <list>
+#include <unordered_map>
 
 namespace TypeChecker {
 	struct ClassInfo;
@@ -19,6 +20,12 @@ namespace TypeChecker {
 		std::vector<std::shared_ptr<InheritanceTreeNode>> children;
 		InheritanceTreeNode* parent;
 		ClassInfo* class_info;
+		//times of entering and leaving the node in a depth-first walk of the forest, the interval of a subclass is nested in the ones of its superclasses
+		size_t preorder;
+		size_t postorder;
+		bool is_subclass_of(const InheritanceTreeNode& other) const { //or the same class
+			return other.preorder <= preorder && postorder <= other.postorder;
+		}
 		InheritanceTreeNode(InheritanceTreeNode* parent, ClassInfo* class_info);
 		InheritanceTreeNode(ClassInfo* class_info);
 	private:
@@ -32,12 +39,14 @@ namespace TypeChecker {
 
 	struct FunctionInfo {
 		const std::shared_ptr<ProgramTree::Function> data;
-		std::string return_type;
-		std::vector<std::pair<std::string, std::string>> args;
+		ProgramTree::Type return_type;
+		std::vector<std::pair<ProgramTree::Type, std::string>> args;
+		std::set<std::string> called_functions; //global functions called in the body, to be set by the type checker
+		bool side_effects; //whether the function does IO, writes to fields or calls methods, also through the functions it calls (writes to arrays don't count), to be set by the type checker
 	private:
 		friend class InfoBuilder;
 		FunctionInfo() = delete;
-		FunctionInfo(const std::shared_ptr<ProgramTree::Function>& data, const std::string& return_type, std::vector<std::pair<std::string, std::string>>&& args);
+		FunctionInfo(const std::shared_ptr<ProgramTree::Function>& data, ProgramTree::Type return_type, std::vector<std::pair<ProgramTree::Type, std::string>>&& args);
 	};
 
 	struct VirtualFunctionInfo : public FunctionInfo {
@@ -51,7 +60,7 @@ namespace TypeChecker {
 	struct ClassInfo {
 		std::vector<std::shared_ptr<VirtualFunctionInfo>> functions;
 		std::map<std::string, size_t> function_name_to_id;
-		std::vector<std::pair<std::string, std::string>> variables;
+		std::vector<std::pair<ProgramTree::Type, std::string>> variables;
 		std::map<std::string, size_t> variable_name_to_id;
 		InheritanceTreeNode* inheritance_tree_node;
 		const std::shared_ptr<ProgramTree::Class> data;
@@ -66,7 +75,9 @@ namespace TypeChecker {
 	};
 
 	struct TypeInfo {
+		std::shared_ptr<Arena> arena; //keeps the nodes of the functions alive after the program
 		std::map<std::string, std::shared_ptr<ClassInfo>> classes;
+		std::unordered_map<ProgramTree::TypeId, ClassInfo*> class_types; //the same classes by the ids of their types
 		std::map<std::string, std::shared_ptr<FunctionInfo>> functions;
 		std::vector<std::shared_ptr<InheritanceTreeNode>> inheritance_tree;
 	private:
@@ -0,0 +1,97 @@
+#include "types.h"
+#include "program_tree.h"
+
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+
+using namespace ProgramTree;
+
+namespace {
+	//types are never removed, so the handles stay valid for the whole process
+	class TypeTable {
+		std::mutex mutex;
+		std::unordered_map<std::string, std::unique_ptr<TypeData>> types;
+		TypeId next_id;
+
+		//the mutex must be held
+		TypeData& add(const std::string& name, TypeKind kind) {
+			std::unique_ptr<TypeData>& data = types[name];
+			data.reset(new TypeData{name, next_id++, kind, Type(), Type(), {}});
+			return *data;
+		}
+
+		//the mutex must be held
+		const TypeData* find(const std::string& name) {
+			auto t = types.find(name);
+			if(t != types.end()) {
+				return t->second.get();
+			}
+			if(is_array(name)) {
+				Type element(find(name.substr(0, name.size() - 2)));
+				TypeData& data = add(name, TypeKind::Array);
+				data.element = element;
+				return &data;
+			}
+			return &add(name, TypeKind::Class);
+		}
+
+	public:
+		const TypeData* intern(const std::string& name) {
+			std::lock_guard<std::mutex> lock(mutex);
+			return find(name);
+		}
+
+		const TypeData* intern_function(Type return_type, const std::vector<Type>& arguments) {
+			std::string name = "@function<" + return_type.name() + '(';
+			for(size_t i = 0; i < arguments.size(); ++i) {
+				name += (i ? "," : "") + arguments[i].name();
+			}
+			name += ")>";
+			std::lock_guard<std::mutex> lock(mutex);
+			auto t = types.find(name);
+			if(t != types.end()) {
+				return t->second.get();
+			}
+			TypeData& data = add(name, TypeKind::Function);
+			data.return_type = return_type;
+			data.arguments = arguments;
+			return &data;
+		}
+
+		//the primitives come first, with the same ids in every run
+		TypeTable() : next_id(1) {
+			add(VOID_NAME, TypeKind::Void);
+			add(INT_NAME, TypeKind::Int);
+			add(STR_NAME, TypeKind::String);
+			add(BOOL_NAME, TypeKind::Bool);
+			add(NULL_NAME, TypeKind::Null);
+		}
+	};
+
+	TypeTable& table() {
+		static TypeTable result;
+		return result;
+	}
+}
+
+Type::Type(const std::string& name) : data(table().intern(name)) {}
+
+Type Type::function(Type return_type, const std::vector<Type>& arguments) {
+	return Type(table().intern_function(return_type, arguments));
+}
+
+Type Type::array() const {
+	return Type(name() + "[]");
+}
+
+std::ostream& ProgramTree::operator<<(std::ostream& output, Type type) {
+	return output << type.name();
+}
+
+const Type ProgramTree::VOID_TYPE(VOID_NAME);
+const Type ProgramTree::INT_TYPE(INT_NAME);
+const Type ProgramTree::STR_TYPE(STR_NAME);
+const Type ProgramTree::BOOL_TYPE(BOOL_NAME);
+const Type ProgramTree::NULL_TYPE(NULL_NAME);
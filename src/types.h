@@ -0,0 +1,109 @@
+#ifndef TYPES_H
+#define TYPES_H
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace ProgramTree {
+	using TypeId = uint32_t;
+
+	enum class TypeKind : uint8_t {
+		Unknown, Void, Int, String, Bool, Null, Class, Array, Function
+	};
+
+	struct TypeData;
+
+	//handle of a type interned in a table shared by the whole process, equal types have equal handles, the default one is the unknown type of an invalid expression
+	class Type {
+		const TypeData* data;
+
+	public:
+		//of the table
+		explicit Type(const TypeData* data) : data(data) {}
+
+		//void, int, string, boolean, null, a class or an array of them, classes aren't checked to exist
+		Type(const std::string& name);
+		Type() : data(nullptr) {}
+
+		//named @function<return_type(arguments)>
+		static Type function(Type return_type, const std::vector<Type>& arguments);
+
+		inline TypeId id() const; //0 for the unknown type
+		inline TypeKind kind() const;
+		inline const std::string& name() const; //empty for the unknown type
+		bool empty() const {
+			return !data;
+		}
+		bool is_array() const {
+			return kind() == TypeKind::Array;
+		}
+		bool is_function() const {
+			return kind() == TypeKind::Function;
+		}
+		inline Type element() const; //of an array
+		Type array() const; //of elements of this type
+		inline Type return_type() const; //of a function
+		inline const std::vector<Type>& arguments() const; //of a function
+
+		//for the code that looks classes up or prints the type
+		operator const std::string&() const {
+			return name();
+		}
+
+		friend bool operator==(Type a, Type b) {
+			return a.data == b.data;
+		}
+
+		friend bool operator!=(Type a, Type b) {
+			return a.data != b.data;
+		}
+	};
+
+	struct TypeData {
+		std::string name;
+		TypeId id;
+		TypeKind kind;
+		Type element; //of an array
+		Type return_type; //of a function
+		std::vector<Type> arguments; //of a function
+	};
+
+	TypeId Type::id() const {
+		return data ? data->id : 0;
+	}
+
+	TypeKind Type::kind() const {
+		return data ? data->kind : TypeKind::Unknown;
+	}
+
+	const std::string& Type::name() const {
+		static const std::string unknown;
+		return data ? data->name : unknown;
+	}
+
+	Type Type::element() const {
+		return data ? data->element : Type();
+	}
+
+	Type Type::return_type() const {
+		return data ? data->return_type : Type();
+	}
+
+	const std::vector<Type>& Type::arguments() const {
+		static const std::vector<Type> none;
+		return data ? data->arguments : none;
+	}
+
+	//the name
+	std::ostream& operator<<(std::ostream& output, Type type);
+
+	extern const Type VOID_TYPE;
+	extern const Type INT_TYPE;
+	extern const Type STR_TYPE;
+	extern const Type BOOL_TYPE;
+	extern const Type NULL_TYPE;
+}
+
+#endif
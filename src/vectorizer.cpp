@@ -0,0 +1,173 @@
+#include "vectorizer.h"
+#include "helper_visitors.h"
+
+using namespace ProgramTree;
+using namespace TypeChecker;
+
+namespace {
+	bool is_variable(Expression& e, const std::string& name) {
+		Variable* var = get_node<Variable>(e);
+		return var && var->name == name;
+	}
+
+	Statement& single_statement(Statement& s) {
+		Block* b = get_node<Block>(s);
+		if(b && b->statements.size() == 1) {
+			return *b->statements[0];
+		}
+		return s;
+	}
+
+	//array[index] with an int array stored in a variable
+	Variable* get_element(Expression& e, const std::string& index) {
+		SubscriptOperator* s = get_node<SubscriptOperator>(e);
+		if(!s || !is_variable(*s->index, index)) {
+			return nullptr;
+		}
+		Variable* arr = get_node<Variable>(*s->arr);
+		return arr && arr->type.is_array() && arr->type.element() == INT_TYPE ? arr : nullptr;
+	}
+
+	bool get_operand(Expression& e, const std::string& index, VectorLoop::Operand& result) {
+		result.array = get_element(e, index);
+		result.value = nullptr;
+		if(result.array) {
+			return true;
+		}
+		Variable* var = get_node<Variable>(e);
+		if(get_node<Literal<LiteralType::Integer>>(e) || (var && var->type == INT_TYPE && var->name != index)) {
+			result.value = &e;
+			return true;
+		}
+		return false;
+	}
+
+	bool get_operands(Expression& e, const std::string& index, VectorLoop& loop) {
+		auto add = get_node<BinaryOperator<BinOpType::Addition>>(e);
+		auto sub = get_node<BinaryOperator<BinOpType::Substraction>>(e);
+		loop.substraction = sub;
+		if(add || sub) {
+			loop.operands.resize(2);
+			return get_operand(add ? *add->left : *sub->left, index, loop.operands[0]) && get_operand(add ? *add->right : *sub->right, index, loop.operands[1]);
+		}
+		loop.operands.resize(1);
+		return get_operand(e, index, loop.operands[0]);
+	}
+
+	//acc = acc + element, acc = element + acc or acc = acc - element
+	template<typename F>
+	Variable* get_accumulator(Assignment& a, F is_element, bool& substraction) {
+		Variable* acc = get_node<Variable>(*a.var);
+		if(!acc || acc->type != INT_TYPE) {
+			return nullptr;
+		}
+		auto add = get_node<BinaryOperator<BinOpType::Addition>>(*a.value);
+		auto sub = get_node<BinaryOperator<BinOpType::Substraction>>(*a.value);
+		substraction = sub;
+		if(add && ((is_variable(*add->left, acc->name) && is_element(*add->right)) || (is_element(*add->left) && is_variable(*add->right, acc->name)))) {
+			return acc;
+		}
+		if(sub && is_variable(*sub->left, acc->name) && is_element(*sub->right)) {
+			return acc;
+		}
+		return nullptr;
+	}
+
+	//the loop body doesn't write anything but the index, the target and the accumulator
+	bool is_invariant_bound(Expression& e, const std::string& index) {
+		Variable* var = get_node<Variable>(e);
+		if(var) {
+			return var->type == INT_TYPE && var->name != index;
+		}
+		ClassMember* member = get_node<ClassMember>(e);
+		if(member) {
+			return member->member == LENGTH_ATTR_NAME && is_array(member->object->type) && get_node<Variable>(*member->object);
+		}
+		return get_node<Literal<LiteralType::Integer>>(e);
+	}
+
+	struct Vectorizer : public RecursiveVisitor {
+		//while(i < bound) {a[i] = b[i] + c[i]; i++;} and while(i < bound) {s = s + b[i]; i++;}
+		virtual void apply(While& arg) {
+			RecursiveVisitor::apply(arg);
+			auto cond = get_node<BinaryOperator<BinOpType::LessThan>>(*arg.condition);
+			if(!cond) {
+				return;
+			}
+			Variable* index = get_node<Variable>(*cond->left);
+			if(!index || index->type != INT_TYPE || !is_invariant_bound(*cond->right, index->name)) {
+				return;
+			}
+			Block* body = get_node<Block>(*arg.action);
+			if(!body || body->statements.size() != 2) {
+				return;
+			}
+			Incrementation* inc = get_node<Incrementation>(*body->statements[1]);
+			Assignment* as = get_node<Assignment>(*body->statements[0]);
+			if(!inc || !is_variable(*inc->var, index->name) || !as) {
+				return;
+			}
+			auto loop = std::make_shared<VectorLoop>();
+			loop->index = index;
+			loop->bound = cond->right.get();
+			loop->target = get_element(*as->var, index->name);
+			if(loop->target) {
+				loop->kind = VectorLoop::Kind::Map;
+				if(!get_operands(*as->value, index->name, *loop)) {
+					return;
+				}
+			} else {
+				loop->kind = VectorLoop::Kind::Sum;
+				loop->operands.resize(1);
+				loop->target = get_accumulator(*as, [&](Expression& e) {
+					loop->operands[0].array = get_element(e, index->name);
+					loop->operands[0].value = nullptr;
+					return loop->operands[0].array != nullptr;
+				}, loop->substraction);
+				if(!loop->target || loop->target->name == index->name || is_variable(*cond->right, loop->target->name)) {
+					return;
+				}
+			}
+			arg.vector_loop = loop;
+		}
+
+		//for(int x : a) s = s + x;
+		virtual void apply(For& arg) {
+			RecursiveVisitor::apply(arg);
+			if(arg.var_type != INT_TYPE || !arg.array->type.is_array() || arg.array->type.element() != INT_TYPE) {
+				return;
+			}
+			Assignment* as = get_node<Assignment>(single_statement(*arg.action));
+			if(!as) {
+				return;
+			}
+			auto loop = std::make_shared<VectorLoop>();
+			loop->kind = VectorLoop::Kind::Sum;
+			loop->index = nullptr;
+			loop->bound = nullptr;
+			loop->target = get_accumulator(*as, [&](Expression& e) {
+				return is_variable(e, arg.var_name);
+			}, loop->substraction);
+			if(!loop->target || loop->target->name == arg.var_name) {
+				return;
+			}
+			arg.vector_loop = loop;
+		}
+	};
+}
+
+namespace Optimizer {
+	void vectorize_loops(const TypeInfo& info) {
+		Vectorizer v;
+		for(const auto& fun : info.functions) {
+			fun.second->data->body->visit(&v);
+		}
+		for(const auto& cl : info.classes) {
+			for(const auto& fun : cl.second->functions) {
+				if(fun->class_info == cl.second.get()) {
+					fun->data->body->visit(&v);
+				}
+			}
+		}
+	}
+}
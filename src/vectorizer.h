@@ -0,0 +1,34 @@
+#ifndef VECTORIZER_H
+#define VECTORIZER_H
+
+#include "program_tree.h"
+#include "type_info_builder.h"
+
+#include <vector>
+
+namespace ProgramTree {
+	//a loop over int arrays which gets a vectorized prologue, the original loop then runs the remaining iterations
+	struct VectorLoop {
+		enum class Kind {
+			Map, Sum
+		};
+
+		struct Operand {
+			const Variable* array; //element [index] of this array
+			const Expression* value; //or a loop invariant, if 'array' is null
+		};
+
+		Kind kind;
+		const Variable* index; //null in a for loop, which sums up its own array
+		const Expression* bound; //the loop runs while index < bound, null in a for loop
+		const Variable* target; //array written by Map, accumulator of Sum
+		std::vector<Operand> operands; //one or two in Map, the summed element in Sum, none in a for loop
+		bool substraction; //operation between the operands of Map, whether Sum subtracts the elements from the accumulator
+	};
+}
+
+namespace Optimizer {
+	void vectorize_loops(const TypeChecker::TypeInfo& info);
+}
+
+#endif